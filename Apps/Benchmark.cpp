@@ -0,0 +1,436 @@
+// Benchmark.cpp - time hot paths of VecMat, Quaternion, IO and Mesh (no GPU needed)
+// usage: Benchmark [-n nVertices (default 250000)] [-t seconds per kernel (default .2)] [-f name filter] [-json file]
+// for each kernel report ns/op, MB/s (where an op reads a known number of bytes) and heap allocations/op
+// -json also writes results to file ("-" for stdout), eg, to compare runs before and after a change
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "BVH.h"
+#include "IO.h"
+#include "Mesh.h"
+#include "Parallel.h"
+#include "Quaternion.h"
+
+using std::string;
+
+// Allocation counting
+
+// every operator new in the process is counted, including those inside Lib
+
+static std::atomic<long long> nAllocations(0);
+
+void *operator new(size_t n) {
+	nAllocations++;
+	if (void *p = malloc(n? n : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t n) { return operator new(n); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+// Timing
+
+struct Result {
+	string name;
+	double nsPerOp = 0, mbPerSec = 0, allocsPerOp = 0;
+	long long nOps = 0;
+};
+
+vector<Result> results;
+const char *filter = NULL;
+double minSeconds = .2;
+volatile float sink = 0;	// kernels write here so the compiler can't discard their work
+
+double Seconds() {
+	static auto start = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double> dt = std::chrono::high_resolution_clock::now()-start;
+	return dt.count();
+}
+
+template<class Kernel> void Run(const char *name, int opsPerCall, double bytesPerOp, Kernel kernel) {
+	// time kernel (which performs opsPerCall ops), keeping the fastest of several trials
+	if (filter && !strstr(name, filter))
+		return;
+	kernel();	// warm caches, fault in pages
+	int nCalls = 1;
+	for (double t = 0; ; nCalls *= 2) {
+		double start = Seconds();
+		for (int i = 0; i < nCalls; i++)
+			kernel();
+		if ((t = Seconds()-start) > minSeconds/10 || nCalls > (1 << 24))
+			break;
+	}
+	Result r;
+	r.name = name;
+	r.nsPerOp = 1e30;
+	int nTrials = 0;
+	for (double begin = Seconds(); nTrials < 3 || (Seconds()-begin < minSeconds && nTrials < 100); nTrials++) {
+		long long allocs = nAllocations;
+		double start = Seconds();
+		for (int i = 0; i < nCalls; i++)
+			kernel();
+		double ns = 1e9*(Seconds()-start)/((double) nCalls*opsPerCall);
+		if (ns < r.nsPerOp)
+			r.nsPerOp = ns;
+		r.allocsPerOp = (double) (nAllocations-allocs)/((double) nCalls*opsPerCall);
+	}
+	r.nOps = (long long) nTrials*nCalls*opsPerCall;
+	r.mbPerSec = bytesPerOp > 0? bytesPerOp/(1024.*1024.)/(1e-9*r.nsPerOp) : 0;
+	results.push_back(r);
+	printf("%-34s %12.1f ns/op", name, r.nsPerOp);
+	if (r.mbPerSec > 0)
+		printf(" %9.1f MB/s", r.mbPerSec);
+	else
+		printf("%15s", "");
+	printf(" %10.2f allocs/op\n", r.allocsPerOp);
+}
+
+bool WriteJson(const char *filename, int nVertices) {
+	FILE *out = strcmp(filename, "-")? fopen(filename, "w") : stdout;
+	if (!out)
+		return false;
+	fprintf(out, "{\n  \"vertices\": %i,\n  \"threads\": %i,\n  \"benchmarks\": [\n", nVertices, NumThreads());
+	for (size_t i = 0; i < results.size(); i++) {
+		Result &r = results[i];
+		fprintf(out, "    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"mb_per_s\": %.3f, \"allocs_per_op\": %.3f, \"ops\": %lld}%s\n",
+				r.name.c_str(), r.nsPerOp, r.mbPerSec, r.allocsPerOp, r.nOps, i+1 < results.size()? "," : "");
+	}
+	fprintf(out, "  ]\n}\n");
+	if (out != stdout)
+		fclose(out);
+	return true;
+}
+
+// Synthetic data
+
+float Random(float lo, float hi) { return lo+(hi-lo)*(float) rand()/RAND_MAX; }
+
+mat4 RandomMatrix() {
+	mat4 m;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			m[i][j] = Random(-1, 1);
+	return m;
+}
+
+mat4 RandomRigid() {
+	return Translate(Random(-1, 1), Random(-1, 1), Random(-1, 1))*RotateZ(Random(0, 360))*RotateY(Random(0, 360))*RotateX(Random(0, 360));
+}
+
+Quaternion RandomQuaternion() {
+	Quaternion q(normalize(vec3(Random(-1, 1), Random(-1, 1), Random(-1, 1))), Random(0, 3.14159f));
+	return q;
+}
+
+void Grid(int nVertices, vector<vec3> &points, vector<int3> &triangles) {
+	// res*res grid of points in the unit square, slightly perturbed in z, two triangles per cell
+	int res = (int) sqrt((float) nVertices);
+	points.resize(0);
+	triangles.resize(0);
+	for (int j = 0; j < res; j++)
+		for (int i = 0; i < res; i++)
+			points.push_back(vec3((float) i/res, (float) j/res, Random(-.01f, .01f)));
+	for (int j = 0; j < res-1; j++)
+		for (int i = 0; i < res-1; i++) {
+			int a = j*res+i, b = a+1, c = a+res, d = c+1;
+			triangles.push_back(int3(a, b, d));
+			triangles.push_back(int3(a, d, c));
+		}
+}
+
+bool WriteTestObj(const char *filename, int nVertices) {
+	// grid of nVertices with normals and uvs, two triangles per grid cell, ten groups
+	FILE *out = fopen(filename, "w");
+	if (!out)
+		return false;
+	int res = (int) sqrt((float) nVertices);
+	for (int j = 0; j < res; j++)
+		for (int i = 0; i < res; i++)
+			fprintf(out, "v %f %f %f\n", (float) i/res, (float) j/res, Random(-.01f, .01f));
+	for (int i = 0; i < res*res; i++)
+		fprintf(out, "vn %f %f %f\n", Random(-.1f, .1f), Random(-.1f, .1f), 1.f);
+	for (int j = 0; j < res; j++)
+		for (int i = 0; i < res; i++)
+			fprintf(out, "vt %f %f\n", (float) i/res, (float) j/res);
+	for (int j = 0; j < res-1; j++) {
+		if (j%(res/10+1) == 0)
+			fprintf(out, "g group%i\n", j);
+		for (int i = 0; i < res-1; i++) {
+			int a = 1+j*res+i, b = a+1, c = a+res, d = c+1;
+			fprintf(out, "f %i/%i/%i %i/%i/%i %i/%i/%i\n", a, a, a, b, b, b, d, d, d);
+			fprintf(out, "f %i/%i/%i %i/%i/%i %i/%i/%i\n", a, a, a, d, d, d, c, c, c);
+		}
+	}
+	fclose(out);
+	return true;
+}
+
+bool WriteTestStl(const char *filename, vector<vec3> &points, vector<int3> &triangles, bool binary) {
+	FILE *out = fopen(filename, binary? "wb" : "w");
+	if (!out)
+		return false;
+	if (binary) {
+		char header[80] = "Benchmark";
+		unsigned nTriangles = (unsigned) triangles.size();
+		unsigned short attribute = 0;
+		fwrite(header, 1, 80, out);
+		fwrite(&nTriangles, 4, 1, out);
+		for (size_t i = 0; i < triangles.size(); i++) {
+			int3 t = triangles[i];
+			vec3 n = normalize(cross(points[t.i2]-points[t.i1], points[t.i3]-points[t.i2]));
+			fwrite(&n, 12, 1, out);
+			for (int k = 0; k < 3; k++)
+				fwrite(&points[t[k]], 12, 1, out);
+			fwrite(&attribute, 2, 1, out);
+		}
+	}
+	else {
+		fprintf(out, "solid benchmark\n");
+		for (size_t i = 0; i < triangles.size(); i++) {
+			int3 t = triangles[i];
+			vec3 n = normalize(cross(points[t.i2]-points[t.i1], points[t.i3]-points[t.i2]));
+			fprintf(out, "facet normal %e %e %e\nouter loop\n", n.x, n.y, n.z);
+			for (int k = 0; k < 3; k++) {
+				vec3 p = points[t[k]];
+				fprintf(out, "vertex %e %e %e\n", p.x, p.y, p.z);
+			}
+			fprintf(out, "endloop\nendfacet\n");
+		}
+		fprintf(out, "endsolid benchmark\n");
+	}
+	fclose(out);
+	return true;
+}
+
+double FileBytes(const char *filename) {
+	MappedFile file(filename);
+	return (double) file.size;
+}
+
+// OBJ readers, compared for identical output
+
+struct ObjData {
+	vector<vec3> points, normals;
+	vector<vec2> uvs;
+	vector<int3> triangles;
+	vector<Group> groups;
+	bool ok = false;
+};
+
+template<class T> bool Same(vector<T> &a, vector<T> &b) {
+	return a.size() == b.size() && (!a.size() || !memcmp(a.data(), b.data(), a.size()*sizeof(T)));
+}
+
+bool Same(ObjData &a, ObjData &b) {
+	if (a.ok != b.ok || !Same(a.points, b.points) || !Same(a.normals, b.normals) ||
+		!Same(a.uvs, b.uvs) || !Same(a.triangles, b.triangles) || a.groups.size() != b.groups.size())
+		return false;
+	for (size_t i = 0; i < a.groups.size(); i++)
+		if (a.groups[i].name != b.groups[i].name || a.groups[i].startTriangle != b.groups[i].startTriangle ||
+			a.groups[i].nTriangles != b.groups[i].nTriangles)
+			return false;
+	return true;
+}
+
+// Benchmarks
+
+void MatrixBenchmarks() {
+	const int n = 256;
+	vector<mat4> a(n), b(n), rigid(n), products(n);
+	vector<vec4> v(n);
+	for (int i = 0; i < n; i++) {
+		a[i] = RandomMatrix();
+		b[i] = RandomMatrix();
+		rigid[i] = RandomRigid();
+		v[i] = vec4(Random(-1, 1), Random(-1, 1), Random(-1, 1), 1);
+	}
+	Run("mat4*mat4", n, 0, [&]() {
+		for (int i = 0; i < n; i++)
+			products[i] = a[i]*b[i];
+		sink = products[n-1][0][0];
+	});
+	Run("mat4*vec4", n, 0, [&]() {
+		vec4 s;
+		for (int i = 0; i < n; i++)
+			s += a[i]*v[i];
+		sink = s.x;
+	});
+	Run("Transpose(mat4)", n, 0, [&]() {
+		for (int i = 0; i < n; i++)
+			products[i] = Transpose(a[i]);
+		sink = products[n-1][0][1];
+	});
+	Run("Invert(mat4), projective", n, 0, [&]() {
+		for (int i = 0; i < n; i++)
+			products[i] = Invert(a[i]);
+		sink = products[n-1][0][0];
+	});
+	Run("Invert(mat4), affine", n, 0, [&]() {
+		for (int i = 0; i < n; i++)
+			products[i] = Invert(rigid[i]);
+		sink = products[n-1][0][0];
+	});
+	Run("InvertRigid(mat4)", n, 0, [&]() {
+		for (int i = 0; i < n; i++)
+			products[i] = InvertRigid(rigid[i]);
+		sink = products[n-1][0][0];
+	});
+}
+
+void QuaternionBenchmarks() {
+	const int n = 256;
+	vector<Quaternion> q0(n), q1(n), q(n);
+	vector<mat3> rotations(n);
+	for (int i = 0; i < n; i++) {
+		q0[i] = RandomQuaternion();
+		q1[i] = RandomQuaternion();
+		rotations[i] = q0[i].Get3x3();
+	}
+	Run("Quaternion::Slerp", n, 0, [&]() {
+		for (int i = 0; i < n; i++)
+			q[i].Slerp(q0[i], q1[i], (float) i/n);
+		sink = q[n-1].w;
+	});
+	Run("Quaternion(mat3)", n, 0, [&]() {
+		for (int i = 0; i < n; i++)
+			q[i] = Quaternion(rotations[i]);
+		sink = q[n-1].w;
+	});
+}
+
+void MeshBenchmarks(int nVertices) {
+	vector<vec3> points, normals, copy;
+	vector<int3> triangles;
+	Grid(nVertices, points, triangles);
+	double meshBytes = (double) (points.size()*sizeof(vec3)+triangles.size()*sizeof(int3));
+	TriangleAdjacency adjacency;
+	adjacency.Set((int) points.size(), triangles);
+	Run("SetVertexNormals", 1, meshBytes, [&]() {
+		SetVertexNormals(points, triangles, normals);
+		sink = normals[0].z;
+	});
+	Run("SetVertexNormals, 1 thread", 1, meshBytes, [&]() {
+		SetVertexNormals(points, triangles, normals, 1);
+		sink = normals[0].z;
+	});
+	Run("SetVertexNormals, adjacency", 1, meshBytes, [&]() {
+		SetVertexNormals(points, triangles, normals, adjacency);
+		sink = normals[0].z;
+	});
+	copy = points;
+	Run("Standardize", 1, (double) (points.size()*sizeof(vec3)), [&]() {
+		Standardize(copy.data(), (int) copy.size());
+		sink = copy[0].x;
+	});
+	// rays from above the grid, each tested against every triangle
+	vector<TriInfo> triInfos;
+	BuildTriInfos(points, triangles, triInfos);
+	const int nRays = 16;
+	vector<vec3> rayStarts(nRays), rayEnds(nRays);
+	for (int i = 0; i < nRays; i++) {
+		rayStarts[i] = vec3(Random(0, 1), Random(0, 1), 1);
+		rayEnds[i] = rayStarts[i]+vec3(Random(-.1f, .1f), Random(-.1f, .1f), -2);
+	}
+	Run("IntersectWithLine", nRays, (double) (triInfos.size()*sizeof(TriInfo)), [&]() {
+		float alpha, sum = 0;
+		for (int i = 0; i < nRays; i++)
+			sum += (float) IntersectWithLine(rayStarts[i], rayEnds[i], triInfos, alpha);
+		sink = sum;
+	});
+	BVH bvh;
+	Run("BVH::Build", 1, meshBytes, [&]() {
+		bvh.Build(points, triangles);
+		sink = bvh.nodes[0].max.x;
+	});
+	if (bvh.Empty())
+		bvh.Build(points, triangles);
+	Run("BVH::IntersectWithLine", nRays, 0, [&]() {
+		float alpha, sum = 0;
+		for (int i = 0; i < nRays; i++)
+			sum += (float) bvh.IntersectWithLine(rayStarts[i], rayEnds[i], alpha);
+		sink = sum;
+	});
+	Run("BVH::Refit", 1, meshBytes, [&]() {
+		bvh.Refit(points, 0);
+		sink = bvh.nodes[0].max.x;
+	});
+}
+
+bool ParserBenchmarks(int nVertices) {
+	bool ok = true;
+	const char *objName = "benchmark.obj", *stlName = "benchmark.stl", *stlAsciiName = "benchmark-ascii.stl";
+	if (!WriteTestObj(objName, nVertices)) {
+		printf("can't write %s\n", objName);
+		return false;
+	}
+	double objBytes = FileBytes(objName);
+	ObjData a, b, c;
+	Run("ReadAsciiObj", 1, objBytes, [&]() {
+		a = ObjData();
+		a.ok = ReadAsciiObj(objName, a.points, a.triangles, &a.normals, &a.uvs, &a.groups);
+	});
+	Run("ReadAsciiObjMapped", 1, objBytes, [&]() {
+		b = ObjData();
+		b.ok = ReadAsciiObjMapped(objName, b.points, b.triangles, &b.normals, &b.uvs, &b.groups);
+	});
+	Run("ReadAsciiObjParallel", 1, objBytes, [&]() {
+		c = ObjData();
+		c.ok = ReadAsciiObjParallel(objName, c.points, c.triangles, &c.normals, &c.uvs, &c.groups);
+	});
+	if (a.ok && ((b.ok && !Same(a, b)) || (c.ok && !Same(a, c)))) {
+		printf("OBJ readers: output DIFFERS\n");
+		ok = false;
+	}
+	remove(objName);
+	vector<vec3> points, stlPoints;
+	vector<int3> triangles, stlTriangles;
+	Grid(nVertices, points, triangles);
+	if (WriteTestStl(stlName, points, triangles, true) && WriteTestStl(stlAsciiName, points, triangles, false)) {
+		Run("ReadSTL, binary", 1, FileBytes(stlName), [&]() {
+			ReadSTL(stlName, stlPoints, stlTriangles);
+			sink = (float) stlTriangles.size();
+		});
+		Run("ReadSTL, ASCII", 1, FileBytes(stlAsciiName), [&]() {
+			ReadSTL(stlAsciiName, stlPoints, stlTriangles);
+			sink = (float) stlTriangles.size();
+		});
+	}
+	remove(stlName);
+	remove(stlAsciiName);
+	return ok;
+}
+
+int main(int ac, char **av) {
+	int nVertices = 250000;
+	const char *jsonName = NULL;
+	for (int i = 1; i < ac; i++) {
+		bool more = i+1 < ac;
+		if (!strcmp(av[i], "-n") && more) nVertices = atoi(av[++i]);
+		else if (!strcmp(av[i], "-t") && more) minSeconds = atof(av[++i]);
+		else if (!strcmp(av[i], "-f") && more) filter = av[++i];
+		else if (!strcmp(av[i], "-json") && more) jsonName = av[++i];
+		else {
+			printf("usage: Benchmark [-n nVertices] [-t seconds] [-f filter] [-json file]\n");
+			return 1;
+		}
+	}
+	printf("%i vertices, %i threads\n", nVertices, NumThreads());
+	MatrixBenchmarks();
+	QuaternionBenchmarks();
+	MeshBenchmarks(nVertices);
+	bool ok = ParserBenchmarks(nVertices);
+	if (jsonName && !WriteJson(jsonName, nVertices)) {
+		printf("can't write %s\n", jsonName);
+		return 1;
+	}
+	return ok? 0 : 1;
+}
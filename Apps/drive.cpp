@@ -218,13 +218,14 @@ vector<vec2> floor_uvs = { {0, 0}, {1, 0}, {1, 1}, {0, 1} };
 vector<int3> floor_triangles = { {2, 1, 0}, {0, 3, 2} };
 
 dMesh large_tree_mesh;
-vector<vec3> large_tree_positions = {
+constexpr vec3 large_tree_positions[] = {
 	{49, 0, 37}, {50, 0, 32}, {29, 0, 15}, {50, 0, 10},
 	{-10, 0, 32}, {-34, 0, 7}, {15, 0, -13}, {6, 0, -15},
 	{-0.75, 0, 0.3}
 };
 dMesh grass_mesh;
-vector<mat4> grass_instance_transforms = {
+constexpr mat4 grass_translations[] = {
+	// evaluated at compile time, stored in read-only data
 	Translate(7.79, 0, -5.38), Translate(5.27, 0, -8.41), Translate(-6.32, 0, -8.58), Translate(-9.40, 0, -5.62), 
 	Translate(-9.49, 0, 5.47), Translate(-6.46, 0, 8.56), Translate(4.59, 0, 9.61), Translate(7.51, 0, 6.12),
 	Translate(12.07, 0, 5.49), Translate(15.67, 0, 5.87), Translate(20.84, 0, 5.78), Translate(23.66, 0, 10.43),
@@ -243,6 +244,7 @@ vector<mat4> grass_instance_transforms = {
 	Translate(40.97, 0, 53.80), Translate(33.35, 0, 55.97), Translate(22.45, 0, 55.02), Translate(12.37, 0, 52.92), 
 	Translate(4.89, 0, 51.58), Translate(7.12, 0, 44.37), Translate(8.70, 0, 35.15), Translate(8.79, 0, 15.86)
 };
+vector<mat4> grass_instance_transforms(grass_translations, grass_translations+sizeof(grass_translations)/sizeof(mat4));
 
 struct Car {
 	dMesh mesh;
@@ -593,7 +595,7 @@ void draw() {
 	glClear(GL_DEPTH_BUFFER_BIT);
 	glUseProgram(shadowProgram);
 	glCullFace(GL_FRONT);
-	mat4 depthProj = Orthographic(-80, 80, -80, 80, -20, 100);
+	constexpr mat4 depthProj = Orthographic(-80, 80, -80, 80, -20, 100);
 	mat4 depthView = LookAt(vec3(20, 30, 20), vec3(0, 0, 0), vec3(0, 1, 0));
 	mat4 depthVP = depthProj * depthView;
 	SetUniform(shadowProgram, "depth_vp", depthVP);
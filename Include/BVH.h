@@ -0,0 +1,84 @@
+// BVH.h - bounding volume hierarchy over triangles and quads, for picking by line intersection
+// built with the surface area heuristic (binned, multi-threaded), traversed nearest child first
+// the line/triangle test is watertight: a line through a shared edge or vertex hits at least one of its triangles
+// for deforming meshes, Refit updates bounds in place; TopBVH places many BVHs by matrices (two levels)
+
+#ifndef BVH_HDR
+#define BVH_HDR
+
+#include <vector>
+#include "VecMat.h"
+
+using std::vector;
+
+struct BVHNode {
+	// 32 bytes; an interior node's children are adjacent, at nodes[offset] and nodes[offset+1]
+	// a leaf's primitives are at [offset, offset+count) in leaf order (for BVH, in ids, indices and vertices)
+	vec3 min;
+	int offset = 0;
+	vec3 max;
+	int count = 0;		// 0: interior
+};
+
+class BVH {
+public:
+	vector<BVHNode> nodes;		// nodes[0] is root; children follow parents
+	vector<int> ids;			// per triangle, in leaf order: triangle index, or nTriangles+q for a half of quad q
+	vector<int3> indices;		// per triangle, in leaf order: its points (quads a,b,c,d split as a,b,c and a,c,d)
+	vector<vec3> vertices;		// per triangle, in leaf order: three vertices, copied from points
+	int nTriangles = 0, nQuads = 0;
+	void Build(const vector<vec3> &points, const vector<int3> &triangles, const vector<int4> *quads = NULL,
+			   int maxLeafSize = 4, int nThreads = 0);
+		// build over triangles and (optional) quads (0 threads: all cores)
+	bool Refit(const vector<vec3> &points, float rebuildRatio = 2, int nThreads = 0);
+		// after points move (triangles and quads unchanged): copy vertices, recompute bounds bottom-up in parallel
+		// if Cost then exceeds rebuildRatio times its value when built, rebuild instead and return true
+	float Cost() const;
+		// surface area heuristic: expected node visits and triangle tests for a random line through the root box
+	void Clear();
+	bool Empty() const { return nodes.empty(); }
+	int IntersectWithLine(vec3 p1, vec3 p2, float &alpha) const;
+		// as IntersectWithLine(p1, p2, triInfos, alpha) (see Mesh.h): among triangles and quads that intersect the
+		// (infinite) line through p1 and p2, the one of least alpha, where intersection = p1+alpha*(p2-p1)
+		// return triangle index, nTriangles+q for quad q, or -1 if none (alpha then FLT_MAX)
+	int IntersectWithLine(vec3 p1, vec3 p2, float &alpha, float maxAlpha) const;
+		// as above, but only intersections with alpha <= maxAlpha (if none, return -1, alpha unchanged)
+	void IntersectWithLines(const vector<vec3> &p1, const vector<vec3> &p2, vector<int> &hits, vector<float> &alphas,
+							int nThreads = 0) const;
+		// IntersectWithLine for each p1[i], p2[i], lines divided among threads (eg, to pick every pixel)
+private:
+	void Build(const vector<vec3> &points, vector<int3> &prims, vector<int> &primIds, int maxLeafSize, int nThreads);
+	vector<int3> subtrees;		// per subtree built in parallel: root node, first and end of its (contiguous) nodes
+	int nUpperNodes = 0;		// nodes [0, nUpperNodes) were split before the subtrees were built
+	int maxLeafSize = 4;
+	float builtCost = 0;
+};
+
+class TopBVH {
+	// BVH over instances, each a BVH placed in the world by a matrix (eg, Mesh::toWorld)
+	// moving an instance refits this level only; the instanced BVHs (and their triangles) are untouched
+public:
+	struct Instance {
+		const BVH *bvh = NULL;
+		mat4 toWorld, toObject;
+		vec3 min, max;			// world bounds
+	};
+	vector<Instance> instances;
+	vector<BVHNode> nodes;		// leaves index leaves
+	vector<int> leaves;			// instances, in leaf order
+	int Add(const BVH *bvh, const mat4 &toWorld);
+		// return instance index; call Build once instances added
+	void SetTransform(int instance, const mat4 &toWorld);
+		// call Refit once transforms set
+	void Build(int nThreads = 0);
+	bool Refit(float rebuildRatio = 2);
+		// recompute instance bounds and nodes bottom-up; rebuild (return true) if cost exceeds rebuildRatio times built
+	void Clear();
+	int IntersectWithLine(vec3 p1, vec3 p2, float &alpha, int &id) const;
+		// nearest intersection of line with any instance, as BVH::IntersectWithLine (p1, p2 in world space)
+		// return instance index (or -1), set id to the instance's triangle (or nTriangles+quad) index
+private:
+	float builtCost = 0;
+};
+
+#endif
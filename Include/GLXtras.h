@@ -5,6 +5,7 @@
 
 #include "glad.h"
 #include <GLFW/glfw3.h>
+#include <string.h>
 #include "VecMat.h"
 
 // GLFW
@@ -79,6 +80,64 @@ bool SetUniform3v(int program, const char *name, int count, float *v);
 bool SetUniform4v(int program, const char *name, int count, float *v);
 bool SetUniform(int program, const char *name, mat4 m);
 	// if no such named uniform and squawk, print error message
+	// locations are cached per program (see FindUniform); as with glUniform, program should be current
+
+// Uniform Cache
+
+struct UniformSlot {
+	GLint location = -1;			// -1: no such uniform
+	int size = 0;					// bytes of value last set via SetUniform or Uniform<T>, 0 if unknown
+	unsigned char value[sizeof(mat4)];
+};
+
+UniformSlot *FindUniform(int program, const char *name);
+	// cached per program and name; the first call per name queries glGetUniformLocation
+GLint UniformLocation(int program, const char *name);
+	// FindUniform(program, name)->location
+void ClearUniformCache(int program = 0);
+	// forget locations and values of program (0: all programs); done when GLXtras links or deletes a program
+	// call if a program is linked otherwise, or if a uniform is set by glUniform* directly
+unsigned UniformCacheGeneration();
+	// incremented by ClearUniformCache
+
+void UploadUniform(GLint location, bool v);
+void UploadUniform(GLint location, int v);
+void UploadUniform(GLint location, GLuint v);
+void UploadUniform(GLint location, float v);
+void UploadUniform(GLint location, vec2 v);
+void UploadUniform(GLint location, vec3 v);
+void UploadUniform(GLint location, vec4 v);
+void UploadUniform(GLint location, const mat4 &m);
+	// glUniform* for the type (mat4 transposed, as SetUniform)
+
+template<class T> class Uniform {
+	// typed handle to a named uniform: location found once per program, value uploaded only if changed
+	// eg, static Uniform<mat4> modelview("modelview"); ... modelview.Set(program, camera.modelview*toWorld);
+public:
+	const char *name;
+	Uniform(const char *name) : name(name) { }
+	bool Set(int program, const T &v) {
+		// as SetUniform(program, name, v), but skip the upload if the uniform already has value v
+		static_assert(sizeof(T) <= sizeof(UniformSlot::value), "uniform too large");
+		if (program != this->program || generation != UniformCacheGeneration()) {
+			slot = FindUniform(program, name);
+			this->program = program;
+			generation = UniformCacheGeneration();
+		}
+		if (slot->location < 0)
+			return SetUniform(program, name, v);	// report, return false
+		if (slot->size == (int) sizeof(T) && !memcmp(slot->value, &v, sizeof(T)))
+			return true;
+		UploadUniform(slot->location, v);
+		memcpy(slot->value, &v, sizeof(T));
+		slot->size = (int) sizeof(T);
+		return true;
+	}
+private:
+	int program = -1;
+	unsigned generation = 0;
+	UniformSlot *slot = NULL;
+};
 
 // Attributes
 int EnableVertexAttribute(int program, const char *name);
@@ -5,6 +5,7 @@
 
 #include <glad.h>
 #include <string.h>
+#include <time.h>
 #include <vector>
 #include "VecMat.h"
 
@@ -21,6 +22,13 @@ GLuint LoadTexture(unsigned char *pixels, int width, int height, int bpp, bool b
 
 void LoadTexture(unsigned char *pixels, int width, int height, int bpp, unsigned int textureName, bool bgr, bool mipmap = true);
 
+GLuint ReadTextureOnce(const char *filename, bool mipmap = true);
+	// as ReadTexture, but return the texture previously read from filename, if any
+
+GLuint DecodeTexture(const unsigned char *encoded, size_t nBytes, bool flipVertically = true, bool mipmap = true);
+	// decode image file contents held in memory (eg, PNG or JPEG embedded in a glTF file), load with LoadTexture
+	// return texture name, or 0 if not decodable
+
 void SavePng(const char *filename);
 
 void SaveBmp(const char *filename);
@@ -43,8 +51,28 @@ void SaveTga(const char *filename);
 // In main
 //	  textureName = ReadTexture(<filename>);
 
+// Memory-mapped file
+
+class MappedFile {
+public:
+	const char *data = NULL;	// read-only view of file contents, not null-terminated
+	size_t size = 0;			// # bytes
+	bool Open(const char *filename);
+		// map entire file; return false if file can't be opened or mapped
+	void Close();
+	MappedFile() { }
+	MappedFile(const char *filename) { Open(filename); }
+	~MappedFile() { Close(); }
+private:
+	MappedFile(const MappedFile &);
+	MappedFile &operator = (const MappedFile &);
+};
+
 // Standardize
 
+mat4 NDCfromMinMax(vec3 min, vec3 max, float scale = 1);
+	// translate and uniformly scale so that min, max fit in -scale,+scale
+
 mat4 StandardizeMat(vec3 *points, int npoints, float scale = 1);
 
 void Standardize(vec3 *points, int npoints, float scale = 1);
@@ -52,8 +80,23 @@ void Standardize(vec3 *points, int npoints, float scale = 1);
 
 // Normals
 
-void SetVertexNormals(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals);
-	// compute/recompute vertex normals as the average of surrounding triangle normals
+struct TriangleAdjacency {
+	// triangles that use each vertex v: triangles[offsets[v]] up to triangles[offsets[v+1]]
+	vector<int> offsets, triangles;
+	void Set(int nVertices, const vector<int3> &triangles);
+};
+
+void SetVertexNormals(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals, int nThreads = 0);
+	// compute/recompute vertex normals as the average of surrounding triangle normals (0 threads: all cores)
+
+void SetVertexNormals(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals,
+					  const TriangleAdjacency &adjacency, int nThreads = 0);
+	// as above, given adjacency (set from triangles); each vertex gathers from its triangles, in parallel
+
+void UpdateVertexNormals(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals,
+						 const TriangleAdjacency &adjacency, const vector<int> &dirtyVertices);
+	// recompute only the normals affected by moving dirtyVertices (theirs and their neighbors'), eg, after
+	// mover.Drag on &points[i], UpdateVertexNormals(points, triangles, normals, adjacency, {i})
 
 // STL
 
@@ -64,8 +107,24 @@ struct VertexSTL {
 };
 
 int ReadSTL(const char *filename, vector<VertexSTL> &vertices);
-	// binary format only
-	// read vertices from file, three per triangle; return # triangles
+	// binary or ASCII format
+	// read vertices from file, three per triangle; return # triangles (0 if none read)
+
+bool ReadSTL(const char *filename, vector<vec3> &points, vector<int3> &triangles, vector<vec3> *normals = NULL, float weldTolerance = 0);
+	// binary or ASCII format; return true if any triangles read
+	// weld vertices within weldTolerance (if 0, identical vertices) into indexed points, triangles
+	// triangles degenerate after welding are dropped; if non-null, set normals per vertex
+
+// PLY
+
+bool ReadPLY(const char *filename, vector<vec3> &points, vector<int3> *triangles = NULL, vector<vec3> *normals = NULL, vector<vec3> *colors = NULL);
+	// binary little-endian only; return true if successful
+	// vertex x,y,z (and, if requested and present, nx,ny,nz and red,green,blue) are copied from the mapped file,
+	// directly if three consecutive floats; face lists are triangulated (as fans) if not all triangles
+	// integer colors are scaled to 0-1; a point cloud has no faces
+
+bool WritePLY(const char *filename, vector<vec3> &points, vector<int3> *triangles = NULL, vector<vec3> *normals = NULL, vector<vec3> *colors = NULL);
+	// binary little-endian; normals and colors written if same size as points (colors as uchar)
 
 // OBJ
 
@@ -84,6 +143,9 @@ struct Group {
 struct Mtl {
 	string name;
 	vec3 ka, kd, ks;
+	float ns = 0, d = 1;		// specular exponent, opacity
+	string mapKd;				// diffuse texture file (path relative to application)
+	GLuint textureName = 0;		// if non-zero, used instead of mapKd (eg, image embedded in glTF)
 	int startTriangle = 0, nTriangles = 0;
 	Mtl() {startTriangle = -1, nTriangles = 0; }
 	Mtl(int start, string n, vec3 a, vec3 d, vec3 s) : startTriangle(start), name(n), ka(a), kd(d), ks(s) { }
@@ -100,6 +162,127 @@ bool ReadAsciiObj(const char    *filename,                  // must be ASCII fil
 				  vector<int2>  *segs = NULL);				// optional line segments
 	// set points and triangles; normals, textures, quads optional
 	// return true if successful
+	// materials support newmtl, Ka, Kd, Ks, Ns, d (or Tr), map_Kd
+
+bool ReadAsciiObjMapped(const char    *filename,
+						vector<vec3>  &points,
+						vector<int3>  &triangles,
+						vector<vec3>  *normals  = NULL,
+						vector<vec2>  *textures = NULL,
+						vector<Group> *triangleGroups = NULL,
+						vector<Mtl>   *triangleMtls = NULL,
+						vector<int4>  *quads = NULL,
+						vector<int2>  *segs = NULL);
+	// as ReadAsciiObj, but memory-map the file and parse lines in place (no per-line copies)
+	// output is identical to ReadAsciiObj; considerably faster for large files
+
+bool ReadAsciiObjParallel(const char    *filename,
+						  vector<vec3>  &points,
+						  vector<int3>  &triangles,
+						  vector<vec3>  *normals  = NULL,
+						  vector<vec2>  *textures = NULL,
+						  vector<Group> *triangleGroups = NULL,
+						  vector<Mtl>   *triangleMtls = NULL,
+						  vector<int4>  *quads = NULL,
+						  vector<int2>  *segs = NULL,
+						  int            nThreads = 0,
+						  vector<string> *mtlLibs = NULL);
+	// as ReadAsciiObjMapped, but parse line-aligned chunks of the file concurrently (nThreads 0: all cores)
+	// chunks are merged in file order, so output is identical to ReadAsciiObj
+	// if non-null, mtlLibs set to paths of material files read (eg, to validate a cache)
+
+class ObjReader {
+	// read an OBJ file a portion at a time (eg, to spread loading a large file over several frames)
+	// once Done, output is identical to ReadAsciiObj
+public:
+	bool Open(const char    *filename,
+			  vector<vec3>  &points,
+			  vector<int3>  &triangles,
+			  vector<vec3>  *normals  = NULL,
+			  vector<vec2>  *textures = NULL,
+			  vector<Group> *triangleGroups = NULL,
+			  vector<Mtl>   *triangleMtls = NULL,
+			  vector<int4>  *quads = NULL,
+			  vector<int2>  *segs = NULL);
+		// map file; return false if it can't be opened; output arrays must outlive the reader
+	bool Read(size_t nBytes);
+		// parse whole lines totaling at least nBytes (or to end of file, which completes the output)
+		// return false if error
+	bool Done() const;
+	float Progress() const;
+		// fraction of file read
+	const vector<vec3> &Vertices() const;
+	const vector<vec3> &Normals() const;
+		// positions and normals indexed by the triangles read so far (normals may lag positions)
+		// these are the final points and normals once Done
+	void Close();
+	ObjReader() { }
+	~ObjReader() { Close(); }
+private:
+	struct State;
+	State *state = NULL;
+	ObjReader(const ObjReader &);
+	ObjReader &operator = (const ObjReader &);
+};
+
+void SortTrianglesByMaterial(vector<int3> &triangles, vector<Mtl> &triangleMtls, vector<Group> *triangleGroups = NULL);
+	// reorder triangles so each distinct material (by name) is one contiguous range, with materials that
+	// share a texture map adjacent; merge triangleMtls to one per material
+	// groups are split as needed to remain contiguous (triangles no longer first and ungrouped get an unnamed group)
+
+vector<int> TriangleRangeBounds(int nTriangles, vector<Group> *triangleGroups = NULL, vector<Mtl> *triangleMtls = NULL);
+	// sorted, distinct starts and ends of all groups and materials, with 0 and nTriangles: a triangle order
+	// or simplification that keeps to these ranges leaves groups and materials valid
+
+float SimplifyTriangles(const vector<vec3> &points,
+						const int3         *triangles,
+						int                 nTriangles,
+						int                 targetTriangles,
+						vector<int3>       &result,
+						const vector<bool> *locked = NULL);   // if non-null, vertices not to be removed
+	// quadric error edge collapse (Garland, Heckbert 1997) toward targetTriangles; each collapse moves a vertex onto
+	// a neighbor, so result indexes points and can share their vertex buffer; border vertices move only along the
+	// border, vertices of non-manifold edges are kept; surviving triangles keep their relative order
+	// return estimate of largest distance from the original surface
+
+struct Meshlet {
+	int startTriangle = 0, nTriangles = 0;
+	vec3 center;			// bounding sphere
+	float radius = 0;
+	vec3 coneAxis;			// normal cone: all triangles face away from an eye if
+	float coneCutoff = 1;	// dot(center-eye, coneAxis) >= coneCutoff*length(center-eye)+radius
+};
+
+void BuildMeshlets(const vector<vec3> &points,
+				   vector<int3>       &triangles,
+				   vector<Meshlet>    &meshlets,
+				   int                 maxVertices = 64,
+				   int                 maxTriangles = 124,
+				   vector<Group>      *triangleGroups = NULL,
+				   vector<Mtl>        *triangleMtls = NULL,
+				   int                 nThreads = 0);
+	// reorder triangles into meshlets of adjacent triangles, each a contiguous range within a group and material
+	// range (so these remain valid), with at most maxVertices distinct vertices and maxTriangles triangles
+
+float ACMR(const vector<int3> &triangles, int cacheSize = 16);
+	// average cache miss ratio: vertices transformed per triangle, given a FIFO post-transform cache
+
+void OptimizeTriangleOrder(vector<vec3>  &points,
+						   vector<int3>  &triangles,
+						   vector<vec3>  *normals = NULL,
+						   vector<vec2>  *uvs = NULL,
+						   vector<int4>  *quads = NULL,             // vertex ids remapped, order unchanged
+						   vector<Group> *triangleGroups = NULL,
+						   vector<Mtl>   *triangleMtls = NULL,
+						   int            cacheSize = 16,
+						   float          overdrawThreshold = 1.05f,  // 0: order for vertex cache only
+						   float         *acmrBefore = NULL,
+						   float         *acmrAfter = NULL,
+						   int            nThreads = 0);
+	// reorder triangles for the post-transform vertex cache (Tipsify), then clusters of them for less overdraw;
+	// clusters are split where ACMR falls to overdrawThreshold times that of the range, a small increase in ACMR
+	// then reorder vertices by first use, for fetch locality (normals and uvs permuted if same size as points)
+	// triangles are reordered only within ranges bounded by groups and materials, so these remain valid
 
 bool WriteAsciiObj(const char      *filename,
 				   vector<vec3>    &points,
@@ -108,8 +291,155 @@ bool WriteAsciiObj(const char      *filename,
 				   vector<int3>    *triangles = NULL,
 				   vector<int4>    *quads = NULL,
 				   vector<int2>    *segs = NULL,
-				   vector<Group>   *triangleGroups = NULL);
+				   vector<Group>   *triangleGroups = NULL,
+				   int              nThreads = 0);
 	// write to file mesh points, normals, and uvs
 	// optionally write triangles, quads, segs, groups
+	// numbers are written in shortest form that reads back exactly; lines are formatted by nThreads (0: all cores)
+
+// FBX
+
+bool ReadFBX(const char    *filename,                  // binary FBX, version 7
+			 vector<vec3>  &points,                    // unique set of points determined by point/normal/uv triplets
+			 vector<int3>  &triangles,                 // polygons triangulated as fans
+			 vector<vec3>  *normals = NULL,            // if non-null, set (zero where a geometry has none)
+			 vector<vec2>  *textures = NULL,           // if non-null, set from first uv layer
+			 vector<Group> *triangleGroups = NULL,     // if non-null, one group per model
+			 vector<Mtl>   *triangleMtls = NULL,       // if non-null, one entry per run of triangles with same material
+			 int            nThreads = 0);             // 0: one per hardware thread
+	// geometry of all mesh models is merged, each transformed by its model hierarchy
+	// compressed arrays are inflated in parallel, then models are converted in parallel
+	// return true if successful
+
+// Binary mesh cache (.meshbin)
+//    arrays are stored in native byte order, 8-byte aligned, so they can be used in place once mapped;
+//    points, normals, uvs are contiguous, as laid out in a Mesh vertex buffer
+
+bool WriteMeshBin(const char    *filename,
+				  time_t         sourceModified,	// modification time of source (eg, OBJ) file
+				  unsigned       flags,				// caller-defined options the data depend on
+				  vector<vec3>  &points,
+				  vector<vec3>  &normals,
+				  vector<vec2>  &uvs,
+				  vector<int3>  &triangles,
+				  vector<int4>  &quads,
+				  vector<Group> &triangleGroups,
+				  vector<Mtl>   &triangleMtls,
+				  const vector<string> *dependencies = NULL);
+	// return true if file written
+	// dependencies (eg, OBJ material files) are stored with their modification times
+
+class MeshBin {
+public:
+	MappedFile file;
+	size_t nPoints = 0, nNormals = 0, nUvs = 0, nTriangles = 0, nQuads = 0;
+	bool Open(const char *filename, time_t sourceModified, unsigned flags);
+		// map file; return false if missing, malformed, not written with same sourceModified and flags,
+		// or if any stored dependency has since been modified
+	const char *Vertices() const;	// points, then normals, then uvs
+	size_t VerticesSize() const;	// # bytes
+	const vec3 *Points() const;
+	const vec3 *Normals() const;
+	const vec2 *Uvs() const;
+	const int3 *Triangles() const;
+	const int4 *Quads() const;
+	void Get(vector<vec3> &points, vector<vec3> &normals, vector<vec2> &uvs, vector<int3> &triangles,
+			 vector<int4> &quads, vector<Group> &triangleGroups, vector<Mtl> &triangleMtls) const;
+		// copy mapped arrays (after successful Open)
+private:
+	size_t verticesOffset = 0, trianglesOffset = 0, quadsOffset = 0, groupsOffset = 0, mtlsOffset = 0, dependenciesOffset = 0;
+	size_t nGroups = 0, nMtls = 0;
+};
+
+bool WriteBinaryObj(const char    *filename,
+					vector<vec3>  &points,
+					vector<vec3>  &normals,
+					vector<vec2>  &uvs,
+					vector<int3>  *triangles = NULL,
+					vector<int4>  *quads = NULL,
+					vector<Group> *triangleGroups = NULL,
+					vector<Mtl>   *triangleMtls = NULL);
+	// binary counterpart of WriteAsciiObj (.meshbin layout), eg, to checkpoint mesh edits quickly
+
+bool ReadBinaryObj(const char    *filename,
+				   vector<vec3>  &points,
+				   vector<vec3>  &normals,
+				   vector<vec2>  &uvs,
+				   vector<int3>  &triangles,
+				   vector<int4>  *quads = NULL,
+				   vector<Group> *triangleGroups = NULL,
+				   vector<Mtl>   *triangleMtls = NULL);
+	// read file written by WriteBinaryObj; return false if missing or malformed
+
+// glTF 2.0 (.gltf with external or data: buffers, or binary .glb)
+//    Gltf is a read-only view of the file: accessors point into the mapped binary chunk (or
+//    external buffer), so vertex and index data can be uploaded to the GPU in place (see ReadGltf in Mesh.h)
+
+struct GltfAccessor {
+	const char *data = NULL;		// first element; NULL if no buffer view (all zero) or sparse
+	size_t count = 0;				// # elements
+	int stride = 0;					// # bytes from one element to the next
+	int componentType = 0;			// GL_BYTE, GL_UNSIGNED_BYTE, GL_SHORT, GL_UNSIGNED_SHORT, GL_UNSIGNED_INT, or GL_FLOAT
+	int nComponents = 0;			// 1 (SCALAR), 2 (VEC2), 3 (VEC3), 4 (VEC4), 4, 9, 16 (MAT2, MAT3, MAT4)
+	bool normalized = false;		// integer components map to 0,1 (unsigned) or -1,1 (signed)
+	int ComponentSize() const;
+	size_t Size() const;			// # bytes spanned, from data to end of last element
+	bool Packed() const { return stride == nComponents*ComponentSize(); }
+	bool Get(vector<vec3> &v) const;
+	bool Get(vector<vec2> &v) const;
+	bool Get(vector<int> &v) const;
+		// convert elements; return false if # components mismatched
+};
+
+struct GltfPrimitive {
+	GltfAccessor points, normals, uvs, indices;	// POSITION, NORMAL, TEXCOORD_0, indices (count 0 if absent)
+	int mode = 4;					// GL_TRIANGLES, GL_TRIANGLE_STRIP, GL_TRIANGLE_FAN, or (unsupported) points, lines
+	int material = -1;
+};
+
+struct GltfMesh {
+	string name;
+	vector<GltfPrimitive> primitives;
+};
+
+struct GltfMaterial {
+	string name;
+	vec4 baseColor = vec4(1, 1, 1, 1);
+	int image = -1;					// base color texture source
+};
+
+struct GltfImage {
+	string name, mimeType;
+	const unsigned char *data = NULL;	// encoded image in buffer view or data: uri
+	size_t size = 0;
+	string filename;				// if external, path relative to application
+};
+
+struct GltfNode {
+	string name;
+	int mesh = -1;
+	mat4 matrix;					// node transform (from matrix, or translation*rotation*scale)
+	vector<int> children;
+};
+
+class Gltf {
+public:
+	vector<GltfMesh> meshes;
+	vector<GltfMaterial> materials;
+	vector<GltfImage> images;
+	vector<GltfNode> nodes;
+	vector<int> roots;				// nodes of default scene (or, if no scenes, all nodes without parent)
+	bool Open(const char *filename);
+		// map file and parse JSON; return false if missing or malformed
+	void Close();
+	Gltf() { }
+	~Gltf() { Close(); }
+private:
+	MappedFile file;
+	vector<MappedFile *> externals;	// separate .bin files
+	vector<string> decoded;			// base64 data: uris
+	Gltf(const Gltf &);
+	Gltf &operator = (const Gltf &);
+};
 
 #endif
@@ -0,0 +1,91 @@
+// Int3Map.h - flat open-addressing hash table from int3 to int
+
+#ifndef INT3MAP_HDR
+#define INT3MAP_HDR
+
+#include <stddef.h>
+#include <vector>
+#include "VecMat.h"
+
+class Int3Map {
+	// linear probing over a power-of-two table, kept at most half full
+	// no per-entry allocation; Reserve before inserting to avoid rehashing
+public:
+	Int3Map(size_t n = 0) { Reserve(n); }
+	size_t Size() const { return count; }
+	void Clear() {
+		for (size_t i = 0; i < slots.size(); i++)
+			slots[i].tag = 0;
+		count = 0;
+	}
+	void Reserve(size_t n) {
+		// ensure n entries fit without rehashing
+		size_t capacity = 16;
+		while (capacity < 2*n)
+			capacity <<= 1;
+		if (capacity > slots.size())
+			Rehash(capacity);
+	}
+	const int *Find(const int3 &key) const {
+		// return pointer to value, or NULL if key absent
+		if (!count)
+			return NULL;
+		unsigned tag = Tag(key);
+		for (size_t i = tag & mask; slots[i].tag; i = (i+1) & mask)
+			if (slots[i].tag == tag && Equal(slots[i].key, key))
+				return &slots[i].value;
+		return NULL;
+	}
+	int *Insert(const int3 &key, int value, bool &inserted) {
+		// if key absent, add (key, value); return pointer to value stored for key
+		if (2*(count+1) > slots.size())
+			Rehash(slots.size() < 16? 16 : 2*slots.size());
+		unsigned tag = Tag(key);
+		size_t i = tag & mask;
+		for (; slots[i].tag; i = (i+1) & mask)
+			if (slots[i].tag == tag && Equal(slots[i].key, key)) {
+				inserted = false;
+				return &slots[i].value;
+			}
+		slots[i].tag = tag;
+		slots[i].key = key;
+		slots[i].value = value;
+		count++;
+		inserted = true;
+		return &slots[i].value;
+	}
+	int &operator[](const int3 &key) {
+		// as std::map: insert zero if key absent
+		bool inserted;
+		return *Insert(key, 0, inserted);
+	}
+private:
+	struct Slot { int3 key; int value = 0; unsigned tag = 0; };	// tag 0: empty
+	std::vector<Slot> slots;
+	size_t mask = 0, count = 0;
+	static bool Equal(const int3 &a, const int3 &b) { return a.i1 == b.i1 && a.i2 == b.i2 && a.i3 == b.i3; }
+	static unsigned Tag(const int3 &key) {
+		// mix packed triple (murmur3 finalizer); never 0
+		unsigned h = (unsigned) key.i1*0x9e3779b1u ^ (unsigned) key.i2*0x85ebca77u ^ (unsigned) key.i3*0xc2b2ae3du;
+		h ^= h >> 16;
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+		h *= 0xc2b2ae35u;
+		h ^= h >> 16;
+		return h? h : 1;
+	}
+	void Rehash(size_t capacity) {
+		std::vector<Slot> old(capacity);
+		old.swap(slots);
+		mask = capacity-1;
+		for (size_t k = 0; k < old.size(); k++)
+			if (old[k].tag) {
+				size_t i = old[k].tag & mask;
+				while (slots[i].tag)
+					i = (i+1) & mask;
+				slots[i] = old[k];
+			}
+	}
+};
+
+#endif
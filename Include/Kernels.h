@@ -0,0 +1,31 @@
+// Kernels.h - bulk geometry over arrays of points: transform, bounds, standardize
+// each kernel has SSE and AVX2 paths, chosen at run time (scalar elsewhere), and splits large arrays among threads
+
+#ifndef KERNELS_HDR
+#define KERNELS_HDR
+
+#include "VecMat.h"
+
+enum SimdLevel { SimdScalar = 0, SimdSSE, SimdAVX2 };
+
+SimdLevel Simd();
+	// widest instruction set supported by this CPU, or as set by SetSimd
+
+void SetSimd(SimdLevel level);
+	// limit kernels to level (eg, to compare paths); a level the CPU lacks is lowered to one it has
+
+void TransformPoints(const vec3 *in, vec3 *out, int n, const mat4 &m, int nThreads = 0);
+	// out[i] = Vec3(m*vec4(in[i], 1)); in and out may be the same array
+	// nThreads 0: all cores if n is large, else one
+
+void TransformVectors(const vec3 *in, vec3 *out, int n, const mat4 &m, bool unitLength = false, int nThreads = 0);
+	// out[i] = Vec3(m*vec4(in[i], 0)), normalized if unitLength
+	// to transform normals, m should be the inverse transpose of the point transform
+
+void MinMax(const vec3 *points, int n, vec3 &min, vec3 &max, int nThreads = 0);
+	// componentwise least and greatest of points; if n is 0, min is +FLT_MAX, max is -FLT_MAX
+
+void ScaleOffset(vec3 *points, int n, vec3 scale, vec3 offset, int nThreads = 0);
+	// points[i] = points[i]*scale+offset (eg, to standardize)
+
+#endif
@@ -5,6 +5,7 @@
 
 #include <vector>
 #include "glad.h"
+#include "BVH.h"
 #include "Camera.h"
 #include "IO.h"
 #include "Quaternion.h"
@@ -24,7 +25,7 @@ class Mesh {
 public:
 	Mesh() { };
 	Mesh(const char *filename) { Read(string(filename)); }
-	~Mesh() { glDeleteBuffers(1, &vBufferId); };
+	~Mesh() { glDeleteBuffers(1, &vBufferId); glDeleteBuffers(1, &mtlBuffer); };
 	string objFilename, texFilename;
 	// vertices and facets
 	vector<vec3>	points;
@@ -47,29 +48,133 @@ public:
 	GLuint			vBufferId = 0;	// vertex buffer
 	GLuint			eBufferId = 0;	// element (triangle) buffer
 	GLuint			textureName = 0;
+	// materials, sorted so each is one contiguous range of triangles (see SortTrianglesByMaterial)
+	struct MtlBatch { int startTriangle = 0, nTriangles = 0; GLuint textureName = 0; };
+	vector<MtlBatch> mtlBatches;	// consecutive materials with same texture map, drawn together
+	GLuint			mtlBuffer = 0;	// uniform buffer of material parameters
+	// compact vertex layout (opt-in): 8-byte positions, 4-byte normals, 4-byte uvs
+	bool			compact = false;	// if set before Buffer (or Read): positions quantized to 16 bits within bounds,
+										// octahedral normals, half-float uvs, 16-bit indices if <= 65536 vertices
+	mat4			dequantize;			// set by Buffer: object space from quantized positions (drawn with toWorld*dequantize)
+	bool			octNormals = false;	// set by Buffer: normal attribute is octahedral-encoded
+	GLenum			indexType = GL_UNSIGNED_INT;	// set by Buffer: element buffer type
+	bool			optimizeOrder = false;	// if set before Read: reorder triangles for vertex cache and overdraw,
+											// vertices for fetch (see OptimizeTriangleOrder), report ACMR
+	// levels of detail: coarser triangle sets that share the vertex buffer, following triangles in the element buffer
+	struct Lod {
+		vector<int3> triangles;
+		vector<int> starts;			// position in triangles of each lodBounds entry
+		float error = 0;			// object-space distance from full resolution (estimate)
+		int startTriangle = 0;		// offset in element buffer (set by Buffer)
+	};
+	vector<Lod>		lods;			// increasingly coarse (see BuildLods)
+	vector<int>		lodBounds;		// group and material boundaries (see TriangleRangeBounds)
+	vec3			lodCenter;		// bounding sphere of points
+	float			lodRadius = 0;
+	int				lodLevels = 0;	// if set before Read: # levels built (see BuildLods)
+	float			lodPixelError = 1;	// Display selects the coarsest level with error within this many pixels
+	// meshlets: small clusters of triangles, culled per frame against the view frustum and for facing away
+	vector<Meshlet>	meshlets;		// contiguous, ascending ranges of triangles (see BuildMeshlets)
+	bool			buildMeshlets = false;		// if set before Read: BuildMeshlets
+	bool			cullBackfacing = true;		// cull meshlets facing away from the eye (not for two-sided surfaces)
+	// picking
+	BVH				bvh;			// over triangles and quads, in object space (see BuildBVH)
 	// operations
 	void Clear();
 	void Buffer();
 	void Buffer(vector<vec3> &pts, vector<vec3> *nrms = NULL, vector<vec2> *uvs = NULL);
 		// if non-null, nrms and uvs assumed same size as pts
+	void Buffer(const MeshBin &bin);
+		// load vertex and element buffers directly from memory-mapped cache
+	void Buffer(const GltfPrimitive &p);
+		// load vertex and element buffers directly from glTF buffer views (attributes keep glTF type and stride)
+		// presumes points, normals, uvs, triangles already set from p (see ReadGltf)
+	void BufferMaterials();
+		// load material parameters and texture maps, set mtlBatches (called by Buffer)
 	void Set(vector<vec3> &pts, vector<vec3> *nrms = NULL, vector<vec2> *tex = NULL,
 			 vector<int> *tris = NULL, vector<int> *quads = NULL);
+	void Set(vector<vec3> &pts, vector<int3> &tris, vector<vec3> *nrms = NULL);
+		// set points, triangles (eg, from indexed ReadSTL), optional normals, and buffer
 	void SetToWorld();
 		// for this mesh set toWorld given parent and wrtParent; recurse on children
 	bool SetWrtParent();
 		// for this mesh set wrtParent given parent and toWorld
+	void BuildLods(int nLevels = 4, float ratio = .5f, int nThreads = 0);
+		// set lods, each with about ratio times the triangles of the previous level, simplified (by SimplifyTriangles)
+		// within each group and material range; points shared by ranges or coincident (seams) are kept
+		// stops early if a level can't be reduced by 10%; call before Buffer
+	int SelectLod(const Camera &camera, int viewportHeight, int bias = 0);
+		// 0 (full resolution) or 1+index into lods of the coarsest level whose error, projected by camera.persp at the
+		// nearest point of the bounding sphere, is within lodPixelError (if lodPixelError <= 0, 0); bias levels coarser
+	void LodRange(int lod, int startTriangle, int nTriangles, int &lodStart, int &lodCount);
+		// element buffer range, in triangles, of a group or material range at level lod
+	void BuildMeshlets(int maxVertices = 64, int maxTriangles = 124);
+		// reorder triangles into meshlets (within group and material ranges); call before BuildLods and Buffer
+	int CullMeshlets(const Camera &camera, vector<char> &visible);
+		// set visible per meshlet by its bounding sphere (against the frustum) and normal cone; return # visible
+	void DrawTriangles(int lod, int startTriangle, int nTriangles, const vector<char> *visibleMeshlets = NULL);
+		// with vertex array and element buffer bound, draw a group or material range of triangles at level lod;
+		// at full resolution, if visibleMeshlets, draw only its visible meshlets (one glMultiDrawElements)
+	void BuildBVH(int nThreads = 0);
+		// build bvh from points, triangles and quads; call again after they change
+	bool RefitBVH(float rebuildRatio = 2, int nThreads = 0);
+		// after points move (eg, skinning or morphing): refit bvh, or rebuild it (return true) if quality degrades
+	int IntersectWithLine(vec3 p1, vec3 p2, float &alpha);
+		// line through p1, p2 (world space) against the mesh as placed by toWorld; build bvh if empty
+		// return as BVH::IntersectWithLine: nearest triangle, triangles.size()+q for quad q, or -1
+		// intersection = p1+alpha*(p2-p1)
 	void Display(Camera camera, int textureUnit = -1, bool lines = false, bool useGroupColor = false);
+		// draws level of detail given by SelectLod, if lods built; at full resolution, culls meshlets, if built
 		// texture is enabled if textureUnit >= 0 and textureName set
+		// if the mesh has materials (and not useGroupColor), draw one batch per texture map with material colors
 		// before this call, app must optionally change uniforms from their default, including:
 		//     nLights, lights, color, opacity, ambient
 		//     useLight, useTint, fwdFacingOnly, facetedShading
 		//     outlineColor, outlineWidth, transition
-	bool Read(string objFile, mat4 *m = NULL, bool standardize = true, bool buffer = true, bool forceTriangles = false);
+	bool Read(string objFile, mat4 *m = NULL, bool standardize = true, bool buffer = true, bool forceTriangles = false, bool cache = true);
 		// read in object file (with normals, uvs), initialize matrix, build vertex buffer
-	bool Read(string objFile, string texFile, mat4 *m = NULL, bool standardize = true, bool buffer = true, bool forceTriangles = false);
+		// objFile may be OBJ or (by .fbx extension) binary FBX
+		// if cache, use <objFile>.meshbin if written since objFile last modified, else write it
+	bool Read(string objFile, string texFile, mat4 *m = NULL, bool standardize = true, bool buffer = true, bool forceTriangles = false, bool cache = true);
 		// read in object file (with normals, uvs) and texture file, initialize matrix, build vertex buffer
 };
 
+// glTF
+
+bool ReadGltf(const char *filename, vector<Mesh> &meshes, bool standardize = true, bool buffer = true);
+	// read .gltf or .glb file into meshes (cleared first; elements must not be copied, as they point to each other)
+	// meshes[0] is an empty root whose children are the scene nodes; each node is a mesh, and each primitive beyond
+	// a node's first is a child mesh; parent, children, and wrtParent follow the node hierarchy, and toWorld is set
+	// if standardize, the root wrtParent fits the scene to -1,+1 (vertices unchanged)
+	// base color factor and texture become a single material (embedded images loaded by LoadTexture)
+
+// Incremental Loading
+
+class MeshLoader {
+	// read an OBJ file into a mesh over several frames without stalling the display loop:
+	//     loader.Start(&mesh, objFile);
+	//     each frame: if (!loader.Done()) loader.Step(4000); mesh.Display(camera);
+	// triangles are buffered as they are read, so the mesh appears progressively;
+	// once Done, the mesh is as if set by Mesh::Read (without cache)
+public:
+	bool Start(Mesh *mesh, string objFile, bool standardize = true, bool forceTriangles = false);
+		// clear mesh and open objFile; return false if it can't be opened
+	bool Step(int budgetMicroseconds);
+		// parse and buffer for about budgetMicroseconds; return false if error
+	bool Done() { return !mesh || reader.Done(); }
+	float Progress() { return reader.Progress(); }
+	~MeshLoader() { Release(); }
+private:
+	Mesh *mesh = NULL;
+	ObjReader reader;
+	bool standardize = true;
+	mat4 preview;					// approximate standardization while loading
+	size_t vCapacity = 0, tCapacity = 0, nVertices = 0, nNormals = 0, nTriangles = 0;	// buffered so far
+	void Upload();
+	void Finish();
+	void Release();
+};
+
 struct TriInfo {
 	vec4 plane;
 	int majorPlane = 0; // 0: XY, 1: XZ, 2: YZ
@@ -94,7 +199,14 @@ void BuildQuadInfos(vector<vec3> &points, vector<int4> &quads, vector<QuadInfo>
 int IntersectWithLine(vec3 p1, vec3 p2, vector<TriInfo> &triInfos, float &alpha);
 	// return triangle index of nearest intersected triangle, or -1 if none
 	// intersection = p1+alpha*(p2-p1)
+	// tests every triangle; for large meshes, see Mesh::IntersectWithLine and BVH
 
 int IntersectWithLine(vec3 p1, vec3 p2, vector<QuadInfo> &quadInfos, float &alpha);
 
+void SetTopBVH(TopBVH &top, vector<Mesh *> &meshes, int nThreads = 0);
+	// build top over meshes (instance i is meshes[i], placed by its toWorld); build each mesh bvh if empty
+
+void UpdateTopBVH(TopBVH &top, vector<Mesh *> &meshes);
+	// after meshes move (eg, by SetToWorld), or their bvhs refit: update instance transforms and refit top
+
 #endif
@@ -0,0 +1,42 @@
+// Parallel.h - fork-join parallel loop over std::thread
+
+#ifndef PARALLEL_HDR
+#define PARALLEL_HDR
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+inline int NumThreads(int nThreads = 0) {
+	// return nThreads if positive, else # hardware threads
+	if (nThreads > 0)
+		return nThreads;
+	int n = (int) std::thread::hardware_concurrency();
+	return n > 0? n : 1;
+}
+
+template<class Task> void ParallelFor(int nTasks, Task task, int nThreads = 0) {
+	// call task(i) for i in [0, nTasks); tasks are claimed in order by up to nThreads threads
+	// (nThreads 0: one per hardware thread); the calling thread participates, returns when all done
+	nThreads = NumThreads(nThreads);
+	if (nThreads > nTasks)
+		nThreads = nTasks;
+	if (nThreads <= 1) {
+		for (int i = 0; i < nTasks; i++)
+			task(i);
+		return;
+	}
+	std::atomic<int> next(0);
+	auto worker = [&]() {
+		for (int i; (i = next++) < nTasks; )
+			task(i);
+	};
+	std::vector<std::thread> threads;
+	for (int t = 1; t < nThreads; t++)
+		threads.push_back(std::thread(worker));
+	worker();
+	for (size_t t = 0; t < threads.size(); t++)
+		threads[t].join();
+}
+
+#endif
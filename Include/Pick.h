@@ -0,0 +1,53 @@
+// Pick.h - GPU picking: draw object and triangle ids to an integer framebuffer, read back near the cursor
+// cost depends on the pixels read, not on scene complexity, and the result is what is visible (depth-tested)
+// the read is asynchronous (pixel buffer and fence): call End after drawing, then Result in a later frame
+
+#ifndef PICK_HDR
+#define PICK_HDR
+
+#include "glad.h"
+#include "Camera.h"
+#include "Mesh.h"
+#include "Sprite.h"
+
+struct PickResult {
+	int object = -1;		// as passed to PickBuffer::Draw, or -1 if none
+	int triangle = -1;		// index into mesh triangles, triangles.size()+q for quad q (as BVH), or -1 for sprite
+	float depth = 1;		// window depth (0: near, 1: far)
+	int x = 0, y = 0;		// pixel, in window coordinates (origin lower-left)
+};
+
+class PickBuffer {
+public:
+	int radius = 2;
+		// read (2*radius+1)^2 pixels around the cursor; if the cursor pixel is empty, report the nearest drawn
+	bool Begin(int xmouse, int ymouse);
+		// bind id framebuffer (sized to the current viewport), clear it, and scissor drawing to the pixels read
+		// return false if the framebuffer can't be made
+	void Draw(Mesh &mesh, int object, Camera &camera);
+		// draw full resolution triangles (and quads, if GL_QUADS) as placed by mesh.toWorld; mesh must be buffered
+	void Draw(Sprite &sprite, int object, mat4 *view = NULL);
+		// draw the sprite's current frame, less its matte (as Sprite::Display)
+	void End();
+		// start reading pixels into the pixel buffer; restore read and draw framebuffers, textures of the
+		// active unit and units 0 and 1, active unit, scissor, depth test and program
+	bool Pending() const { return fence != NULL; }
+	bool Ready();
+		// has the read completed? (poll once per frame to avoid stalling the pipeline)
+	bool Result(PickResult &r, bool wait = false);
+		// if the read completed (or wait), set r and return true; r.object is -1 if nothing drawn near the cursor
+	void Release();
+	~PickBuffer() { Release(); }
+private:
+	GLuint framebuffer = 0, idTexture = 0, depthBuffer = 0, pixelBuffer = 0;
+	GLsync fence = NULL;
+	int width = 0, height = 0;				// framebuffer size
+	int x0 = 0, y0 = 0, w = 0, h = 0;		// pixels read
+	int xmouse = 0, ymouse = 0;
+	GLint oldDrawFramebuffer = 0, oldReadFramebuffer = 0, oldProgram = 0, oldScissor[4] = {0, 0, 0, 0};
+	GLint oldActiveTexture = GL_TEXTURE0, oldTextures[3] = {0, 0, 0};	// units 0, 1 and active
+	GLboolean oldScissorTest = GL_FALSE, oldDepthTest = GL_FALSE;
+	void RestoreBindings();
+};
+
+#endif
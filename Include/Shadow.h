@@ -10,6 +10,9 @@
 
 // Shadow Operations
 
+extern int shadowLodBias;
+	// shadow pass draws each mesh this many levels of detail coarser than the main pass (see Mesh::SelectLod)
+
 void ShadowDraw(Camera cam, vec3 light, int winWidth, int winHeight, Mesh *meshes[], int nMeshes);
 	// display meshes with shadow map built from light
 
@@ -31,27 +31,27 @@ class vec2 {
 public:
 	float x, y;
 	// constructors
-	vec2(float s = 0) : x(s), y(s) { }
-	vec2(float x, float y) : x(x), y(y) { }
-	vec2(double x, double y) : x((float) x), y((float) y) { }
-	vec2(float *p) : x(p[0]), y(p[1]) { }
-	vec2(const vec2 &v) : x(v.x), y(v.y) { }
-	vec2(const float *p) : x(p[0]), y(p[1]) { }
-	vec2(int xa, int ya) { x = (float) xa; y = (float) ya; }
+	constexpr vec2(float s = 0) : x(s), y(s) { }
+	constexpr vec2(float x, float y) : x(x), y(y) { }
+	constexpr vec2(double x, double y) : x((float) x), y((float) y) { }
+	constexpr vec2(float *p) : x(p[0]), y(p[1]) { }
+	constexpr vec2(const vec2 &v) = default;
+	constexpr vec2(const float *p) : x(p[0]), y(p[1]) { }
+	constexpr vec2(int xa, int ya) : x((float) xa), y((float) ya) { }
 	// access
 	float &operator [] (int i) { return *(&x+i); }
 	const float operator [] (int i) const { return *(&x+i); }
 	operator const float* () const { return static_cast<const float*>(&x); }
 	operator float* () { return static_cast<float*>(&x); }
 	// operations
-	vec2 operator - () const { return vec2(-x, -y); }
-	vec2 operator + (const vec2 &v) const { return vec2(x+v.x, y+v.y); }
-	vec2 operator - (const vec2 &v) const { return vec2(x-v.x, y-v.y); }
-	vec2 operator * (float s) const { return vec2(s*x, s*y); }
-	vec2 operator * (const vec2 &v) const { return vec2(x*v.x, y*v.y); }
-	friend vec2 operator * (float s, const vec2 &v) { return v*s; }
-	vec2 operator / (float s) const { float r = 1.f/s; return *this*r; }
-	vec2 operator / (const vec2 &v) const { return vec2(x/v.x, y/v.y); }
+	constexpr vec2 operator - () const { return vec2(-x, -y); }
+	constexpr vec2 operator + (const vec2 &v) const { return vec2(x+v.x, y+v.y); }
+	constexpr vec2 operator - (const vec2 &v) const { return vec2(x-v.x, y-v.y); }
+	constexpr vec2 operator * (float s) const { return vec2(s*x, s*y); }
+	constexpr vec2 operator * (const vec2 &v) const { return vec2(x*v.x, y*v.y); }
+	friend constexpr vec2 operator * (float s, const vec2 &v) { return v*s; }
+	constexpr vec2 operator / (float s) const { return *this*(1.f/s); }
+	constexpr vec2 operator / (const vec2 &v) const { return vec2(x/v.x, y/v.y); }
 	// reflexive
 	vec2 &operator += (const vec2 &v) { x += v.x; y += v.y; return *this; }
 	vec2 &operator -= (const vec2 &v) { x -= v.x; y -= v.y; return *this; }
@@ -60,8 +60,8 @@ public:
 	vec2 &operator /= (float s) { float r = 1.f/s; *this *= r; return *this; }
 };
 
-inline float dot(const vec2 &a, const vec2 &b) { return a.x*b.x+a.y*b.y; }
-inline float cross(const vec2 &v1, const vec2 &v2) { return v1.x*v2.y-v1.y*v2.x; }
+constexpr float dot(const vec2 &a, const vec2 &b) { return a.x*b.x+a.y*b.y; }
+constexpr float cross(const vec2 &v1, const vec2 &v2) { return v1.x*v2.y-v1.y*v2.x; }
 inline float length(const vec2 &v) { return sqrt(dot(v,v)); }
 inline vec2 normalize(const vec2 &v) { return v/length(v); }
 
@@ -82,23 +82,23 @@ class vec3 {
 public:
 	float  x, y, z;
 	// constructors
-	vec3(float s = 0) : x(s), y(s), z(s) { }
-	vec3(float x, float y, float z = 0) : x(x), y(y), z(z) { }
-	vec3(const vec3 &v) { x = v.x; y = v.y; z = v.z; }
-	vec3(const vec2 &v, float f = 0) { x = v.x; y = v.y; z = f; }
-	vec3(const float *p) : x(p[0]), y(p[1]), z(p[2]) { }
+	constexpr vec3(float s = 0) : x(s), y(s), z(s) { }
+	constexpr vec3(float x, float y, float z = 0) : x(x), y(y), z(z) { }
+	constexpr vec3(const vec3 &v) = default;
+	constexpr vec3(const vec2 &v, float f = 0) : x(v.x), y(v.y), z(f) { }
+	constexpr vec3(const float *p) : x(p[0]), y(p[1]), z(p[2]) { }
    // access
 	float &operator [] (int i) { return *(&x+i); } // causes ambiguity
 	const float operator [] (int i) const { return *(&x+i); }
 	// arithmetic
-	vec3 operator - () const { return vec3(-x, -y, -z); }
-	vec3 operator + (const vec3 &v) const { return vec3(x+v.x, y+v.y, z+v.z); }
-	vec3 operator - (const vec3 &v) const { return vec3(x-v.x, y-v.y, z-v.z); }
-	vec3 operator * (float s) const { return vec3(s*x, s*y, s*z); }
-	vec3 operator * (const vec3 &v) const { return vec3(x*v.x, y*v.y, z*v.z); }
-	friend vec3 operator * (float s, const vec3 &v) { return v*s; }
-	vec3 operator / (float s) const { float r = 1.f/s; return *this * r; }
-	vec3 operator / (const vec3 &v) const { return vec3(x/v.x, y/v.y, z/v.z); }
+	constexpr vec3 operator - () const { return vec3(-x, -y, -z); }
+	constexpr vec3 operator + (const vec3 &v) const { return vec3(x+v.x, y+v.y, z+v.z); }
+	constexpr vec3 operator - (const vec3 &v) const { return vec3(x-v.x, y-v.y, z-v.z); }
+	constexpr vec3 operator * (float s) const { return vec3(s*x, s*y, s*z); }
+	constexpr vec3 operator * (const vec3 &v) const { return vec3(x*v.x, y*v.y, z*v.z); }
+	friend constexpr vec3 operator * (float s, const vec3 &v) { return v*s; }
+	constexpr vec3 operator / (float s) const { return *this*(1.f/s); }
+	constexpr vec3 operator / (const vec3 &v) const { return vec3(x/v.x, y/v.y, z/v.z); }
 	// reflexive
 	vec3 &operator += (const vec3 &v) { x += v.x; y += v.y; z += v.z; return *this; }
 	vec3 &operator -= (const vec3 &v) { x -= v.x; y -= v.y; z -= v.z; return *this; }
@@ -107,13 +107,14 @@ public:
 	vec3 &operator /= (float s) { float r = 1.f/s; *this *= r; return *this; }
 };
 
-inline float dot(const vec3 &a, const vec3 &b) { return a.x*b.x+a.y*b.y+a.z*b.z; }
+constexpr float dot(const vec3 &a, const vec3 &b) { return a.x*b.x+a.y*b.y+a.z*b.z; }
 inline float length(const vec3 &v) { return sqrt(dot(v,v)); }
 inline vec3 normalize(const vec3 &v) { return v/length(v); }
-inline vec3 cross(const vec3 &a, const vec3 &b) { return vec3(a.y*b.z-a.z*b.y, a.z*b.x-a.x*b.z, a.x*b.y-a.y*b.x); }
+constexpr vec3 cross(const vec3 &a, const vec3 &b) { return vec3(a.y*b.z-a.z*b.y, a.z*b.x-a.x*b.z, a.x*b.y-a.y*b.x); }
 	// right-handed cross-product
 
 inline float Bounds(vec3 *points, int npoints, vec3 &min, vec3 &max) {
+	// for large arrays, MinMax (Kernels.h) is SIMD and multi-threaded
 	max = -(min = vec3(FLT_MAX));
 	for (int i = 0; i < npoints; i++) {
 		vec3 p = points[i];
@@ -126,41 +127,99 @@ inline float Bounds(vec3 *points, int npoints, vec3 &min, vec3 &max) {
 
 // 4D vector
 
-class vec4 {
+//  4D vector, SIMD
+
+// SSE on x86-64, NEON on ARM64 (elsewhere, eg 32-bit x86, vec4 and mat4 are scalar and unaligned)
+// vec4 and mat4 rows are 16-byte aligned so operators load and store whole registers
+// lanes compute in the same order as the scalar code, so results do not depend on the path taken
+
+#if defined(__x86_64__) || defined(_M_X64)
+	#include <xmmintrin.h>
+	#define VECMAT_SSE
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	#include <arm_neon.h>
+	#define VECMAT_NEON
+#endif
+
+#if defined(VECMAT_SSE) || defined(VECMAT_NEON)
+	#define VECMAT_SIMD
+	#define VECMAT_ALIGN alignas(16)
+#else
+	#define VECMAT_ALIGN
+#endif
+
+#ifdef VECMAT_SIMD
+namespace VecMatSimd {
+#ifdef VECMAT_SSE
+	typedef __m128 f4;
+	inline f4 Load(const float *p) { return _mm_load_ps(p); }
+	inline void Store(float *p, f4 a) { _mm_store_ps(p, a); }
+	inline f4 Splat(float s) { return _mm_set1_ps(s); }
+	inline f4 Add(f4 a, f4 b) { return _mm_add_ps(a, b); }
+	inline f4 Sub(f4 a, f4 b) { return _mm_sub_ps(a, b); }
+	inline f4 Mul(f4 a, f4 b) { return _mm_mul_ps(a, b); }
+	inline void Transpose(f4 &a, f4 &b, f4 &c, f4 &d) { _MM_TRANSPOSE4_PS(a, b, c, d); }
+#else
+	typedef float32x4_t f4;
+	inline f4 Load(const float *p) { return vld1q_f32(p); }
+	inline void Store(float *p, f4 a) { vst1q_f32(p, a); }
+	inline f4 Splat(float s) { return vdupq_n_f32(s); }
+	inline f4 Add(f4 a, f4 b) { return vaddq_f32(a, b); }
+	inline f4 Sub(f4 a, f4 b) { return vsubq_f32(a, b); }
+	inline f4 Mul(f4 a, f4 b) { return vmulq_f32(a, b); }
+	inline void Transpose(f4 &a, f4 &b, f4 &c, f4 &d) {
+		float32x4x2_t ab = vtrnq_f32(a, b), cd = vtrnq_f32(c, d);
+		a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+		b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+		c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+		d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+	}
+#endif
+}
+#endif
+
+class VECMAT_ALIGN vec4 {
 public:
 	float x, y, z, w;
 	// constructors
-	vec4(float s = 0) : x(s), y(s), z(s), w(s) { }
-	vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) { }
-	vec4(const vec4 &v) { x = v.x; y = v.y;  z = v.z;  w = v.w; }
-	vec4(float *p) : x(p[0]), y(p[1]), z(p[2]), w(p[3]) { }
-	vec4(const vec2 &v, float z = 0, float w = 1) : x(v.x), y(v.y), z(z), w(w) { }
-	vec4(const vec3 &v, float w = 1) : x(v.x), y(v.y), z(v.z), w(w) { }
+	constexpr vec4(float s = 0) : x(s), y(s), z(s), w(s) { }
+	constexpr vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) { }
+	constexpr vec4(const vec4 &v) = default;
+	constexpr vec4(float *p) : x(p[0]), y(p[1]), z(p[2]), w(p[3]) { }
+	constexpr vec4(const vec2 &v, float z = 0, float w = 1) : x(v.x), y(v.y), z(z), w(w) { }
+	constexpr vec4(const vec3 &v, float w = 1) : x(v.x), y(v.y), z(v.z), w(w) { }
 	// access
 	float &operator [] (int i) { return *(&x+i); }
 	const float operator [] (int i) const { return *(&x+i); }
 	operator const float* () const { return static_cast<const float*>(&x); }
 	operator float* () { return static_cast<float*>(&x); }
 	// arithmetic
-	vec4 operator - () const { return vec4(-x, -y, -z, -w); }
+	constexpr vec4 operator - () const { return vec4(-x, -y, -z, -w); }
+#ifdef VECMAT_SIMD
+	vec4 operator + (const vec4 &v) const { vec4 r; VecMatSimd::Store(&r.x, VecMatSimd::Add(VecMatSimd::Load(&x), VecMatSimd::Load(&v.x))); return r; }
+	vec4 operator - (const vec4 &v) const { vec4 r; VecMatSimd::Store(&r.x, VecMatSimd::Sub(VecMatSimd::Load(&x), VecMatSimd::Load(&v.x))); return r; }
+	vec4 operator * (float s) const { vec4 r; VecMatSimd::Store(&r.x, VecMatSimd::Mul(VecMatSimd::Splat(s), VecMatSimd::Load(&x))); return r; }
+	vec4 operator * (const vec4 &v) const { vec4 r; VecMatSimd::Store(&r.x, VecMatSimd::Mul(VecMatSimd::Load(&x), VecMatSimd::Load(&v.x))); return r; }
+#else
 	vec4 operator + (const vec4 &v) const { return vec4(x+v.x, y+v.y, z+v.z, w+v.w); }
 	vec4 operator - (const vec4 &v) const { return vec4(x-v.x, y-v.y, z-v.z, w-v.w); }
 	vec4 operator * (float s) const { return vec4(s*x, s*y, s*z, s*w); }
-	vec4 operator * (const vec4 &v) const { return vec4(x*v.x, y*v.y, z*v.z, w*v.z); }
+	vec4 operator * (const vec4 &v) const { return vec4(x*v.x, y*v.y, z*v.z, w*v.w); }
+#endif
 	friend vec4 operator * (float s, const vec4& v) { return v*s; }
 	vec4 operator / (float s) const { float r = 1.f/s; return *this*r; }
 	// reflexive
-	vec4 &operator += (const vec4 &v) { x += v.x;  y += v.y;  z += v.z;  w += v.w; return *this; }
-	vec4 &operator -= (const vec4 &v) { x -= v.x;  y -= v.y;  z -= v.z;  w -= v.w; return *this; }
-	vec4 &operator *= (float s) { x *= s;  y *= s;  z *= s;  w *= s; return *this; }
-	vec4 &operator *= (const vec4 &v) { x *= v.x, y *= v.y, z *= v.z, w *= v.w; return *this; }
+	vec4 &operator += (const vec4 &v) { return *this = *this+v; }
+	vec4 &operator -= (const vec4 &v) { return *this = *this-v; }
+	vec4 &operator *= (float s) { return *this = *this*s; }
+	vec4 &operator *= (const vec4 &v) { return *this = *this*v; }
 	vec4 &operator /= (float s) { float r = 1.f/s; *this *= r; return *this; }
 };
 
-inline float dot(const vec4 &a, const vec4 &b) { return a.x*b.x+a.y*b.y+a.z*b.z+a.w*b.w; }
+constexpr float dot(const vec4 &a, const vec4 &b) { return a.x*b.x+a.y*b.y+a.z*b.z+a.w*b.w; }
 inline float length(const vec4 &v) { return sqrt(dot(v, v)); }
 inline vec4 normalize(const vec4 &v) { return v/length(v); }
-inline vec3 Vec3(vec4 v) { return vec3(v.x, v.y, v.z); }
+constexpr vec3 Vec3(vec4 v) { return vec3(v.x, v.y, v.z); }
 
 // integer pair and triplet
 
@@ -168,34 +227,34 @@ inline int Flint(float x) { return (int) floor(x); }
 
 struct int2 {
 	int i1, i2;
-	int2() { i1 = i2 = 0; }
-	int2(int i1, int i2) : i1(i1), i2(i2) { }
+	constexpr int2() : i1(0), i2(0) { }
+	constexpr int2(int i1, int i2) : i1(i1), i2(i2) { }
 	int2(vec2 v) : i1(Flint(v.x)), i2(Flint(v.y)) { }
 	int &operator [] (int i) { return *(&i1+i); }
 	const int operator [] (int i) const { return *(&i1+i); }
 	bool operator == (const int2 &rhs) { return this->i1 == rhs.i1 && this->i2 == rhs.i2; }
-	int2 operator + (const int2 &v) const { return int2(i1+v.i1, i2+v.i2); }
-	int2 operator - (const int2 &v) const { return int2(i1-v.i1, i2-v.i2); }
+	constexpr int2 operator + (const int2 &v) const { return int2(i1+v.i1, i2+v.i2); }
+	constexpr int2 operator - (const int2 &v) const { return int2(i1-v.i1, i2-v.i2); }
 };
 
 struct int3 {
 	int i1, i2, i3;
-	int3() { i1 = i2 = i3 = 0; }
-	int3(int *i) : i1(i[0]), i2(i[1]), i3(i[2]) { }
-	int3(int i1, int i2, int i3) : i1(i1), i2(i2), i3(i3) { }
+	constexpr int3() : i1(0), i2(0), i3(0) { }
+	constexpr int3(int *i) : i1(i[0]), i2(i[1]), i3(i[2]) { }
+	constexpr int3(int i1, int i2, int i3) : i1(i1), i2(i2), i3(i3) { }
 	int3(vec3 v) : i1(Flint(v.x)), i2(Flint(v.y)), i3(Flint(v.z)) { }
 	int &operator [] (int i) { return *(&i1+i); }
 	const int operator [] (int i) const { return *(&i1+i); }
 	bool operator == (const int3 &rhs) { return this->i1 == rhs.i1 && this->i2 == rhs.i2 && this->i3 == rhs.i3; }
-	int3 operator + (const int3 &v) const { return int3(i1+v.i1, i2+v.i2, i3+v.i3); }
-	int3 operator - (const int3 &v) const { return int3(i1-v.i1, i2-v.i2, i3-v.i3); }
+	constexpr int3 operator + (const int3 &v) const { return int3(i1+v.i1, i2+v.i2, i3+v.i3); }
+	constexpr int3 operator - (const int3 &v) const { return int3(i1-v.i1, i2-v.i2, i3-v.i3); }
 };
 
 struct int4 {
 	int i1, i2, i3, i4;
-	int4() { i1 = i2 = i3 = i4 = 0; }
-	int4(int *i) : i1(i[0]), i2(i[1]), i3(i[2]), i4(i[3]) { }
-	int4(int i1, int i2, int i3, int i4) : i1(i1), i2(i2), i3(i3), i4(i4) { }
+	constexpr int4() : i1(0), i2(0), i3(0), i4(0) { }
+	constexpr int4(int *i) : i1(i[0]), i2(i[1]), i3(i[2]), i4(i[3]) { }
+	constexpr int4(int i1, int i2, int i3, int i4) : i1(i1), i2(i2), i3(i3), i4(i4) { }
 	int4(vec4 v) : i1(Flint(v.x)), i2(Flint(v.y)), i3(Flint(v.z)), i4(Flint(v.w)) { }
 	int &operator [] (int i) { return *(&i1+i); }
 	const int operator [] (int i) const { return *(&i1+i); }
@@ -208,12 +267,12 @@ class mat3 {
 public:
 	vec3 row[3];
 	//  constructors
-	mat3(float diag = 1) { row[0].x = row[1].y = row[2].z = diag; }
-	mat3(const vec3 &r0, const vec3 &r1, const vec3 &r2) { row[0] = r0; row[1] = r1; row[2] = r2; }
-	mat3(const mat3 &m) { for (int i = 0; i < 3; i++) row[i] = m.row[i]; }
+	constexpr mat3(float diag = 1) : row{vec3(diag, 0, 0), vec3(0, diag, 0), vec3(0, 0, diag)} { }
+	constexpr mat3(const vec3 &r0, const vec3 &r1, const vec3 &r2) : row{r0, r1, r2} { }
+	constexpr mat3(const mat3 &m) = default;
 	// access
 	vec3 &operator [] (int i) { return row[i]; }
-	const vec3 &operator [] (int i) const { return row[i]; }
+	constexpr const vec3 &operator [] (int i) const { return row[i]; }
 	operator const float *() const { return static_cast<const float*>(&row[0].x); }
 	// methods
 	mat3 operator * (float s) const { return mat3(s*row[0], s*row[1], s*row[2]); }
@@ -226,7 +285,7 @@ public:
 					a[i][j] += row[i][k]*m[k][j];
 		return a;
 	}
-	vec3 operator * (const vec3 &v) const { return vec3(dot(row[0], v), dot(row[1], v), dot(row[2], v)); }
+	constexpr vec3 operator * (const vec3 &v) const { return vec3(dot(row[0], v), dot(row[1], v), dot(row[2], v)); }
 };
 
 // 4x4 matrix
@@ -247,114 +306,147 @@ public:
 //     Scale, Translate, RotateX, RotateY, RotateZ
 //     Orthographic, Perspective
 //     LookAt, Transpose
+// inverses
+//     Invert, InvertAffine, InvertRigid
 
-class mat4 {
+class VECMAT_ALIGN mat4 {
 public:
 	vec4 row[4];
 	//  constructors
-	mat4(float diag = 1) { row[0].x = row[1].y = row[2].z = row[3].w = diag; }
-	mat4(const vec4 &r0, const vec4 &r1, const vec4 &r2, const vec4 &r3) { row[0] = r0; row[1] = r1; row[2] = r2; row[3] = r3; }
-	mat4(const mat4 &m) { for (int i = 0; i < 4; i++) row[i] = m.row[i]; }
-	mat4(const mat3 &m) {
-		for (int i = 0; i < 3; i++)
-			for (int j = 0; j < 3; j++)
-				row[i][j] = m[i][j];
-		row[3][3] = 1;
-	}
+	constexpr mat4(float diag = 1) : row{vec4(diag, 0, 0, 0), vec4(0, diag, 0, 0), vec4(0, 0, diag, 0), vec4(0, 0, 0, diag)} { }
+	constexpr mat4(const vec4 &r0, const vec4 &r1, const vec4 &r2, const vec4 &r3) : row{r0, r1, r2, r3} { }
+	constexpr mat4(const mat4 &m) = default;
+	constexpr mat4(const mat3 &m) : row{vec4(m.row[0], 0), vec4(m.row[1], 0), vec4(m.row[2], 0), vec4(0, 0, 0, 1)} { }
 	// access
 	vec4 &operator [] (int i) { return row[i]; }
-	const vec4 &operator [] (int i) const { return row[i]; }
+	constexpr const vec4 &operator [] (int i) const { return row[i]; }
 	operator const float *() const { return static_cast<const float*>(&row[0].x); }
 	// methods
 	mat4 operator * (float s) const { return mat4(s*row[0], s*row[1], s*row[2], s*row[3]); }
 	friend mat4 operator * (float s, const mat4 &m) { return m*s; }
 	mat4 operator * (const mat4 &m) const {
+#ifdef VECMAT_SIMD
+		// row i of product is sum over k of row[i][k]*m[k]
+		using namespace VecMatSimd;
+		f4 m0 = Load(&m[0].x), m1 = Load(&m[1].x), m2 = Load(&m[2].x), m3 = Load(&m[3].x);
+		mat4 a;
+		for (int i = 0; i < 4; i++) {
+			const vec4 &r = row[i];
+			f4 s = Mul(Splat(r.x), m0);
+			s = Add(s, Mul(Splat(r.y), m1));
+			s = Add(s, Mul(Splat(r.z), m2));
+			Store(&a[i].x, Add(s, Mul(Splat(r.w), m3)));
+		}
+		return a;
+#else
 		mat4 a(0);
 		for (int i = 0; i < 4; i++)
 			for (int j = 0; j < 4; j++)
 				for (int k = 0; k < 4; k++)
 					a[i][j] += row[i][k]*m[k][j];
 		return a;
+#endif
+	}
+	vec4 operator * (const vec4 &v) const {
+#ifdef VECMAT_SIMD
+		// sum columns scaled by v, which adds the terms of each row dot product in the scalar order
+		using namespace VecMatSimd;
+		f4 c0 = Load(&row[0].x), c1 = Load(&row[1].x), c2 = Load(&row[2].x), c3 = Load(&row[3].x);
+		Transpose(c0, c1, c2, c3);
+		f4 s = Add(Add(Add(Mul(c0, Splat(v.x)), Mul(c1, Splat(v.y))), Mul(c2, Splat(v.z))), Mul(c3, Splat(v.w)));
+		vec4 r;
+		Store(&r.x, s);
+		return r;
+#else
+		return vec4(dot(row[0], v), dot(row[1], v), dot(row[2], v), dot(row[3], v));
+#endif
 	}
-	vec4 operator * (const vec4 &v) const { return vec4(dot(row[0], v), dot(row[1], v), dot(row[2], v), dot(row[3], v)); }
 };
 
-inline mat4 Scale(float x, float y, float z) {
-	mat4 c;
-	c[0][0] = x;
-	c[1][1] = y;
-	c[2][2] = z;
-	return c;
+constexpr mat4 Scale(float x, float y, float z) {
+	return mat4(vec4(x, 0, 0, 0), vec4(0, y, 0, 0), vec4(0, 0, z, 0), vec4(0, 0, 0, 1));
 }
 
-inline mat4 Scale(vec3 s) { return Scale(s.x, s.y, s.z); }
+constexpr mat4 Scale(vec3 s) { return Scale(s.x, s.y, s.z); }
 
-inline mat4 Translate(float x, float y, float z) {
-	mat4 c;
-	c[0][3] = x;
-	c[1][3] = y;
-	c[2][3] = z;
-	return c;
+constexpr mat4 Translate(float x, float y, float z) {
+	return mat4(vec4(1, 0, 0, x), vec4(0, 1, 0, y), vec4(0, 0, 1, z), vec4(0, 0, 0, 1));
 }
 
-inline mat4 Translate(vec3 t) { return Translate(t.x, t.y, t.z); }
+constexpr mat4 Translate(vec3 t) { return Translate(t.x, t.y, t.z); }
 
 // arguments to RotateX/Y/Z are in degrees
-static float DegreesToRadians = 3.14159265358f/180.f;
-
-inline mat4 RotateX(float theta) {
-	float angle = DegreesToRadians*theta;
-	mat4 c;
-	c[2][2] = c[1][1] = cos(angle);
-	c[2][1] = sin(angle);
-	c[1][2] = -c[2][1];
-	return c;
+constexpr float DegreesToRadians = 3.14159265358f/180.f;
+
+// constexpr sine and cosine of an angle in degrees, so rotations can be built at compile time
+// the angle is reduced to +/-45 degrees about a multiple of 90 (which is exact), then a double
+// precision Taylor series is summed; results are within a float ulp of sin/cos, exact at multiples of 90
+
+constexpr double SinTaylor(double r) {
+	// sin(r) for |r| <= pi/4
+	double r2 = r*r, term = r, sum = r;
+	for (int n = 1; n < 9; n++) {
+		term *= -r2/((2*n)*(2*n+1));
+		sum += term;
+	}
+	return sum;
+}
+
+constexpr double CosTaylor(double r) {
+	// cos(r) for |r| <= pi/4
+	double r2 = r*r, term = 1, sum = 1;
+	for (int n = 1; n < 9; n++) {
+		term *= -r2/((2*n-1)*(2*n));
+		sum += term;
+	}
+	return sum;
+}
+
+constexpr float SinCosDegrees(float degrees, bool cosine) {
+	double d = degrees, q = d/90.;
+	long long k = (long long) (q < 0? q-.5 : q+.5);
+	double r = (d-90.*k)*(3.14159265358979323846/180.);
+	int quadrant = (int) (k & 3)+(cosine? 1 : 0);
+	double v = quadrant & 1? CosTaylor(r) : SinTaylor(r);
+	return (float) ((quadrant & 2)? -v : v);
+}
+
+constexpr float SinDegrees(float degrees) { return SinCosDegrees(degrees, false); }
+constexpr float CosDegrees(float degrees) { return SinCosDegrees(degrees, true); }
+
+constexpr mat4 RotateX(float theta) {
+	float c = CosDegrees(theta), s = SinDegrees(theta);
+	return mat4(vec4(1, 0, 0, 0), vec4(0, c, -s, 0), vec4(0, s, c, 0), vec4(0, 0, 0, 1));
 }
 
-inline mat4 RotateY(float theta) {
-	float angle = DegreesToRadians*theta;
-	mat4 c;
-	c[2][2] = c[0][0] = cos(angle);
-	c[0][2] = sin(angle);
-	c[2][0] = -c[0][2];
-	return c;
+constexpr mat4 RotateY(float theta) {
+	float c = CosDegrees(theta), s = SinDegrees(theta);
+	return mat4(vec4(c, 0, s, 0), vec4(0, 1, 0, 0), vec4(-s, 0, c, 0), vec4(0, 0, 0, 1));
 }
 
-inline mat4 RotateZ(float theta) {
-	float angle = DegreesToRadians*theta;
-	mat4 c;
-	c[0][0] = c[1][1] = cos(angle);
-	c[1][0] = sin(angle);
-	c[0][1] = -c[1][0];
-	return c;
+constexpr mat4 RotateZ(float theta) {
+	float c = CosDegrees(theta), s = SinDegrees(theta);
+	return mat4(vec4(c, -s, 0, 0), vec4(s, c, 0, 0), vec4(0, 0, 1, 0), vec4(0, 0, 0, 1));
 }
 
-inline mat4 Orthographic(float left, float right, float bottom, float top, float zNear = -1, float zFar = 1) {
-	mat4 c;
-	c[0][0] = 2.f/(right-left);
-	c[1][1] = 2.f/(top-bottom);
-	c[2][2] = 2.f/(zNear-zFar);
-	c[3][3] = 1.f;
-	c[0][3] = -(right+left)/(right-left);
-	c[1][3] = -(top+bottom)/(top-bottom);
-	c[2][3] = -(zFar+zNear)/(zFar-zNear);
-	return c;
+constexpr mat4 Orthographic(float left, float right, float bottom, float top, float zNear = -1, float zFar = 1) {
+	return mat4(vec4(2.f/(right-left), 0, 0, -(right+left)/(right-left)),
+				vec4(0, 2.f/(top-bottom), 0, -(top+bottom)/(top-bottom)),
+				vec4(0, 0, 2.f/(zNear-zFar), -(zFar+zNear)/(zFar-zNear)),
+				vec4(0, 0, 0, 1));
 }
 
-inline mat4 Perspective(float verticalFOV, float aspectRatio, float zNear, float zFar) {
+constexpr mat4 Perspective(float verticalFOV, float aspectRatio, float zNear, float zFar) {
 	// convert view frustum to +/-1 perspective/clip space
 	// zNear and zFar are positive distances (despite camera facing -z axis)
 	// view frustum defined by verticalFOV (top, bottom), aspectRatio (left, right) and near, far
 	// -1/+1 in perspective z defaults to full depth buffer
-	float t = tan(verticalFOV*DegreesToRadians/2.f);
+	float t = SinDegrees(verticalFOV/2.f)/CosDegrees(verticalFOV/2.f);
 	float fnDif = zFar-zNear;
-	mat4 m(0);
-	m[0][0] = 1.f/(aspectRatio*t);
-	m[1][1] = 1.f/t;
-	m[2][2] = -(zFar+zNear)/fnDif;
-	m[2][3] = -2.f*zFar*zNear/fnDif;
-	m[3][2] = -1.f;
-	return m;
+	return mat4(vec4(1.f/(aspectRatio*t), 0, 0, 0),
+				vec4(0, 1.f/t, 0, 0),
+				vec4(0, 0, -(zFar+zNear)/fnDif, -2.f*zFar*zNear/fnDif),
+				vec4(0, 0, -1, 0));
 }
 
 inline mat4 LookTowards(vec3 eye, vec3 lookV, vec3 up) {
@@ -375,10 +467,18 @@ inline mat4 LookTowards(vec3 eye, vec3 lookV, vec3 up) {
 inline mat4 LookAt(vec3 eye, vec3 lookat, vec3 up) { return LookTowards(eye, lookat-eye, up); }
 
 inline mat4 Transpose(mat4 m) {
+#ifdef VECMAT_SIMD
+	using namespace VecMatSimd;
+	f4 r0 = Load(&m[0].x), r1 = Load(&m[1].x), r2 = Load(&m[2].x), r3 = Load(&m[3].x);
+	Transpose(r0, r1, r2, r3);
+	Store(&m[0].x, r0); Store(&m[1].x, r1); Store(&m[2].x, r2); Store(&m[3].x, r3);
+	return m;
+#else
 	return mat4(vec4(m[0][0], m[1][0], m[2][0], m[3][0]),
 				vec4(m[0][1], m[1][1], m[2][1], m[3][1]),
 				vec4(m[0][2], m[1][2], m[2][2], m[3][2]),
 				vec4(m[0][3], m[1][3], m[2][3], m[3][3]));
+#endif
 }
 
 inline bool InverseMatrix4x4(const float *m, float *out) {
@@ -424,9 +524,42 @@ inline bool InverseMatrix4x4(const float *m, float *out) {
 	return h.invert(out);
 }
 
+inline bool Affine(const mat4 &m) { return m[3][0] == 0 && m[3][1] == 0 && m[3][2] == 0 && m[3][3] == 1; }
+	// true if bottom row is 0,0,0,1 (any combination of rotate, scale, shear, translate)
+
+inline bool InvertAffine(const mat4 &m, mat4 &inv) {
+	// inverse of affine m: invert upper 3x3 by cofactors, then inverse translation is -inverse(3x3)*translation
+	// if m is not affine, use InverseMatrix4x4; return false if m singular
+	if (!Affine(m))
+		return InverseMatrix4x4(&m[0].x, &inv[0].x);
+	float c00 = m[1][1]*m[2][2]-m[1][2]*m[2][1], c01 = m[1][2]*m[2][0]-m[1][0]*m[2][2], c02 = m[1][0]*m[2][1]-m[1][1]*m[2][0];
+	double d = (double) m[0][0]*c00+(double) m[0][1]*c01+(double) m[0][2]*c02;
+	if (d == 0)
+		return false;
+	float r = (float) (1./d);
+	vec3 a0(c00*r, (m[0][2]*m[2][1]-m[0][1]*m[2][2])*r, (m[0][1]*m[1][2]-m[0][2]*m[1][1])*r);
+	vec3 a1(c01*r, (m[0][0]*m[2][2]-m[0][2]*m[2][0])*r, (m[0][2]*m[1][0]-m[0][0]*m[1][2])*r);
+	vec3 a2(c02*r, (m[0][1]*m[2][0]-m[0][0]*m[2][1])*r, (m[0][0]*m[1][1]-m[0][1]*m[1][0])*r);
+	vec3 t(m[0][3], m[1][3], m[2][3]);
+	inv = mat4(vec4(a0, -dot(a0, t)), vec4(a1, -dot(a1, t)), vec4(a2, -dot(a2, t)), vec4(0, 0, 0, 1));
+	return true;
+}
+
+constexpr mat4 InvertRigid(const mat4 &m) {
+	// inverse of m composed only of rotations and translations (eg, a view matrix from LookAt):
+	// transpose upper 3x3, translation becomes -transpose*translation
+	vec3 a0(m[0].x, m[1].x, m[2].x), a1(m[0].y, m[1].y, m[2].y), a2(m[0].z, m[1].z, m[2].z);
+	vec3 t(m[0].w, m[1].w, m[2].w);
+	return mat4(vec4(a0, -dot(a0, t)), vec4(a1, -dot(a1, t)), vec4(a2, -dot(a2, t)), vec4(0, 0, 0, 1));
+}
+
 inline mat4 Invert(mat4 m) {
+	// affine matrices (the common case: toWorld, modelview) take the shorter 3x3 path
 	mat4 inv;
-	InverseMatrix4x4(&m[0][0], &inv[0][0]);
+	if (Affine(m))
+		InvertAffine(m, inv);
+	else
+		InverseMatrix4x4(&m[0][0], &inv[0][0]);
 	return inv;
 }
 
@@ -25,7 +25,13 @@ bool Control();
 bool MouseOver(double xmouse, double ymouse, vec3 p, mat4 &view, int proximity = 12);
 
 vec3 *MouseOver(vector<vec3> &points, int xmouse, int ymouse, mat4 fullview, int proximity = 12);
-	// return pointer to point or NULL if none
+	// return pointer to first point within proximity pixels of mouse, or NULL if none
+
+class PointTree;
+
+vec3 *MouseOver(vector<vec3> &points, PointTree &tree, int xmouse, int ymouse, mat4 fullview, int proximity = 12);
+	// as above, but test only points whose tree leaf projects near the mouse
+	// tree is built if its size differs from points; after moving points[i], call tree.Update(points, i)
 
 bool MouseOver(double xmouse, double ymouse, vec2 p, int proximity = 12);
 	// is mouse(x,y) within proximity pixels of screen point p?
@@ -52,6 +58,31 @@ float MatrixScale(mat4 m);
 void Scale3x3(mat4 &m, float scale);
 	// scale matrix
 
+// PointTree: k-d tree over points, for MouseOver of large point sets (eg, control meshes)
+
+class PointTree {
+public:
+	void Build(const vector<vec3> &points);
+	void Update(const vector<vec3> &points, int i);
+		// after points[i] moves (eg, by Mover): recompute its leaf and ancestor bounds exactly (i out of range: ignored)
+		// the median partition is not redone, so leaves may overlap as points move; rebuild if many points move far
+	void Clear();
+	int Size() const { return (int) leafOf.size(); }
+	int Pick(const vector<vec3> &points, int xmouse, int ymouse, mat4 fullview, int proximity = 12) const;
+		// least i such that MouseOver(xmouse, ymouse, points[i], fullview, proximity), or -1
+		// visits only nodes whose bounds may project within proximity of the mouse
+private:
+	struct Node {
+		vec3 min, max;
+		int start = 0, end = 0;		// leaf: range in order
+		int left = -1, parent = -1;	// interior: children are left, left+1
+	};
+	vector<Node> nodes;				// nodes[0] is root
+	vector<int> order;				// point indices, in leaf order
+	vector<int> leafOf;				// per point, its leaf node
+	void Refit(const vector<vec3> &points, int node);
+};
+
 // Mover: move selected point along plane perpendicular to camera
 
 class Mover {
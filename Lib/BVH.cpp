@@ -0,0 +1,614 @@
+// BVH.cpp - binned SAH build, refit, nearest-first traversal, watertight line/triangle test
+// build: the upper levels are split one node at a time (binning large ranges in parallel) until there are
+// enough subtrees to occupy all threads; the subtrees are then built in parallel and spliced into one array
+// refit: each subtree's nodes are contiguous and follow their parents, so subtrees are refit in parallel
+// (in reverse order), then the upper nodes
+// intersection: Woop, Benthin, Wald, "Watertight Ray/Triangle Intersection," JCGT 2(1), 2013
+
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+#include "BVH.h"
+#include "Parallel.h"
+
+namespace {
+
+const int nBins = 16;			// SAH candidates per axis
+const int maxDepth = 48;		// deeper nodes become leaves (bounds traversal stack)
+const int parallelBinning = 1 << 15;	// bin ranges at least this large in parallel
+
+vec3 Min(const vec3 &a, const vec3 &b) { return vec3(a.x < b.x? a.x : b.x, a.y < b.y? a.y : b.y, a.z < b.z? a.z : b.z); }
+vec3 Max(const vec3 &a, const vec3 &b) { return vec3(a.x > b.x? a.x : b.x, a.y > b.y? a.y : b.y, a.z > b.z? a.z : b.z); }
+
+struct Box {
+	vec3 min = vec3(FLT_MAX), max = vec3(-FLT_MAX);
+	void Add(const vec3 &p) { min = Min(min, p); max = Max(max, p); }
+	void Add(const Box &b) { min = Min(min, b.min); max = Max(max, b.max); }
+	float Area() const {
+		vec3 d = max-min;
+		return d.x < 0? 0 : 2*(d.x*d.y+d.y*d.z+d.z*d.x);
+	}
+};
+
+struct Bins {
+	Box boxes[3][nBins];
+	int counts[3][nBins] = {};
+};
+
+class Builder {
+public:
+	vector<Box> boxes;			// per primitive
+	vector<vec3> centroids;
+	vector<int> order;			// primitives, partitioned in place
+	int maxLeafSize = 4, nThreads = 1;
+	struct Task { int node, start, end, depth; };
+	void Build(vector<BVHNode> &nodes, vector<int3> *subtrees = NULL, int *nUpperNodes = NULL);
+private:
+	void Bounds(int start, int end, Box &box, Box &centroidBox, bool parallel);
+	bool Split(Task t, vector<BVHNode> &nodes, Task &left, Task &right, bool parallel);
+	void BuildSubtree(Task root, vector<BVHNode> &nodes);
+};
+
+void Builder::Bounds(int start, int end, Box &box, Box &centroidBox, bool parallel) {
+	box = centroidBox = Box();
+	auto Range = [&](int s, int e, Box &b, Box &c) {
+		for (int i = s; i < e; i++) {
+			b.Add(boxes[order[i]]);
+			c.Add(centroids[order[i]]);
+		}
+	};
+	int n = end-start, nChunks = parallel? (n+parallelBinning-1)/parallelBinning : 1;
+	if (nChunks <= 1) {
+		Range(start, end, box, centroidBox);
+		return;
+	}
+	vector<Box> b(nChunks), c(nChunks);
+	ParallelFor(nChunks, [&](int k) {
+		Range(start+k*parallelBinning, std::min(end, start+(k+1)*parallelBinning), b[k], c[k]);
+	}, nThreads);
+	for (int k = 0; k < nChunks; k++) {
+		box.Add(b[k]);
+		centroidBox.Add(c[k]);
+	}
+}
+
+bool Builder::Split(Task t, vector<BVHNode> &nodes, Task &left, Task &right, bool parallel) {
+	// set node t.node bounds; if worth splitting (by SAH), partition its range, allocate children, return true
+	Box box, cbox;
+	Bounds(t.start, t.end, box, cbox, parallel);
+	BVHNode &node = nodes[t.node];
+	node.min = box.min;
+	node.max = box.max;
+	int n = t.end-t.start;
+	auto Leaf = [&]() {
+		node.offset = t.start;
+		node.count = n;
+		return false;
+	};
+	if (n <= 1 || t.depth >= maxDepth)
+		return Leaf();
+	vec3 extent = cbox.max-cbox.min;
+	int mid = -1;
+	if (extent.x <= 0 && extent.y <= 0 && extent.z <= 0) {
+		// coincident centroids: no SAH split; halve if too many for a leaf
+		if (n <= maxLeafSize)
+			return Leaf();
+		mid = t.start+n/2;
+	}
+	else {
+		// bin centroids along each axis
+		vec3 scale;
+		for (int a = 0; a < 3; a++)
+			scale[a] = extent[a] > 0? nBins*(1-FLT_EPSILON)/extent[a] : 0;
+		auto Bin = [&](const vec3 &c, int a) { return std::min(nBins-1, (int) ((c[a]-cbox.min[a])*scale[a])); };
+		auto Fill = [&](int s, int e, Bins &bins) {
+			for (int i = s; i < e; i++) {
+				int p = order[i];
+				for (int a = 0; a < 3; a++)
+					if (scale[a] > 0) {
+						int b = Bin(centroids[p], a);
+						bins.boxes[a][b].Add(boxes[p]);
+						bins.counts[a][b]++;
+					}
+			}
+		};
+		Bins bins;
+		int nChunks = parallel? (n+parallelBinning-1)/parallelBinning : 1;
+		if (nChunks <= 1)
+			Fill(t.start, t.end, bins);
+		else {
+			vector<Bins> chunks(nChunks);
+			ParallelFor(nChunks, [&](int k) {
+				Fill(t.start+k*parallelBinning, std::min(t.end, t.start+(k+1)*parallelBinning), chunks[k]);
+			}, nThreads);
+			for (int k = 0; k < nChunks; k++)
+				for (int a = 0; a < 3; a++)
+					for (int b = 0; b < nBins; b++) {
+						bins.boxes[a][b].Add(chunks[k].boxes[a][b]);
+						bins.counts[a][b] += chunks[k].counts[a][b];
+					}
+		}
+		// SAH: cost of split after bin b is 1+(area(left)*nLeft+area(right)*nRight)/area(node); of leaf, n
+		float bestCost = FLT_MAX, area = box.Area();
+		int bestAxis = -1, bestBin = 0;
+		for (int a = 0; a < 3; a++) {
+			if (scale[a] <= 0)
+				continue;
+			float rightCost[nBins];
+			Box rightBox;
+			int nRight = 0;
+			for (int b = nBins-1; b > 0; b--) {
+				rightBox.Add(bins.boxes[a][b]);
+				nRight += bins.counts[a][b];
+				rightCost[b] = rightBox.Area()*nRight;
+			}
+			Box leftBox;
+			int nLeft = 0;
+			for (int b = 0; b < nBins-1; b++) {
+				leftBox.Add(bins.boxes[a][b]);
+				nLeft += bins.counts[a][b];
+				if (nLeft == 0 || nLeft == n)
+					continue;
+				float cost = 1+(leftBox.Area()*nLeft+rightCost[b+1])/(area > 0? area : 1);
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = a;
+					bestBin = b;
+				}
+			}
+		}
+		if (bestAxis < 0 || (n <= maxLeafSize && n <= bestCost))
+			return Leaf();
+		int *o = order.data();
+		mid = (int) (std::partition(o+t.start, o+t.end, [&](int p) { return Bin(centroids[p], bestAxis) <= bestBin; })-o);
+	}
+	node.offset = (int) nodes.size();
+	node.count = 0;
+	nodes.resize(nodes.size()+2);	// invalidates node
+	left = {(int) nodes.size()-2, t.start, mid, t.depth+1};
+	right = {(int) nodes.size()-1, mid, t.end, t.depth+1};
+	return true;
+}
+
+void Builder::BuildSubtree(Task root, vector<BVHNode> &nodes) {
+	// build root's range into nodes, with root at nodes[0]
+	nodes.resize(1);
+	vector<Task> stack(1, {0, root.start, root.end, root.depth});
+	while (!stack.empty()) {
+		Task t = stack.back(), left, right;
+		stack.pop_back();
+		if (Split(t, nodes, left, right, false)) {
+			stack.push_back(right);
+			stack.push_back(left);
+		}
+	}
+}
+
+void Builder::Build(vector<BVHNode> &nodes, vector<int3> *subtreeNodes, int *nUpperNodes) {
+	int n = (int) order.size();
+	nodes.resize(1);
+	// split serially (binning in parallel) until subtrees are small enough to divide among threads
+	int subtreeSize = nThreads > 1? std::max(n/(8*nThreads), 1024) : n;
+	vector<Task> stack(1, {0, 0, n, 0}), subtrees;
+	while (!stack.empty()) {
+		Task t = stack.back(), left, right;
+		stack.pop_back();
+		if (t.end-t.start <= subtreeSize)
+			subtrees.push_back(t);
+		else if (Split(t, nodes, left, right, true)) {
+			stack.push_back(right);
+			stack.push_back(left);
+		}
+	}
+	// build subtrees in parallel, largest first
+	std::sort(subtrees.begin(), subtrees.end(), [](const Task &a, const Task &b) { return a.end-a.start > b.end-b.start; });
+	vector<vector<BVHNode>> built(subtrees.size());
+	ParallelFor((int) subtrees.size(), [&](int i) { BuildSubtree(subtrees[i], built[i]); }, nThreads);
+	// splice: subtree root replaces its placeholder, other nodes are appended (interior offsets shifted)
+	if (nUpperNodes)
+		*nUpperNodes = (int) nodes.size();
+	if (subtreeNodes)
+		subtreeNodes->resize(0);
+	for (size_t i = 0; i < subtrees.size(); i++) {
+		vector<BVHNode> &sub = built[i];
+		int shift = (int) nodes.size()-1;
+		for (size_t k = 0; k < sub.size(); k++)
+			if (!sub[k].count)
+				sub[k].offset += shift;
+		nodes[subtrees[i].node] = sub[0];
+		if (subtreeNodes)
+			subtreeNodes->push_back(int3(subtrees[i].node, (int) nodes.size(), (int) (nodes.size()+sub.size()-1)));
+		nodes.insert(nodes.end(), sub.begin()+1, sub.end());
+	}
+}
+
+// Refit and Cost
+
+template<class LeafBounds> void RefitNode(vector<BVHNode> &nodes, int i, LeafBounds leafBounds) {
+	// set bounds of node i from its children (already refit) or, if a leaf, by leafBounds(node, box)
+	BVHNode &n = nodes[i];
+	Box box;
+	if (n.count)
+		leafBounds(n, box);
+	else {
+		const BVHNode &a = nodes[n.offset], &b = nodes[n.offset+1];
+		box.min = Min(a.min, b.min);
+		box.max = Max(a.max, b.max);
+	}
+	n.min = box.min;
+	n.max = box.max;
+}
+
+float Area(const BVHNode &n) {
+	Box b;
+	b.min = n.min;
+	b.max = n.max;
+	return b.Area();
+}
+
+float TreeCost(const vector<BVHNode> &nodes) {
+	// sum of node areas weighted by traversal (1) and primitive tests (count), relative to root area
+	if (nodes.empty())
+		return 0;
+	double sum = 0;
+	for (size_t i = 0; i < nodes.size(); i++)
+		sum += (double) Area(nodes[i])*(nodes[i].count? nodes[i].count : 1);
+	float root = Area(nodes[0]);
+	return root > 0? (float) (sum/root) : 0;
+}
+
+// Intersection
+
+struct Line {
+	// p1+alpha*(p2-p1), sheared and scaled for the watertight test
+	vec3 org, dir, inv;
+	int kx = 0, ky = 1, kz = 2;
+	float sx = 0, sy = 0, sz = 1;
+	Line(vec3 p1, vec3 p2) : org(p1), dir(p2-p1) {
+		for (int k = 0; k < 3; k++)
+			inv[k] = fabs(dir[k]) > 1e-30f? 1/dir[k] : 1e30f;
+		vec3 a(fabs(dir.x), fabs(dir.y), fabs(dir.z));
+		kz = a.x > a.y? (a.x > a.z? 0 : 2) : (a.y > a.z? 1 : 2);
+		kx = (kz+1)%3;
+		ky = (kx+1)%3;
+		if (dir[kz] < 0)
+			std::swap(kx, ky);
+		sx = dir[kx]/dir[kz];
+		sy = dir[ky]/dir[kz];
+		sz = 1/dir[kz];
+	}
+};
+
+bool HitBox(const Line &l, const BVHNode &n, float best, float &near) {
+	// true if line enters n's box at alpha not greater than best; bounds are widened to cover rounding
+	float far = FLT_MAX;
+	near = -FLT_MAX;
+	for (int k = 0; k < 3; k++) {
+		float t0 = (n.min[k]-l.org[k])*l.inv[k], t1 = (n.max[k]-l.org[k])*l.inv[k];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		near = t0 > near? t0 : near;
+		far = t1 < far? t1 : far;
+	}
+	near -= fabs(near)*1e-6f;
+	far += fabs(far)*1e-6f;
+	return near <= far && near <= best;
+}
+
+bool HitTriangle(const Line &l, const vec3 *v, float &alpha) {
+	vec3 a = v[0]-l.org, b = v[1]-l.org, c = v[2]-l.org;
+	float ax = a[l.kx]-l.sx*a[l.kz], ay = a[l.ky]-l.sy*a[l.kz];
+	float bx = b[l.kx]-l.sx*b[l.kz], by = b[l.ky]-l.sy*b[l.kz];
+	float cx = c[l.kx]-l.sx*c[l.kz], cy = c[l.ky]-l.sy*c[l.kz];
+	float u = cx*by-cy*bx, w = bx*ay-by*ax, v2 = ax*cy-ay*cx;
+	if (u == 0 || v2 == 0 || w == 0) {
+		// on an edge in float: decide in double, so neighbors agree
+		u = (float) ((double) cx*by-(double) cy*bx);
+		v2 = (float) ((double) ax*cy-(double) ay*cx);
+		w = (float) ((double) bx*ay-(double) by*ax);
+	}
+	if ((u < 0 || v2 < 0 || w < 0) && (u > 0 || v2 > 0 || w > 0))
+		return false;
+	float det = u+v2+w;
+	if (det == 0)
+		return false;
+	float az = l.sz*a[l.kz], bz = l.sz*b[l.kz], cz = l.sz*c[l.kz];
+	alpha = (u*az+v2*bz+w*cz)/det;
+	return true;
+}
+
+} // end namespace
+
+void BVH::Clear() {
+	nodes.resize(0);
+	ids.resize(0);
+	indices.resize(0);
+	vertices.resize(0);
+	subtrees.resize(0);
+	nTriangles = nQuads = nUpperNodes = 0;
+	builtCost = 0;
+}
+
+void BVH::Build(const vector<vec3> &points, const vector<int3> &triangles, const vector<int4> *quads, int maxLeafSize, int nThreads) {
+	// primitives: triangles, then two per quad
+	int nt = (int) triangles.size(), nq = quads? (int) quads->size() : 0, n = nt+2*nq;
+	vector<int3> prims(n);
+	vector<int> primIds(n);
+	for (int i = 0; i < nt; i++) {
+		prims[i] = triangles[i];
+		primIds[i] = i;
+	}
+	for (int q = 0; q < nq; q++) {
+		int4 f = (*quads)[q];
+		prims[nt+2*q] = int3(f.i1, f.i2, f.i3);
+		prims[nt+2*q+1] = int3(f.i1, f.i3, f.i4);
+		primIds[nt+2*q] = primIds[nt+2*q+1] = nt+q;
+	}
+	Build(points, prims, primIds, maxLeafSize, nThreads);
+	nTriangles = nt;
+	nQuads = nq;
+}
+
+void BVH::Build(const vector<vec3> &points, vector<int3> &prims, vector<int> &primIds, int leafSize, int nThreads) {
+	Clear();
+	maxLeafSize = leafSize > 0? leafSize : 1;
+	int n = (int) prims.size();
+	if (!n)
+		return;
+	Builder b;
+	b.maxLeafSize = maxLeafSize;
+	b.nThreads = NumThreads(nThreads);
+	b.boxes.resize(n);
+	b.centroids.resize(n);
+	b.order.resize(n);
+	const int block = 4096;
+	ParallelFor((n+block-1)/block, [&](int k) {
+		for (int i = k*block, e = std::min(n, i+block); i < e; i++) {
+			Box &box = b.boxes[i];
+			for (int j = 0; j < 3; j++)
+				box.Add(points[prims[i][j]]);
+			b.centroids[i] = .5f*(box.min+box.max);
+			b.order[i] = i;
+		}
+	}, b.nThreads);
+	b.Build(nodes, &subtrees, &nUpperNodes);
+	// store primitives in leaf order
+	ids.resize(n);
+	indices.resize(n);
+	vertices.resize(3*n);
+	ParallelFor((n+block-1)/block, [&](int k) {
+		for (int i = k*block, e = std::min(n, i+block); i < e; i++) {
+			int p = b.order[i];
+			ids[i] = primIds[p];
+			indices[i] = prims[p];
+			for (int j = 0; j < 3; j++)
+				vertices[3*i+j] = points[prims[p][j]];
+		}
+	}, b.nThreads);
+	builtCost = TreeCost(nodes);
+}
+
+bool BVH::Refit(const vector<vec3> &points, float rebuildRatio, int nThreads) {
+	if (nodes.empty())
+		return false;
+	int n = (int) indices.size();
+	nThreads = NumThreads(nThreads);
+	const int block = 4096;
+	ParallelFor((n+block-1)/block, [&](int k) {
+		for (int i = k*block, e = std::min(n, i+block); i < e; i++)
+			for (int j = 0; j < 3; j++)
+				vertices[3*i+j] = points[indices[i][j]];
+	}, nThreads);
+	auto LeafBounds = [&](const BVHNode &node, Box &box) {
+		for (int i = 3*node.offset; i < 3*(node.offset+node.count); i++)
+			box.Add(vertices[i]);
+	};
+	ParallelFor((int) subtrees.size(), [&](int i) {
+		int3 t = subtrees[i];
+		for (int k = t.i3-1; k >= t.i2; k--)
+			RefitNode(nodes, k, LeafBounds);
+	}, nThreads);
+	// subtree roots are among the upper nodes
+	for (int k = nUpperNodes-1; k >= 0; k--)
+		RefitNode(nodes, k, LeafBounds);
+	if (rebuildRatio > 0 && Cost() > rebuildRatio*builtCost) {
+		vector<int3> prims(indices);
+		vector<int> primIds(ids);
+		int nt = nTriangles, nq = nQuads;
+		Build(points, prims, primIds, maxLeafSize, nThreads);
+		nTriangles = nt;
+		nQuads = nq;
+		return true;
+	}
+	return false;
+}
+
+float BVH::Cost() const { return TreeCost(nodes); }
+
+int BVH::IntersectWithLine(vec3 p1, vec3 p2, float &alpha) const {
+	alpha = FLT_MAX;
+	return IntersectWithLine(p1, p2, alpha, FLT_MAX);
+}
+
+int BVH::IntersectWithLine(vec3 p1, vec3 p2, float &retAlpha, float maxAlpha) const {
+	int picked = -1;
+	float alpha = maxAlpha;
+	if (nodes.empty())
+		return -1;
+	Line l(p1, p2);
+	struct Entry { int node; float near; } stack[maxDepth+2];
+	int nStack = 0;
+	float near;
+	if (HitBox(l, nodes[0], alpha, near))
+		stack[nStack++] = {0, near};
+	while (nStack) {
+		Entry e = stack[--nStack];
+		if (e.near > alpha)
+			continue;
+		const BVHNode &n = nodes[e.node];
+		if (n.count) {
+			for (int i = n.offset; i < n.offset+n.count; i++) {
+				float a;
+				// a hit at exactly maxAlpha is accepted; among equal hits, the least id
+				if (HitTriangle(l, &vertices[3*i], a) && (a < alpha || (a == alpha && (picked < 0 || ids[i] < picked)))) {
+					alpha = a;
+					picked = ids[i];
+				}
+			}
+			continue;
+		}
+		// push farther child first, so nearer is visited next
+		float n0, n1;
+		bool h0 = HitBox(l, nodes[n.offset], alpha, n0), h1 = HitBox(l, nodes[n.offset+1], alpha, n1);
+		if (h0 && h1) {
+			bool firstNearer = n0 <= n1;
+			stack[nStack++] = firstNearer? Entry{n.offset+1, n1} : Entry{n.offset, n0};
+			stack[nStack++] = firstNearer? Entry{n.offset, n0} : Entry{n.offset+1, n1};
+		}
+		else if (h0)
+			stack[nStack++] = {n.offset, n0};
+		else if (h1)
+			stack[nStack++] = {n.offset+1, n1};
+	}
+	if (picked >= 0)
+		retAlpha = alpha;
+	return picked;
+}
+
+void BVH::IntersectWithLines(const vector<vec3> &p1, const vector<vec3> &p2, vector<int> &hits, vector<float> &alphas, int nThreads) const {
+	int n = (int) std::min(p1.size(), p2.size());
+	const int block = 64;
+	hits.resize(n);
+	alphas.resize(n);
+	ParallelFor((n+block-1)/block, [&](int k) {
+		for (int i = k*block, e = std::min(n, i+block); i < e; i++)
+			hits[i] = IntersectWithLine(p1[i], p2[i], alphas[i]);
+	}, nThreads);
+}
+
+// Two Levels
+
+int TopBVH::Add(const BVH *bvh, const mat4 &toWorld) {
+	instances.resize(instances.size()+1);
+	instances.back().bvh = bvh;
+	SetTransform((int) instances.size()-1, toWorld);
+	return (int) instances.size()-1;
+}
+
+static void SetBounds(TopBVH::Instance &inst) {
+	// world bounds are the transformed corners of the instance's root box (empty if toWorld singular)
+	Box box;
+	if (inst.bvh && !inst.bvh->Empty() && inst.toObject[3].w != 0) {
+		const BVHNode &root = inst.bvh->nodes[0];
+		for (int k = 0; k < 8; k++) {
+			vec3 corner(k&1? root.max.x : root.min.x, k&2? root.max.y : root.min.y, k&4? root.max.z : root.min.z);
+			box.Add(Vec3(inst.toWorld*vec4(corner, 1)));
+		}
+	}
+	inst.min = box.min;
+	inst.max = box.max;
+}
+
+void TopBVH::SetTransform(int i, const mat4 &toWorld) {
+	Instance &inst = instances[i];
+	inst.toWorld = toWorld;
+	if (!InvertAffine(toWorld, inst.toObject))
+		inst.toObject = mat4(0);
+	SetBounds(inst);
+}
+
+void TopBVH::Clear() {
+	instances.resize(0);
+	nodes.resize(0);
+	leaves.resize(0);
+	builtCost = 0;
+}
+
+void TopBVH::Build(int nThreads) {
+	nodes.resize(0);
+	leaves.resize(0);
+	int n = (int) instances.size();
+	if (!n)
+		return;
+	Builder b;
+	b.maxLeafSize = 1;
+	b.nThreads = NumThreads(nThreads);
+	b.boxes.resize(n);
+	b.centroids.resize(n);
+	b.order.resize(n);
+	for (int i = 0; i < n; i++) {
+		b.boxes[i].min = instances[i].min;
+		b.boxes[i].max = instances[i].max;
+		b.centroids[i] = .5f*(instances[i].min+instances[i].max);
+		b.order[i] = i;
+	}
+	b.Build(nodes);
+	leaves = b.order;
+	builtCost = TreeCost(nodes);
+}
+
+bool TopBVH::Refit(float rebuildRatio) {
+	for (Instance &inst : instances)
+		SetBounds(inst);
+	// children follow parents, so reverse order is bottom-up
+	auto LeafBounds = [&](const BVHNode &node, Box &box) {
+		for (int i = node.offset; i < node.offset+node.count; i++) {
+			box.min = Min(box.min, instances[leaves[i]].min);
+			box.max = Max(box.max, instances[leaves[i]].max);
+		}
+	};
+	for (int k = (int) nodes.size()-1; k >= 0; k--)
+		RefitNode(nodes, k, LeafBounds);
+	if (rebuildRatio > 0 && TreeCost(nodes) > rebuildRatio*builtCost) {
+		Build();
+		return true;
+	}
+	return false;
+}
+
+int TopBVH::IntersectWithLine(vec3 p1, vec3 p2, float &alpha, int &id) const {
+	// alpha is unchanged by (affine) transformation of the line to an instance's object space
+	int picked = -1;
+	alpha = FLT_MAX;
+	id = -1;
+	if (nodes.empty())
+		return -1;
+	Line l(p1, p2);
+	struct Entry { int node; float near; } stack[maxDepth+2];
+	int nStack = 0;
+	float near;
+	if (HitBox(l, nodes[0], alpha, near))
+		stack[nStack++] = {0, near};
+	while (nStack) {
+		Entry e = stack[--nStack];
+		if (e.near > alpha)
+			continue;
+		const BVHNode &n = nodes[e.node];
+		if (n.count) {
+			for (int i = n.offset; i < n.offset+n.count; i++) {
+				const Instance &inst = instances[leaves[i]];
+				if (!inst.bvh)
+					continue;
+				vec3 o1 = Vec3(inst.toObject*vec4(p1, 1)), o2 = Vec3(inst.toObject*vec4(p2, 1));
+				int hit = inst.bvh->IntersectWithLine(o1, o2, alpha, alpha);
+				if (hit >= 0) {
+					picked = leaves[i];
+					id = hit;
+				}
+			}
+			continue;
+		}
+		float n0, n1;
+		bool h0 = HitBox(l, nodes[n.offset], alpha, n0), h1 = HitBox(l, nodes[n.offset+1], alpha, n1);
+		if (h0 && h1) {
+			bool firstNearer = n0 <= n1;
+			stack[nStack++] = firstNearer? Entry{n.offset+1, n1} : Entry{n.offset, n0};
+			stack[nStack++] = firstNearer? Entry{n.offset, n0} : Entry{n.offset+1, n1};
+		}
+		else if (h0)
+			stack[nStack++] = {n.offset, n0};
+		else if (h1)
+			stack[nStack++] = {n.offset+1, n1};
+	}
+	return picked;
+}
@@ -109,24 +109,25 @@ float ScreenD(int x, int y, vec3 p, mat4 m, float *zscreen) {
 }
 
 void ScreenRay(float xscreen, float yscreen, mat4 modelview, mat4 persp, vec3 &p, vec3 &v) {
-	// compute ray from p in direction v; p is transformed eyepoint, xscreen, yscreen determine v
+	// compute ray from p in direction v; p is the eyepoint in world space, xscreen, yscreen determine v
 	int vp[4];
 	glGetIntegerv(GL_VIEWPORT, vp);
-	// origin of ray is always eye (translated origin)
-	p = vec3(modelview[0][3], modelview[1][3], modelview[2][3]);
-	// create transposes for gluUnproject
-	double tpersp[4][4], tmodelview[4][4], a[3], b[3];
-	for (int i = 0; i < 4; i++)
-		for (int j = 0; j < 4; j++) {
-			tmodelview[i][j] = modelview[j][i];
-			tpersp[i][j] = persp[j][i];
-		}
-	// un-project two screen points of differing depth to determine v
-	if (gluUnProject(xscreen, yscreen, .25, (const double*) tmodelview, (const double*) tpersp, vp, &a[0], &a[1], &a[2]) == GL_FALSE)
-		printf("UnProject false\n");
-	if (gluUnProject(xscreen, yscreen, .50, (const double*) tmodelview, (const double*) tpersp, vp, &b[0], &b[1], &b[2]) == GL_FALSE)
+	// modelview is affine, so invert it by its 3x3; origin of ray is eye (camera space origin)
+	mat4 inv;
+	InvertAffine(modelview, inv);
+	p = vec3(inv[0][3], inv[1][3], inv[2][3]);
+	// un-project two screen points of differing depth (window .25, .5) to camera space to determine v
+	mat4 invPersp = Invert(persp);
+	float x = 2.f*(xscreen-vp[0])/vp[2]-1.f, y = 2.f*(yscreen-vp[1])/vp[3]-1.f;
+	vec4 a = invPersp*vec4(x, y, -.5f, 1), b = invPersp*vec4(x, y, 0, 1);
+	if (a.w == 0 || b.w == 0) {
+		// degenerate projection: ray along the camera's view direction
 		printf("UnProject false\n");
-	v = normalize(vec3((float) (b[0]-a[0]), (float) (b[1]-a[1]), (float) (b[2]-a[2])));
+		v = normalize(Vec3(inv*vec4(0, 0, -1, 0)));
+		return;
+	}
+	vec3 d = Vec3(b)/b.w-Vec3(a)/a.w;
+	v = normalize(Vec3(inv*vec4(d, 0)));
 }
 
 void ScreenLine(float xscreen, float yscreen, mat4 modelview, mat4 persp, vec3 &p1, vec3 &p2) {
@@ -166,6 +167,11 @@ bool FrontFacing(vec3 base, vec3 vec, mat4 view) {
 int drawShader = 0;
 mat4 drawView;
 
+// set per primitive: skip uploads of unchanged values
+Uniform<mat4> drawViewUniform("view");
+Uniform<float> drawOpacity("opacity");
+Uniform<bool> drawFadeToCenter("fadeToCenter"), drawRing("ring"), drawUseTexture("useTexture");
+
 const char *drawVShader = R"(
 	#version 410 core // 130
 	in vec3 position;
@@ -228,13 +234,13 @@ int UseDrawShader() {
 	bool init = !drawShader;
 	if (init) drawShader = LinkProgramViaCode(&drawVShader, &drawPShader);
 	glUseProgram(drawShader);
-	if (init) SetUniform(drawShader, "view", mat4());
+	if (init) drawViewUniform.Set(drawShader, mat4());
 	return was;
 }
 
 int UseDrawShader(mat4 viewMatrix) {
 	int was = UseDrawShader();
-	SetUniform(drawShader, "view", viewMatrix);
+	drawViewUniform.Set(drawShader, viewMatrix);
 	drawView = viewMatrix;
 	return was;
 }
@@ -269,8 +275,8 @@ void Disk(vec3 p, float diameter, vec3 color, float opacity, bool ring) {
 	// draw
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	SetUniform(drawShader, "opacity", opacity);
-	SetUniform(drawShader, "ring", ring);
+	drawOpacity.Set(drawShader, opacity);
+	drawRing.Set(drawShader, ring);
 	glPointSize(diameter);
 #ifdef GL_POINT_SMOOTH
 	glEnable(GL_POINT_SMOOTH);
@@ -280,7 +286,7 @@ void Disk(vec3 p, float diameter, vec3 color, float opacity, bool ring) {
 #endif
 #if !defined(GL_POINT_SMOOTH) && !defined(GL_POINT_SPRITE)
 	glEnable(0x8861); // same as GL_POINT_SMOOTH [this is a 4.5 core bug]
-	SetUniform(drawShader, "fadeToCenter", true); // needed if GL_POINT_SMOOTH and GL_POINT_SPRITE fail
+	drawFadeToCenter.Set(drawShader, true); // needed if GL_POINT_SMOOTH and GL_POINT_SPRITE fail
 #endif
 	glDrawArrays(GL_POINTS, 0, 1);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -308,8 +314,8 @@ void Line(vec3 p1, vec3 p2, float width, vec3 col1, vec3 col2, float opacity) {
 	// connect shader inputs, set uniforms
 	VertexAttribPointer(drawShader, "position", 3, 0, (void *) 0);
 	VertexAttribPointer(drawShader, "color", 3, 0, (void *) (2*sizeof(vec3)));
-	SetUniform(drawShader, "fadeToCenter", false);  // gl_PointCoord fails for lines (instead, use GL_LINE_SMOOTH)
-	SetUniform(drawShader, "opacity", opacity);
+	drawFadeToCenter.Set(drawShader, false);  // gl_PointCoord fails for lines (instead, use GL_LINE_SMOOTH)
+	drawOpacity.Set(drawShader, opacity);
 	// draw
 	glLineWidth(width);
 	glDrawArrays(GL_LINES, 0, 2);
@@ -374,8 +380,8 @@ void LineStrip(int nPoints, vec3 *points, vec3 &color, float opacity, float widt
 	glBufferSubData(GL_ARRAY_BUFFER, pSize, pSize, colors.data());
 	VertexAttribPointer(drawShader, "position", 3, 0, (void *) 0);
 	VertexAttribPointer(drawShader, "color", 3, 0, (void *) pSize);
-	SetUniform(drawShader, "fadeToCenter", false);
-	SetUniform(drawShader, "opacity", opacity);
+	drawFadeToCenter.Set(drawShader, false);
+	drawOpacity.Set(drawShader, opacity);
 	glLineWidth(width);
 	glDrawArrays(GL_LINE_STRIP, 0, nPoints);
 }
@@ -404,9 +410,9 @@ void Quad(vec3 p1, vec3 p2, vec3 p3, vec3 p4, bool solid, vec3 col, float opacit
 	glBufferData(GL_ARRAY_BUFFER, sizeof(data), data, GL_STATIC_DRAW);
 	VertexAttribPointer(drawShader, "position", 3, 0, (void *) 0);
 	VertexAttribPointer(drawShader, "color", 3, 0, (void *) (4*sizeof(vec3)));
-	SetUniform(drawShader, "opacity", opacity);
-	SetUniform(drawShader, "fadeToCenter", false);
-	SetUniform(drawShader, "useTexture", textureUnit >= 0);
+	drawOpacity.Set(drawShader, opacity);
+	drawFadeToCenter.Set(drawShader, false);
+	drawUseTexture.Set(drawShader, textureUnit >= 0);
 	if (textureUnit >= 0) {
 		glActiveTexture(GL_TEXTURE0+textureUnit);
 		glBindTexture(GL_TEXTURE_2D, textureName);
@@ -414,7 +420,7 @@ void Quad(vec3 p1, vec3 p2, vec3 p3, vec3 p4, bool solid, vec3 col, float opacit
 	}
 	glLineWidth(lineWidth);
 	glDrawArrays(solid? GL_QUADS : GL_LINE_LOOP, 0, 4);
-	SetUniform(drawShader, "useTexture", false);
+	drawUseTexture.Set(drawShader, false);
 #endif
 }
 
@@ -581,6 +587,10 @@ void Cylinder(vec3 p1, vec3 p2, float r1, float r2, mat4 modelview, mat4 persp,
 // Triangles with optional outline
 
 GLuint triShader = 0, triVBO = 0, triVAO = 0;
+Uniform<mat4> triView("view"), triViewport("viewptM");
+Uniform<float> triOpacity("opacity"), triOutlineWidth("outlineWidth"), triTransition("transition");
+Uniform<int> triOutlineOn("outlineOn");
+Uniform<vec4> triOutlineColor("outlineColor");
 
 // vertex shader
 const char *triVShaderCode = R"(
@@ -658,7 +668,7 @@ const char *triPShaderCode = R"(
 		triShader = LinkProgramViaCode(&triVShaderCode, NULL, NULL, &triGShaderCode, &triPShaderCode);
 	glUseProgram(triShader);
 	if (init)
-		SetUniform(triShader, "view", mat4());
+		triView.Set(triShader, mat4());
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glEnable(GL_LINE_SMOOTH);
@@ -666,7 +676,7 @@ const char *triPShaderCode = R"(
 
 void UseTriangleShader(mat4 view) {
 	UseTriangleShader();
-	SetUniform(triShader, "view", view);
+	triView.Set(triShader, view);
 }
 
 void Triangle(vec3 p1, vec3 p2, vec3 p3, vec3 c1, vec3 c2, vec3 c3,
@@ -686,12 +696,12 @@ void Triangle(vec3 p1, vec3 p2, vec3 p3, vec3 c1, vec3 c2, vec3 c3,
 	glBufferData(GL_ARRAY_BUFFER, sizeof(data), data, GL_STATIC_DRAW);
 	VertexAttribPointer(triShader, "point", 3, 0, (void *) 0);
 	VertexAttribPointer(triShader, "color", 3, 0, (void *) (3*sizeof(vec3)));
-	SetUniform(triShader, "viewptM", Viewport()); // **** ????
-	SetUniform(triShader, "opacity", opacity);
-	SetUniform(triShader, "outlineOn", outline? 1 : 0);
-	SetUniform(triShader, "outlineColor", outlineCol);
-	SetUniform(triShader, "outlineWidth", outlineWidth);
-	SetUniform(triShader, "transition", transition);
+	triViewport.Set(triShader, Viewport()); // **** ????
+	triOpacity.Set(triShader, opacity);
+	triOutlineOn.Set(triShader, outline? 1 : 0);
+	triOutlineColor.Set(triShader, outlineCol);
+	triOutlineWidth.Set(triShader, outlineWidth);
+	triTransition.Set(triShader, transition);
 	glDrawArrays(GL_TRIANGLES, 0, 3);
 }
 
@@ -6,6 +6,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace {
@@ -274,6 +276,7 @@ void LinkProgramViaCode(GLuint computeProgram, const char **computeCode) {
 	GLuint computeShader = CompileShaderViaCode(computeCode, GL_COMPUTE_SHADER);
 	glAttachShader(computeProgram, computeShader);
 	glLinkProgram(computeProgram);
+	ClearUniformCache(computeProgram);
 	glDetachShader(computeProgram, computeShader);
 	glDeleteShader(computeShader);
 	GLint status;
@@ -294,6 +297,7 @@ GLuint LinkProgramViaFile(const char *computeShaderFile) {
 	GLuint program = glCreateProgram();
 	glAttachShader(program, cshader);
 	glLinkProgram(program);
+	ClearUniformCache(program);
 	GLint status;
 	glGetProgramiv(program, GL_LINK_STATUS, &status);
 	if (status == GL_FALSE) PrintProgramLog(program);
@@ -318,6 +322,7 @@ GLuint LinkProgram(GLuint vshader, GLuint tcshader, GLuint teshader, GLuint gsha
 		glAttachShader(program, pshader);
 		// link and verify
 		glLinkProgram(program);
+		ClearUniformCache(program);
 		GLint status;
 		glGetProgramiv(program, GL_LINK_STATUS, &status);
 		if (status == GL_FALSE) PrintProgramLog(program);
@@ -347,6 +352,7 @@ void DeleteProgram(int program) {
 	for (int i = 0; i < nShaders; i++)
 		glDeleteShader(shaderNames[i]);
 	glDeleteProgram(program);
+	ClearUniformCache(program);
 }
 
 // Binary Read/Write **** NOT SUPPORTED BY OPENGL3.x
@@ -379,6 +385,7 @@ bool ReadProgramBinary(GLuint program, const char *filename) {
 		fread((char *) &data[0], 1, sizeBinary, in);
 		fclose(in);
 		glProgramBinary(program, binaryFormat, &data[0], sizeBinary);
+		ClearUniformCache(program);
 		return true;
 	}
 	return false;
@@ -393,6 +400,64 @@ GLuint ReadProgramBinary(const char *filename) {
 	return program;
 }
 
+// Uniform Cache
+
+namespace {
+
+typedef std::unordered_map<std::string, UniformSlot> ProgramUniforms;
+
+std::unordered_map<int, ProgramUniforms> uniformCache;
+ProgramUniforms *lastUniforms = NULL;	// of lastProgram, to skip the outer lookup for consecutive sets
+int lastProgram = -1;
+unsigned uniformGeneration = 1;
+
+template<class T> void Record(UniformSlot *u, const T &v) {
+	memcpy(u->value, &v, sizeof(T));
+	u->size = (int) sizeof(T);
+}
+
+} // end namespace
+
+UniformSlot *FindUniform(int program, const char *name) {
+	if (program != lastProgram || !lastUniforms) {
+		lastUniforms = &uniformCache[program];
+		lastProgram = program;
+	}
+	auto it = lastUniforms->find(name);
+	if (it != lastUniforms->end())
+		return &it->second;
+	UniformSlot &u = (*lastUniforms)[name];	// element addresses survive rehashing
+	u.location = glGetUniformLocation(program, name);
+	return &u;
+}
+
+GLint UniformLocation(int program, const char *name) {
+	return FindUniform(program, name)->location;
+}
+
+void ClearUniformCache(int program) {
+	if (program)
+		uniformCache.erase(program);
+	else
+		uniformCache.clear();
+	lastUniforms = NULL;
+	lastProgram = -1;
+	uniformGeneration++;
+}
+
+unsigned UniformCacheGeneration() {
+	return uniformGeneration;
+}
+
+void UploadUniform(GLint id, bool v) { glUniform1ui(id, v? 1 : 0); }
+void UploadUniform(GLint id, int v) { glUniform1i(id, v); }
+void UploadUniform(GLint id, GLuint v) { glUniform1ui(id, v); }
+void UploadUniform(GLint id, float v) { glUniform1f(id, v); }
+void UploadUniform(GLint id, vec2 v) { glUniform2f(id, v.x, v.y); }
+void UploadUniform(GLint id, vec3 v) { glUniform3f(id, v.x, v.y, v.z); }
+void UploadUniform(GLint id, vec4 v) { glUniform4f(id, v.x, v.y, v.z, v.w); }
+void UploadUniform(GLint id, const mat4 &m) { glUniformMatrix4fv(id, 1, true, (float *) &m[0].x); }
+
 // Uniform Access
 
 bool squawk = false;
@@ -407,133 +472,92 @@ bool Bad(const char *name) {
 	return false;
 }
 
-bool SetUniform(int program, const char *name, bool val) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
-		return Bad(name);
-	glUniform1ui(id, val? 1 : 0);
-	return true;
-}
+namespace {
 
-bool SetUniform(int program, const char *name, int val) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
+template<class T> bool Set(int program, const char *name, const T &v) {
+	// upload always (a uniform may have been set by glUniform*), record value for Uniform<T>
+	UniformSlot *u = FindUniform(program, name);
+	if (u->location < 0)
 		return Bad(name);
-	glUniform1i(id, val);
+	UploadUniform(u->location, v);
+	Record(u, v);
 	return true;
 }
 
+} // end namespace
+
+bool SetUniform(int program, const char *name, bool val) { return Set(program, name, val); }
+
+bool SetUniform(int program, const char *name, int val) { return Set(program, name, val); }
+
 // following might confuse some compilers
-bool SetUniform(int program, const char *name, GLuint val) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
-		return Bad(name);
-	glUniform1ui(id, val);
-	return true;
-}
+bool SetUniform(int program, const char *name, GLuint val) { return Set(program, name, val); }
 
-bool SetUniformv(int program, const char *name, int count, int *v) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
-		return Bad(name);
-	glUniform1iv(id, count, v);
-	return true;
-}
+bool SetUniform(int program, const char *name, float val) { return Set(program, name, val); }
 
-bool SetUniform(int program, const char *name, float val) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
-		return Bad(name);
-	glUniform1f(id, val);
-	return true;
-}
+bool SetUniform(int program, const char *name, vec2 v) { return Set(program, name, v); }
 
-bool SetUniformv(int program, const char *name, int count, float *v) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
-		return Bad(name);
-	glUniform1fv(id, count, v);
-	return true;
-}
+bool SetUniform(int program, const char *name, vec3 v) { return Set(program, name, v); }
 
-bool SetUniform(int program, const char *name, vec2 v) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
-		return Bad(name);
-	glUniform2f(id, v.x, v.y);
-	return true;
-}
+bool SetUniform(int program, const char *name, vec4 v) { return Set(program, name, v); }
 
-bool SetUniform(int program, const char *name, vec3 v) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
-		return Bad(name);
-	glUniform3f(id, v.x, v.y, v.z);
-	return true;
-}
+bool SetUniform(int program, const char *name, vec3 *v) { return Set(program, name, *v); }
 
-bool SetUniform(int program, const char *name, vec4 v) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
-		return Bad(name);
-	glUniform4f(id, v.x, v.y, v.z, v.w);
-	return true;
-}
+bool SetUniform(int program, const char *name, vec4 *v) { return Set(program, name, *v); }
 
-bool SetUniform(int program, const char *name, vec3 *v) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
-		return Bad(name);
-	glUniform3fv(id, 1, (float *) v);
-	return true;
+bool SetUniform3(int program, const char *name, float *v) { return Set(program, name, vec3(v[0], v[1], v[2])); }
+
+bool SetUniform(int program, const char *name, mat4 m) { return Set(program, name, m); }
+
+// arrays: values not recorded
+
+namespace {
+
+UniformSlot *ArraySlot(int program, const char *name) {
+	UniformSlot *u = FindUniform(program, name);
+	if (u->location < 0) {
+		Bad(name);
+		return NULL;
+	}
+	u->size = 0;
+	return u;
 }
 
-bool SetUniform(int program, const char *name, vec4 *v) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
-		return Bad(name);
-	glUniform4fv(id, 1, (float *) v);
-	return true;
+} // end namespace
+
+bool SetUniformv(int program, const char *name, int count, int *v) {
+	UniformSlot *u = ArraySlot(program, name);
+	if (u)
+		glUniform1iv(u->location, count, v);
+	return u != NULL;
 }
 
-bool SetUniform3(int program, const char *name, float *v) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
-		return Bad(name);
-	glUniform3fv(id, 1, v);
-	return true;
+bool SetUniformv(int program, const char *name, int count, float *v) {
+	UniformSlot *u = ArraySlot(program, name);
+	if (u)
+		glUniform1fv(u->location, count, v);
+	return u != NULL;
 }
 
 bool SetUniform2v(int program, const char *name, int count, float *v) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
-		return Bad(name);
-	glUniform2fv(id, count, v);
-	return true;
+	UniformSlot *u = ArraySlot(program, name);
+	if (u)
+		glUniform2fv(u->location, count, v);
+	return u != NULL;
 }
 
 bool SetUniform3v(int program, const char *name, int count, float *v) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
-		return Bad(name);
-	glUniform3fv(id, count, v);
-	return true;
+	UniformSlot *u = ArraySlot(program, name);
+	if (u)
+		glUniform3fv(u->location, count, v);
+	return u != NULL;
 }
 
 bool SetUniform4v(int program, const char *name, int count, float *v) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
-		return Bad(name);
-	glUniform4fv(id, count, v);
-	return true;
-}
-
-bool SetUniform(int program, const char *name, mat4 m) {
-	GLint id = glGetUniformLocation(program, name);
-	if (id < 0)
-		return Bad(name);
-	glUniformMatrix4fv(id, 1, true, (float *) &m[0][0]);
-	return true;
+	UniformSlot *u = ArraySlot(program, name);
+	if (u)
+		glUniform4fv(u->location, count, v);
+	return u != NULL;
 }
 
 // Attribute Access
@@ -1,14 +1,29 @@
 // IO.cpp (c) 2019-2022 Jules Bloomenthal
 
 #include "Draw.h"
+#include "Int3Map.h"
 #include "IO.h"
-#include <fstream>
+#include "Kernels.h"
+#include "Misc.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <map>
+#include <queue>
 #include <string.h>
+#include <type_traits>
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
 
 using std::string;
 using std::vector;
-using std::ios;
-using std::ifstream;
 
 // Texture
 
@@ -73,6 +88,30 @@ GLuint ReadTexture(const char *filename, bool mipmap, int *n, int *w, int *h) {
 	return textureName;
 }
 
+GLuint ReadTextureOnce(const char *filename, bool mipmap) {
+	static std::map<string, GLuint> textures;
+	std::map<string, GLuint>::iterator it = textures.find(filename);
+	if (it != textures.end())
+		return it->second;
+	GLuint textureName = ReadTexture(filename, mipmap);
+	if (textureName)
+		textures[filename] = textureName;
+	return textureName;
+}
+
+GLuint DecodeTexture(const unsigned char *encoded, size_t nBytes, bool flipVertically, bool mipmap) {
+	int width, height, nChannels;
+	stbi_set_flip_vertically_on_load(flipVertically);
+	unsigned char *data = stbi_load_from_memory(encoded, (int) nBytes, &width, &height, &nChannels, 0);
+	if (!data) {
+		printf("DecodeTexture: can't decode image (%s)\n", stbi_failure_reason());
+		return 0;
+	}
+	GLuint textureName = LoadTexture(data, width, height, nChannels, false, mipmap);
+	stbi_image_free(data);
+	return textureName;
+}
+
 unsigned char *GetData(int &width, int &height) {
 	ViewportSize(width, height);
 	int npixels = width*height;
@@ -109,28 +148,171 @@ void SaveTga(const char *filename) {
 	delete [] cPixels;
 }
 
+// Memory-mapped file
+
+bool MappedFile::Open(const char *filename) {
+	Close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		return false;
+	}
+	size = (size_t) fileSize.QuadPart;
+	if (size) {
+		// the view keeps the mapping (and file) open after the handles are closed
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping) {
+			data = (const char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+		}
+	}
+	CloseHandle(file);
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return false;
+	}
+	size = (size_t) st.st_size;
+	if (size) {
+		void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED) {
+			data = (const char *) p;
+			madvise(p, size, MADV_SEQUENTIAL);
+		}
+	}
+	close(fd);
+#endif
+	if (size && !data) {
+		size = 0;
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data) {
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+#else
+		munmap((void *) data, size);
+#endif
+	}
+	data = NULL;
+	size = 0;
+}
+
 // Normals
 
-void SetVertexNormals(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals) {
-	// size normals array and initialize to zero
-	int nverts = (int) points.size();
-	normals.resize(nverts, vec3(0, 0, 0));
-	// accumulate each triangle normal into its three vertex normals
-	for (int i = 0; i < (int) triangles.size(); i++) {
-		int3 &t = triangles[i];
-		vec3 &p1 = points[t.i1], &p2 = points[t.i2], &p3 = points[t.i3];
-		vec3 n(normalize(cross(p2-p1, p3-p2)));
-		normals[t.i1] += n;
-		normals[t.i2] += n;
-		normals[t.i3] += n;
+void TriangleAdjacency::Set(int nVertices, const vector<int3> &triangles) {
+	int nTriangles = (int) triangles.size();
+	offsets.assign(nVertices+1, 0);
+	this->triangles.resize(3*nTriangles);
+	for (int t = 0; t < nTriangles; t++)
+		for (int k = 0; k < 3; k++) {
+			int v = triangles[t][k];
+			if (v >= 0 && v < nVertices)
+				offsets[v+1]++;
+		}
+	for (int v = 0; v < nVertices; v++)
+		offsets[v+1] += offsets[v];
+	vector<int> fill(offsets.begin(), offsets.end()-1);
+	for (int t = 0; t < nTriangles; t++)
+		for (int k = 0; k < 3; k++) {
+			int v = triangles[t][k];
+			if (v >= 0 && v < nVertices)
+				this->triangles[fill[v]++] = t;
+		}
+	this->triangles.resize(offsets[nVertices]);
+}
+
+namespace {
+
+const int normalBlock = 4096;	// vertices or triangles per parallel task
+
+inline vec3 TriangleNormal(const vector<vec3> &points, const int3 &t) {
+	const vec3 &p1 = points[t.i1], &p2 = points[t.i2], &p3 = points[t.i3];
+	return normalize(cross(p2-p1, p3-p2));
+}
+
+inline vec3 GatherNormal(const TriangleAdjacency &adjacency, const vec3 *triangleNormals, int v) {
+	vec3 n(0, 0, 0);
+	for (int a = adjacency.offsets[v]; a < adjacency.offsets[v+1]; a++)
+		n += triangleNormals[adjacency.triangles[a]];
+	return normalize(n);
+}
+
+} // end namespace
+
+void SetVertexNormals(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals, int nThreads) {
+	TriangleAdjacency adjacency;
+	adjacency.Set((int) points.size(), triangles);
+	SetVertexNormals(points, triangles, normals, adjacency, nThreads);
+}
+
+void SetVertexNormals(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals,
+					  const TriangleAdjacency &adjacency, int nThreads) {
+	// triangle normals, then each vertex normal gathered from its triangles: no two tasks write the same element
+	int nVertices = (int) points.size(), nTriangles = (int) triangles.size();
+	vector<vec3> triangleNormals(nTriangles);
+	ParallelFor((nTriangles+normalBlock-1)/normalBlock, [&](int b) {
+		for (int t = b*normalBlock, stop = std::min(t+normalBlock, nTriangles); t < stop; t++)
+			triangleNormals[t] = TriangleNormal(points, triangles[t]);
+	}, nThreads);
+	normals.resize(nVertices);
+	ParallelFor((nVertices+normalBlock-1)/normalBlock, [&](int b) {
+		for (int v = b*normalBlock, stop = std::min(v+normalBlock, nVertices); v < stop; v++)
+			normals[v] = GatherNormal(adjacency, triangleNormals.data(), v);
+	}, nThreads);
+}
+
+void UpdateVertexNormals(vector<vec3> &points, vector<int3> &triangles, vector<vec3> &normals,
+						 const TriangleAdjacency &adjacency, const vector<int> &dirtyVertices) {
+	// triangles around dirty vertices changed shape, so do normals of all their vertices
+	int nVertices = (int) points.size();
+	if ((int) normals.size() != nVertices || (int) adjacency.offsets.size() != nVertices+1) {
+		SetVertexNormals(points, triangles, normals, adjacency);
+		return;
+	}
+	vector<int> changed, affected;
+	for (int v : dirtyVertices)
+		if (v >= 0 && v < nVertices)
+			for (int a = adjacency.offsets[v]; a < adjacency.offsets[v+1]; a++)
+				changed.push_back(adjacency.triangles[a]);
+	std::sort(changed.begin(), changed.end());
+	changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+	for (int t : changed)
+		for (int k = 0; k < 3; k++)
+			affected.push_back(triangles[t][k]);
+	std::sort(affected.begin(), affected.end());
+	affected.erase(std::unique(affected.begin(), affected.end()), affected.end());
+	// normals of triangles around affected vertices (sorted ids, so each is found by binary search), then gather
+	vector<int> around;
+	for (int v : affected)
+		around.insert(around.end(), adjacency.triangles.begin()+adjacency.offsets[v], adjacency.triangles.begin()+adjacency.offsets[v+1]);
+	std::sort(around.begin(), around.end());
+	around.erase(std::unique(around.begin(), around.end()), around.end());
+	vector<vec3> triangleNormals(around.size());
+	for (size_t i = 0; i < around.size(); i++)
+		triangleNormals[i] = TriangleNormal(points, triangles[around[i]]);
+	for (int v : affected) {
+		vec3 n(0, 0, 0);
+		for (int a = adjacency.offsets[v]; a < adjacency.offsets[v+1]; a++)
+			n += triangleNormals[std::lower_bound(around.begin(), around.end(), adjacency.triangles[a])-around.begin()];
+		normals[v] = normalize(n);
 	}
-	for (int i = 0; i < nverts; i++)
-		normals[i] = normalize(normals[i]);
 }
 
 // Standardize
 
-mat4 NDCfromMinMax(vec3 min, vec3 max, float scale = 1) {
+mat4 NDCfromMinMax(vec3 min, vec3 max, float scale) {
 	// matrix to transform min/max to -1/+1 (uniformly)
 	float maxrange = 0;
 	for (int k = 0; k < 3; k++)
@@ -143,14 +325,14 @@ mat4 NDCfromMinMax(vec3 min, vec3 max, float scale = 1) {
 
 mat4 StandardizeMat(vec3 *points, int npoints, float scale) {
 	vec3 min, max;
-	Bounds(points, npoints, min, max);
+	MinMax(points, npoints, min, max);
 	return NDCfromMinMax(min, max, scale);
 }
 
 void Standardize(vec3 *points, int npoints, float scale) {
+	// m is a uniform scale and translation
 	mat4 m = StandardizeMat(points, npoints, scale);
-	for (int i = 0; i < npoints; i++)
-		points[i] = Vec3(m*vec4(points[i]));
+	ScaleOffset(points, npoints, vec3(m[0][0], m[1][1], m[2][2]), vec3(m[0][3], m[1][3], m[2][3]));
 }
 
 // ASCII support
@@ -167,103 +349,14 @@ bool ReadWord(char* &ptr, char *word, int charLimit) {
 	return true;
 }
 
-// STL
-
 char *Lower(char *word) {
 	for (char *c = word; *c; c++)
 		*c = tolower(*c);
 	return word;
 }
 
-int ReadSTL(const char *filename, vector<VertexSTL> &vertices) {
-	// the facet normal should point outwards from the solid object; if this is zero,
-	// most software will calculate a normal from the ordered triangle vertices using the right-hand rule
-	class Helper {
-	public:
-		bool status = false;
-		int nTriangles = 0;
-		vector<VertexSTL> *verts;
-		vector<string> vSpecs;                              // ASCII only
-		Helper(const char *filename, vector<VertexSTL> *verts) : verts(verts) {
-			char line[1000], word[1000], *ptr = line;
-			ifstream inText(filename, ios::in);             // text default mode
-			inText.getline(line, 10);
-			bool ascii = ReadWord(ptr, word, 10) && !strcmp(Lower(word), "solid");
-			// bool ascii = ReadWord(ptr, word, 10) && !_stricmp(word, "solid");
-			ascii = false; // hmm!
-			if (ascii)
-				status = ReadASCII(inText);
-			inText.close();
-			if (!ascii) {
-				FILE *inBinary = fopen(filename, "rb");     // inText.setmode(ios::binary) fails
-				if (inBinary) {
-					nTriangles = 0;
-					status = ReadBinary(inBinary);
-					fclose(inBinary);
-				}
-				else
-					status = false;
-			}
-		}
-		bool ReadASCII(ifstream &in) {
-			printf("can't read ASCII STL\n");
-			return true;
-		}
-		bool ReadBinary(FILE *in) {
-				  // # bytes      use                  significance
-				  // -------      ---                  ------------
-				  //      80      header               none
-				  //       4      unsigned long int    number of triangles
-				  //      12      3 floats             triangle normal
-				  //      12      3 floats             x,y,z for vertex 1
-				  //      12      3 floats             vertex 2
-				  //      12      3 floats             vertex 3
-				  //       2      unsigned short int   attribute (0)
-				  // endianness is assumed to be little endian
-			// in.setmode(ios::binary); doc says setmode good, but compiler says not so
-			// sizeof(bool)=1, sizeof(char)=1, sizeof(short)=2, sizeof(int)=4, sizeof(float)=4
-			char buf[81];
-			int nTriangle = 0;//, vid1, vid2, vid3;
-			if (fread(buf, 1, 80, in) != 80) // header
-				return false;
-			if (fread(&nTriangles, sizeof(int), 1, in) != 1)
-				return false;
-			while (!feof(in)) {
-				vec3 v[3], n;
-				if (nTriangle == nTriangles)
-					break;
-				if (nTriangles > 5000 && nTriangle && nTriangle%1000 == 0)
-					printf("\rread %i/%i triangles", nTriangle, nTriangles);
-				if (fread(&n.x, sizeof(float), 3, in) != 3)
-					printf("\ncan't read triangle %d normal\n", nTriangle);
-				for (int k = 0; k < 3; k++)
-					if (fread(&v[k].x, sizeof(float), 3, in) != 3)
-						printf("\ncan't read vid %i\n", verts->size());
-				vec3 a(v[1]-v[0]), b(v[2]-v[1]);
-				vec3 ntmp = cross(a, b);
-				if (dot(ntmp, n) < 0) {
-					vec3 vtmp = v[0];
-					v[0] = v[2];
-					v[2] = vtmp;
-				}
-				for (int k = 0; k < 3; k++)
-					verts->push_back(VertexSTL((float *) &v[k].x, (float *) &n.x));
-				unsigned short attribute;
-				if (fread(&attribute, sizeof(short), 1, in) != 1)
-					printf("\ncan't read attribute\n");
-				nTriangle++;
-			}
-			printf("\r\t\t\t\t\t\t\r");
-			return true;
-		}
-	};
-	Helper h(filename, &vertices);
-	return h.nTriangles;
-} // end ReadSTL
-
 // ASCII OBJ
 
-#include <map>
 
 static const int LineLim = 10000, WordLim = 1000;
 
@@ -273,11 +366,12 @@ typedef std::map<string, Mtl, CompareS> MtlMap;
 	// string is key, Mtl is value
 
 MtlMap ReadMaterial(const char *filename) {
+	// support newmtl, ka, kd, ks, ns, d, tr, map_kd
 	MtlMap mtlMap;
 	char line[LineLim], word[WordLim];
-	Mtl m;
 	FILE *in = fopen(filename, "r");
-	string key;
+	const char *slash = strrchr(filename, '/');
+	string key, dir = slash? string(filename, slash+1) : string();
 	Mtl value;
 	if (in)
 		for (int lineNum = 0;; lineNum++) {
@@ -294,29 +388,889 @@ MtlMap ReadMaterial(const char *filename) {
 			if (!ReadWord(ptr, word, WordLim) || *word == '#')
 				continue;
 			Lower(word);
+			bool ok = true;
+			float f;
 			if (!strcmp(word, "newmtl") && ReadWord(ptr, word, WordLim)) {
 				key = string(word);
-				value.name = string(word);
+				value = Mtl();
+				value.name = key;
+				value.kd = vec3(1, 1, 1);
 			}
-			if (!strcmp(word, "kd")) {
-				if (sscanf(ptr, "%g%g%g", &value.kd.x, &value.kd.y, &value.kd.z) != 3)
-					printf("bad line %d in material file", lineNum);
-				else
-					mtlMap[key] = value;
+			else if (!strcmp(word, "ka"))
+				ok = sscanf(ptr, "%g%g%g", &value.ka.x, &value.ka.y, &value.ka.z) == 3;
+			else if (!strcmp(word, "kd"))
+				ok = sscanf(ptr, "%g%g%g", &value.kd.x, &value.kd.y, &value.kd.z) == 3;
+			else if (!strcmp(word, "ks"))
+				ok = sscanf(ptr, "%g%g%g", &value.ks.x, &value.ks.y, &value.ks.z) == 3;
+			else if (!strcmp(word, "ns"))
+				ok = sscanf(ptr, "%g", &value.ns) == 1;
+			else if (!strcmp(word, "d"))
+				ok = sscanf(ptr, "%g", &value.d) == 1;
+			else if (!strcmp(word, "tr")) {
+				if ((ok = sscanf(ptr, "%g", &f) == 1))
+					value.d = 1-f;
+			}
+			else if (!strcmp(word, "map_kd")) {
+				// options (eg, -s u v w) precede file name, which is last word
+				while (ReadWord(ptr, word, WordLim))
+					value.mapKd = *word == '/' || strchr(word, ':')? string(word) : dir+word;
 			}
+			else
+				continue;
+			if (!ok)
+				printf("bad line %d in material file", lineNum);
+			else if (key.size())
+				mtlMap[key] = value;
 		}
 	// else printf("can't open %s\n", filename);
+	if (in)
+		fclose(in);
 	return mtlMap;
 }
 
-struct CompareVid {
-	bool operator() (const int3 &a, const int3 &b) const {
-		return (a.i1==b.i1? (a.i2==b.i2? a.i3 < b.i3 : a.i2 < b.i2) : a.i1 < b.i1);
+void SortTrianglesByMaterial(vector<int3> &triangles, vector<Mtl> &triangleMtls, vector<Group> *triangleGroups) {
+	int nTriangles = triangles.size(), nMtls = triangleMtls.size();
+	if (!nMtls)
+		return;
+	// distinct materials, ordered by texture map, then by first use
+	std::map<string, int> ids;
+	vector<int> firstRecord, recordIds(nMtls);
+	for (int i = 0; i < nMtls; i++) {
+		std::map<string, int>::iterator it = ids.find(triangleMtls[i].name);
+		if (it == ids.end()) {
+			it = ids.insert(std::make_pair(triangleMtls[i].name, (int) firstRecord.size())).first;
+			firstRecord.push_back(i);
+		}
+		recordIds[i] = it->second;
+	}
+	int nIds = firstRecord.size();
+	vector<int> order(nIds), rank(nIds);
+	for (int i = 0; i < nIds; i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+		return triangleMtls[firstRecord[a]].mapKd < triangleMtls[firstRecord[b]].mapKd;
+	});
+	for (int i = 0; i < nIds; i++)
+		rank[order[i]] = i;
+	// key per triangle: 0 for triangles preceding any material, else 1+rank of material
+	vector<int> keys(nTriangles, 0), counts(nIds+2, 0);
+	for (int i = 0; i < nMtls; i++) {
+		int start = std::max(0, triangleMtls[i].startTriangle);
+		int stop = i < nMtls-1? triangleMtls[i+1].startTriangle : nTriangles;
+		for (int t = start; t < stop && t < nTriangles; t++)
+			keys[t] = 1+rank[recordIds[i]];
+	}
+	// stable counting sort
+	for (int t = 0; t < nTriangles; t++)
+		counts[keys[t]+1]++;
+	for (int k = 0; k < nIds+1; k++)
+		counts[k+1] += counts[k];
+	vector<int> newOrder(nTriangles);	// old index for each new position
+	vector<int> next(counts.begin(), counts.end()-1);
+	for (int t = 0; t < nTriangles; t++)
+		newOrder[next[keys[t]]++] = t;
+	vector<int3> sorted(nTriangles);
+	for (int t = 0; t < nTriangles; t++)
+		sorted[t] = triangles[newOrder[t]];
+	triangles.swap(sorted);
+	// one record per material
+	vector<Mtl> mtls;
+	for (int i = 0; i < nIds; i++) {
+		Mtl m = triangleMtls[firstRecord[order[i]]];
+		m.startTriangle = counts[i+1];
+		m.nTriangles = counts[i+2]-counts[i+1];
+		mtls.push_back(m);
+	}
+	triangleMtls.swap(mtls);
+	// groups as contiguous runs in new order
+	if (triangleGroups && triangleGroups->size()) {
+		vector<Group> &groups = *triangleGroups;
+		vector<int> groupIds(nTriangles, -1);
+		for (int g = 0; g < (int) groups.size(); g++)
+			for (int t = std::max(0, groups[g].startTriangle); t < groups[g].startTriangle+groups[g].nTriangles && t < nTriangles; t++)
+				groupIds[t] = g;
+		vector<Group> runs;
+		for (int t = 0; t < nTriangles; t++) {
+			int g = groupIds[newOrder[t]];
+			if (t > 0 && g == groupIds[newOrder[t-1]]) {
+				if (runs.size())
+					runs.back().nTriangles++;
+				continue;
+			}
+			if (g < 0 && t == 0)
+				continue;	// ungrouped triangles remain first
+			Group run = g < 0? Group(t) : groups[g];
+			run.startTriangle = t;
+			run.nTriangles = 1;
+			runs.push_back(run);
+		}
+		groups.swap(runs);
+	}
+}
+
+// Simplification
+
+vector<int> TriangleRangeBounds(int nTriangles, vector<Group> *triangleGroups, vector<Mtl> *triangleMtls) {
+	vector<int> bounds = {0, nTriangles};
+	if (triangleGroups)
+		for (Group &g : *triangleGroups)
+			bounds.insert(bounds.end(), {g.startTriangle, g.startTriangle+g.nTriangles});
+	if (triangleMtls)
+		for (Mtl &m : *triangleMtls)
+			bounds.insert(bounds.end(), {m.startTriangle, m.startTriangle+m.nTriangles});
+	for (int &b : bounds)
+		b = std::min(std::max(b, 0), nTriangles);
+	std::sort(bounds.begin(), bounds.end());
+	bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+	return bounds;
+}
+
+namespace {
+
+struct Quadric {
+	// symmetric 4x4 a, b, c, d plane products: squared distance to a sum of planes
+	double q[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+	void AddPlane(vec3 n, float d, double w) {
+		double a = n.x, b = n.y, c = n.z;
+		double p[10] = {a*a, a*b, a*c, a*d, b*b, b*c, b*d, c*c, c*d, (double) d*d};
+		for (int i = 0; i < 10; i++)
+			q[i] += w*p[i];
+	}
+	void operator += (const Quadric &o) { for (int i = 0; i < 10; i++) q[i] += o.q[i]; }
+	double Error(vec3 p) const {
+		double x = p.x, y = p.y, z = p.z;
+		return q[0]*x*x+2*q[1]*x*y+2*q[2]*x*z+2*q[3]*x+q[4]*y*y+2*q[5]*y*z+2*q[6]*y+q[7]*z*z+2*q[8]*z+q[9];
+	}
+};
+
+class Simplifier {
+	// edge collapse in order of least quadric error, each vertex collapsing onto a neighbor
+public:
+	const vector<vec3> &points;
+	vector<int3> tris;
+	vector<int> vertexIds;				// global id of each local vertex
+	vector<vector<int>> vertexTris;		// triangles that use each vertex (may include dead ones)
+	vector<Quadric> quadrics;
+	vector<char> locked, border, removed, dead;
+	vector<int> versions;
+	int nLive = 0;
+	struct Collapse {
+		float cost;
+		int from, to, fromVersion, toVersion;
+		bool operator < (const Collapse &c) const { return cost > c.cost; }	// least cost on top
+	};
+	std::priority_queue<Collapse> queue;
+	Simplifier(const vector<vec3> &points, const int3 *range, int nTris, const vector<bool> *lockedIds) : points(points) {
+		for (int t = 0; t < nTris; t++)
+			for (int k = 0; k < 3; k++)
+				vertexIds.push_back(range[t][k]);
+		std::sort(vertexIds.begin(), vertexIds.end());
+		vertexIds.erase(std::unique(vertexIds.begin(), vertexIds.end()), vertexIds.end());
+		int nVertices = (int) vertexIds.size();
+		tris.resize(nTris);
+		vertexTris.resize(nVertices);
+		for (int t = 0; t < nTris; t++)
+			for (int k = 0; k < 3; k++) {
+				int v = (int) (std::lower_bound(vertexIds.begin(), vertexIds.end(), range[t][k])-vertexIds.begin());
+				tris[t][k] = v;
+				vertexTris[v].push_back(t);
+			}
+		quadrics.resize(nVertices);
+		locked.assign(nVertices, 0);
+		border.assign(nVertices, 0);
+		removed.assign(nVertices, 0);
+		dead.assign(nTris, 0);
+		versions.assign(nVertices, 0);
+		nLive = nTris;
+		if (lockedIds)
+			for (int v = 0; v < nVertices; v++)
+				locked[v] = vertexIds[v] < (int) lockedIds->size() && (*lockedIds)[vertexIds[v]];
+		// degenerate triangles are dropped
+		for (int t = 0; t < nTris; t++) {
+			int3 &tri = tris[t];
+			if (tri.i1 == tri.i2 || tri.i2 == tri.i3 || tri.i3 == tri.i1) {
+				dead[t] = 1;
+				nLive--;
+			}
+		}
+		// plane quadrics
+		for (int t = 0; t < nTris; t++)
+			if (!dead[t]) {
+				vec3 p1 = Point(tris[t].i1), p2 = Point(tris[t].i2), p3 = Point(tris[t].i3), n = cross(p2-p1, p3-p1);
+				float l = length(n);
+				if (l <= 0)
+					continue;
+				n /= l;
+				for (int k = 0; k < 3; k++)
+					quadrics[tris[t][k]].AddPlane(n, -dot(n, p1), 1);
+			}
+		// edges used by one triangle are border (vertices may move only along them), by more than two are locked;
+		// border edges add perpendicular planes, weighted to keep the outline
+		vector<std::pair<int2, int>> edges;	// (lesser, greater vertex), triangle
+		for (int t = 0; t < nTris; t++)
+			if (!dead[t])
+				for (int k = 0; k < 3; k++) {
+					int a = tris[t][k], b = tris[t][(k+1)%3];
+					edges.push_back(std::make_pair(int2(std::min(a, b), std::max(a, b)), t));
+				}
+		std::sort(edges.begin(), edges.end(), [](const std::pair<int2, int> &a, const std::pair<int2, int> &b) {
+			return a.first.i1 < b.first.i1 || (a.first.i1 == b.first.i1 && a.first.i2 < b.first.i2);
+		});
+		for (size_t i = 0, j; i < edges.size(); i = j) {
+			int2 e = edges[i].first;
+			for (j = i+1; j < edges.size() && edges[j].first.i1 == e.i1 && edges[j].first.i2 == e.i2; j++)
+				;
+			if (j-i > 2)
+				locked[e.i1] = locked[e.i2] = 1;
+			if (j-i == 1) {
+				border[e.i1] = border[e.i2] = 1;
+				const int3 &tri = tris[edges[i].second];
+				vec3 p1 = Point(e.i1), p2 = Point(e.i2), d = p2-p1;
+				vec3 n = cross(Point(tri.i2)-Point(tri.i1), Point(tri.i3)-Point(tri.i1)), perp = cross(d, n);
+				float l = length(perp);
+				if (l > 0) {
+					perp /= l;
+					for (int v : {e.i1, e.i2})
+						quadrics[v].AddPlane(perp, -dot(perp, p1), 10);
+				}
+			}
+		}
+	}
+	vec3 Point(int v) const { return points[vertexIds[v]]; }
+	int SharedTriangles(int a, int b) const {
+		int n = 0;
+		for (int t : vertexTris[a])
+			if (!dead[t] && (tris[t].i1 == b || tris[t].i2 == b || tris[t].i3 == b))
+				n++;
+		return n;
+	}
+	void Push(int from, int to) {
+		if (locked[from] || removed[from] || removed[to] || from == to)
+			return;
+		if (border[from] && (!border[to] || SharedTriangles(from, to) != 1))
+			return;
+		Quadric q = quadrics[from];
+		q += quadrics[to];
+		queue.push({(float) std::max(0., q.Error(Point(to))), from, to, versions[from], versions[to]});
+	}
+	void PushNeighbors(int v) {
+		for (int t : vertexTris[v])
+			if (!dead[t])
+				for (int k = 0; k < 3; k++) {
+					int w = tris[t][k];
+					if (w != v) {
+						Push(v, w);
+						Push(w, v);
+					}
+				}
+	}
+	bool Flips(int from, int to) const {
+		// would moving from onto to flip or degenerate a remaining triangle?
+		vec3 p = Point(to);
+		for (int t : vertexTris[from]) {
+			const int3 &tri = tris[t];
+			if (dead[t] || tri.i1 == to || tri.i2 == to || tri.i3 == to)
+				continue;
+			vec3 q[3] = {Point(tri.i1), Point(tri.i2), Point(tri.i3)}, n1 = cross(q[1]-q[0], q[2]-q[0]);
+			for (int k = 0; k < 3; k++)
+				if (tri[k] == from)
+					q[k] = p;
+			vec3 n2 = cross(q[1]-q[0], q[2]-q[0]);
+			if (dot(n1, n2) <= .25f*length(n1)*length(n2))
+				return true;
+		}
+		return false;
+	}
+	float Run(int target) {
+		// collapse until at most target live triangles remain; return largest error (distance) incurred
+		for (int v = 0; v < (int) vertexIds.size(); v++)
+			for (int t : vertexTris[v])
+				if (!dead[t])
+					for (int k = 0; k < 3; k++)
+						if (tris[t][k] != v)
+							Push(v, tris[t][k]);
+		float maxCost = 0;
+		while (nLive > target && !queue.empty()) {
+			Collapse c = queue.top();
+			queue.pop();
+			if (removed[c.from] || removed[c.to] || c.fromVersion != versions[c.from] || c.toVersion != versions[c.to])
+				continue;
+			if (Flips(c.from, c.to))
+				continue;
+			for (int t : vertexTris[c.from]) {
+				if (dead[t])
+					continue;
+				int3 &tri = tris[t];
+				if (tri.i1 == c.to || tri.i2 == c.to || tri.i3 == c.to) {
+					dead[t] = 1;
+					nLive--;
+				}
+				else {
+					for (int k = 0; k < 3; k++)
+						if (tri[k] == c.from)
+							tri[k] = c.to;
+					vertexTris[c.to].push_back(t);
+				}
+			}
+			removed[c.from] = 1;
+			vertexTris[c.from].clear();
+			quadrics[c.to] += quadrics[c.from];
+			versions[c.to]++;
+			maxCost = std::max(maxCost, c.cost);
+			PushNeighbors(c.to);
+		}
+		return sqrt(maxCost);
+	}
+};
+
+} // end namespace
+
+float SimplifyTriangles(const vector<vec3> &points, const int3 *triangles, int nTriangles, int targetTriangles,
+						vector<int3> &result, const vector<bool> *locked) {
+	Simplifier s(points, triangles, nTriangles, locked);
+	float error = s.Run(targetTriangles);
+	result.resize(0);
+	for (int t = 0; t < nTriangles; t++)
+		if (!s.dead[t]) {
+			const int3 &tri = s.tris[t];
+			result.push_back(int3(s.vertexIds[tri.i1], s.vertexIds[tri.i2], s.vertexIds[tri.i3]));
+		}
+	return error;
+}
+
+// Meshlets
+
+namespace {
+
+void BuildRangeMeshlets(const vector<vec3> &points, int3 *tris, int nTris, int startTriangle, int maxVertices,
+						int maxTriangles, vector<Meshlet> &meshlets) {
+	// grow each meshlet from its first unused triangle by adjacent triangles, preferring those that add fewest
+	// vertices, then those nearest the meshlet centroid; rewrite tris in meshlet order
+	vector<int> vertexIds;
+	for (int t = 0; t < nTris; t++)
+		for (int k = 0; k < 3; k++)
+			vertexIds.push_back(tris[t][k]);
+	std::sort(vertexIds.begin(), vertexIds.end());
+	vertexIds.erase(std::unique(vertexIds.begin(), vertexIds.end()), vertexIds.end());
+	int nVertices = (int) vertexIds.size();
+	vector<int3> local(nTris);
+	vector<int> offsets(nVertices+1, 0), adjacent(3*nTris);
+	for (int t = 0; t < nTris; t++)
+		for (int k = 0; k < 3; k++) {
+			local[t][k] = (int) (std::lower_bound(vertexIds.begin(), vertexIds.end(), tris[t][k])-vertexIds.begin());
+			offsets[local[t][k]+1]++;
+		}
+	for (int v = 0; v < nVertices; v++)
+		offsets[v+1] += offsets[v];
+	vector<int> fill(offsets.begin(), offsets.end()-1);
+	for (int t = 0; t < nTris; t++)
+		for (int k = 0; k < 3; k++)
+			adjacent[fill[local[t][k]]++] = t;
+	vector<int> owner(nVertices, -1), order, candidates;	// owner: meshlet that last used vertex
+	vector<bool> used(nTris, false);
+	order.reserve(nTris);
+	for (int seed = 0; seed < nTris; seed++) {
+		if (used[seed])
+			continue;
+		int id = (int) meshlets.size(), nUsedVertices = 0, start = (int) order.size();
+		vec3 sum(0, 0, 0);
+		candidates.assign(1, seed);
+		while (!candidates.empty() && (int) order.size()-start < maxTriangles) {
+			// best candidate
+			int best = -1, bestNew = 4;
+			float bestDistance = 0;
+			vec3 centroid = order.size() > (size_t) start? sum/(float) (order.size()-start) : vec3(0, 0, 0);
+			for (size_t c = 0; c < candidates.size(); c++) {
+				int t = candidates[c];
+				if (used[t])
+					continue;
+				int nNew = 0;
+				for (int k = 0; k < 3; k++)
+					nNew += owner[local[t][k]] != id;
+				vec3 p = (points[tris[t].i1]+points[tris[t].i2]+points[tris[t].i3])/3;
+				float d = order.size() > (size_t) start? length(p-centroid) : 0;
+				if (nNew < bestNew || (nNew == bestNew && d < bestDistance)) {
+					best = t;
+					bestNew = nNew;
+					bestDistance = d;
+				}
+			}
+			candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](int t) { return used[t]; }), candidates.end());
+			if (best < 0 || nUsedVertices+bestNew > maxVertices)
+				break;
+			used[best] = true;
+			order.push_back(best);
+			sum += (points[tris[best].i1]+points[tris[best].i2]+points[tris[best].i3])/3;
+			for (int k = 0; k < 3; k++) {
+				int v = local[best][k];
+				if (owner[v] == id)
+					continue;
+				owner[v] = id;
+				nUsedVertices++;
+				for (int a = offsets[v]; a < offsets[v+1]; a++)
+					if (!used[adjacent[a]])
+						candidates.push_back(adjacent[a]);
+			}
+		}
+		Meshlet m;
+		m.startTriangle = startTriangle+start;
+		m.nTriangles = (int) order.size()-start;
+		meshlets.push_back(m);
+	}
+	vector<int3> sorted(nTris);
+	for (int i = 0; i < nTris; i++)
+		sorted[i] = tris[order[i]];
+	std::copy(sorted.begin(), sorted.end(), tris);
+}
+
+void SetMeshletBounds(const vector<vec3> &points, const vector<int3> &triangles, Meshlet &m) {
+	// bounding sphere about box center, normal cone about mean triangle normal
+	vec3 min(FLT_MAX, FLT_MAX, FLT_MAX), max(-FLT_MAX, -FLT_MAX, -FLT_MAX), axis(0, 0, 0);
+	vector<vec3> normals;
+	for (int t = m.startTriangle; t < m.startTriangle+m.nTriangles; t++) {
+		const int3 &tri = triangles[t];
+		for (int k = 0; k < 3; k++) {
+			const vec3 &p = points[tri[k]];
+			for (int i = 0; i < 3; i++) {
+				min[i] = p[i] < min[i]? p[i] : min[i];
+				max[i] = p[i] > max[i]? p[i] : max[i];
+			}
+		}
+		vec3 n = cross(points[tri.i2]-points[tri.i1], points[tri.i3]-points[tri.i1]);
+		float l = length(n);
+		if (l > 0) {
+			normals.push_back(n/l);
+			axis += n/l;
+		}
+	}
+	m.center = (min+max)/2;
+	m.radius = 0;
+	for (int t = m.startTriangle; t < m.startTriangle+m.nTriangles; t++)
+		for (int k = 0; k < 3; k++) {
+			float d = length(points[triangles[t][k]]-m.center);
+			m.radius = d > m.radius? d : m.radius;
+		}
+	float l = length(axis), minDot = 1;
+	m.coneAxis = l > 0? axis/l : vec3(0, 0, 1);
+	for (vec3 &n : normals)
+		minDot = std::min(minDot, dot(n, m.coneAxis));
+	// cutoff is sine of cone half-angle; 1 (never culled) if the cone is a hemisphere or wider
+	m.coneCutoff = l > 0 && minDot > 0? sqrt(1-minDot*minDot) : 1;
+}
+
+} // end namespace
+
+void BuildMeshlets(const vector<vec3> &points, vector<int3> &triangles, vector<Meshlet> &meshlets, int maxVertices,
+				   int maxTriangles, vector<Group> *triangleGroups, vector<Mtl> *triangleMtls, int nThreads) {
+	int nTriangles = (int) triangles.size(), nPoints = (int) points.size();
+	meshlets.resize(0);
+	for (int t = 0; t < nTriangles; t++)
+		for (int k = 0; k < 3; k++)
+			if (triangles[t][k] < 0 || triangles[t][k] >= nPoints) {
+				printf("BuildMeshlets: bad vertex id %i\n", triangles[t][k]);
+				return;
+			}
+	if (maxVertices < 3 || maxTriangles < 1)
+		return;
+	vector<int> bounds = TriangleRangeBounds(nTriangles, triangleGroups, triangleMtls);
+	int nRanges = (int) bounds.size()-1;
+	vector<vector<Meshlet>> rangeMeshlets(nRanges);
+	ParallelFor(nRanges, [&](int r) {
+		BuildRangeMeshlets(points, triangles.data()+bounds[r], bounds[r+1]-bounds[r], bounds[r], maxVertices, maxTriangles, rangeMeshlets[r]);
+		for (Meshlet &m : rangeMeshlets[r])
+			SetMeshletBounds(points, triangles, m);
+	}, nThreads);
+	for (vector<Meshlet> &m : rangeMeshlets)
+		meshlets.insert(meshlets.end(), m.begin(), m.end());
+}
+
+// Triangle order
+
+float ACMR(const vector<int3> &triangles, int cacheSize) {
+	// simulate FIFO post-transform cache of cacheSize entries
+	int nTriangles = (int) triangles.size(), nVertices = 0;
+	if (!nTriangles)
+		return 0;
+	for (int t = 0; t < nTriangles; t++)
+		for (int k = 0; k < 3; k++)
+			nVertices = std::max(nVertices, triangles[t][k]+1);
+	vector<int> stamps(nVertices, 0);	// time vertex entered cache, 0 if never
+	int time = cacheSize+1, nMisses = 0;	// start beyond cacheSize so a zero stamp is a miss
+	for (int t = 0; t < nTriangles; t++)
+		for (int k = 0; k < 3; k++) {
+			int v = triangles[t][k];
+			if (v >= 0 && time-stamps[v] > cacheSize) {
+				stamps[v] = time++;
+				nMisses++;
+			}
+		}
+	return (float) nMisses/nTriangles;
+}
+
+namespace {
+
+class TriangleOrder {
+	// reorder a range of triangles: Tipsify for the vertex cache (Sander, Nehab, Barczak 2007), then
+	// clusters (split at cache flushes and where local ACMR is low) sorted front-to-back for overdraw
+public:
+	vector<int3> tris;			// range, in local vertex ids
+	vector<int> vertexIds;		// global id of each local vertex
+	int nVertices = 0, cacheSize = 16;
+	TriangleOrder(const int3 *range, int nTris, int cacheSize) : cacheSize(cacheSize) {
+		// compact vertex ids to those used by range
+		for (int t = 0; t < nTris; t++)
+			for (int k = 0; k < 3; k++)
+				vertexIds.push_back(range[t][k]);
+		std::sort(vertexIds.begin(), vertexIds.end());
+		vertexIds.erase(std::unique(vertexIds.begin(), vertexIds.end()), vertexIds.end());
+		nVertices = (int) vertexIds.size();
+		tris.resize(nTris);
+		for (int t = 0; t < nTris; t++)
+			for (int k = 0; k < 3; k++)
+				tris[t][k] = (int) (std::lower_bound(vertexIds.begin(), vertexIds.end(), range[t][k])-vertexIds.begin());
+	}
+	void Tipsify(vector<int> &order, vector<int> &clusterStarts) {
+		// set order (of tris) and positions in order where the cache was flushed
+		int nTris = (int) tris.size();
+		// vertex to triangle adjacency (compressed rows)
+		vector<int> offsets(nVertices+1, 0), adjacent(3*nTris), live(nVertices, 0), stamps(nVertices, 0), deadEnds;
+		for (int t = 0; t < nTris; t++)
+			for (int k = 0; k < 3; k++)
+				offsets[tris[t][k]+1]++;
+		for (int v = 0; v < nVertices; v++) {
+			live[v] = offsets[v+1];
+			offsets[v+1] += offsets[v];
+		}
+		vector<int> fill(offsets.begin(), offsets.end()-1);
+		for (int t = 0; t < nTris; t++)
+			for (int k = 0; k < 3; k++)
+				adjacent[fill[tris[t][k]]++] = t;
+		vector<bool> emitted(nTris, false);
+		vector<int> candidates;
+		order.resize(0);
+		clusterStarts.assign(1, 0);
+		int time = cacheSize+1, cursor = 0, fan = nVertices? 0 : -1;
+		while (fan >= 0) {
+			if (time-stamps[fan] > cacheSize && order.size() && clusterStarts.back() != (int) order.size())
+				clusterStarts.push_back((int) order.size());	// fanning vertex not in cache: hard boundary
+			candidates.resize(0);
+			for (int a = offsets[fan]; a < offsets[fan+1]; a++) {
+				int t = adjacent[a];
+				if (emitted[t])
+					continue;
+				for (int k = 0; k < 3; k++) {
+					int v = tris[t][k];
+					deadEnds.push_back(v);
+					candidates.push_back(v);
+					live[v]--;
+					if (time-stamps[v] > cacheSize)
+						stamps[v] = time++;
+				}
+				emitted[t] = true;
+				order.push_back(t);
+			}
+			// next fanning vertex: the candidate still in cache after its remaining triangles, oldest first
+			int next = -1, best = -1;
+			for (int v : candidates)
+				if (live[v] > 0) {
+					int priority = time-stamps[v]+2*live[v] <= cacheSize? time-stamps[v] : 0;
+					if (priority > best) {
+						best = priority;
+						next = v;
+					}
+				}
+			if (next < 0) {
+				// dead end: most recent vertex with live triangles, else next in input order
+				while (deadEnds.size() && next < 0) {
+					int v = deadEnds.back();
+					deadEnds.pop_back();
+					if (live[v] > 0)
+						next = v;
+				}
+				while (next < 0 && cursor < nVertices)
+					if (live[cursor++] > 0)
+						next = cursor-1;
+			}
+			fan = next;
+		}
+	}
+	void SoftBoundaries(const vector<int> &order, vector<int> &clusterStarts, float threshold) {
+		// split clusters where ACMR since the last split, starting with an empty cache, has fallen
+		// to threshold times the ACMR of the whole cluster
+		int nTris = (int) order.size(), time = cacheSize+1;
+		vector<int> stamps(nVertices, 0), starts;
+		auto Misses = [&](int i) {
+			int n = 0;
+			for (int k = 0; k < 3; k++) {
+				int v = tris[order[i]][k];
+				if (time-stamps[v] > cacheSize) {
+					stamps[v] = time++;
+					n++;
+				}
+			}
+			return n;
+		};
+		for (size_t c = 0; c < clusterStarts.size(); c++) {
+			int start = clusterStarts[c], stop = c+1 < clusterStarts.size()? clusterStarts[c+1] : nTris, nMisses = 0;
+			time += cacheSize;										// flush
+			for (int i = start; i < stop; i++)
+				nMisses += Misses(i);
+			float limit = threshold*nMisses/(stop-start);
+			starts.push_back(start);
+			time += cacheSize;
+			for (int i = start, n = 0, m = 0; i < stop; i++) {
+				n++;
+				m += Misses(i);
+				if (i+1 < stop && m <= limit*n) {
+					starts.push_back(i+1);
+					time += cacheSize;
+					n = m = 0;
+				}
+			}
+		}
+		clusterStarts.swap(starts);
+	}
+	void SortClusters(vector<int> &order, const vector<int> &clusterStarts, const vector<vec3> &points) {
+		// outward-facing clusters far from the range centroid first, as they likely occlude the rest
+		int nTris = (int) order.size(), nClusters = (int) clusterStarts.size();
+		vector<vec3> centroids(nClusters), normals(nClusters);
+		vector<float> areas(nClusters, 0);
+		vec3 center(0, 0, 0);
+		float total = 0;
+		for (int c = 0; c < nClusters; c++) {
+			int stop = c+1 < nClusters? clusterStarts[c+1] : nTris;
+			vec3 centroid(0, 0, 0), normal(0, 0, 0);
+			float area = 0;
+			for (int i = clusterStarts[c]; i < stop; i++) {
+				const int3 &t = tris[order[i]];
+				vec3 p1 = points[vertexIds[t.i1]], p2 = points[vertexIds[t.i2]], p3 = points[vertexIds[t.i3]];
+				vec3 n = cross(p2-p1, p3-p1);
+				float a = length(n);
+				centroid += a*(p1+p2+p3)/3;
+				normal += n;
+				area += a;
+			}
+			centroids[c] = area > 0? centroid/area : centroid;
+			normals[c] = normal;
+			areas[c] = area;
+			center += centroid;
+			total += area;
+		}
+		if (total > 0)
+			center /= total;
+		vector<float> keys(nClusters);
+		vector<int> clusters(nClusters);
+		for (int c = 0; c < nClusters; c++) {
+			float l = length(normals[c]);
+			keys[c] = l > 0? dot(centroids[c]-center, normals[c])/l : 0;
+			clusters[c] = c;
+		}
+		std::stable_sort(clusters.begin(), clusters.end(), [&](int a, int b) { return keys[a] > keys[b]; });
+		vector<int> sorted;
+		sorted.reserve(nTris);
+		for (int c : clusters)
+			for (int i = clusterStarts[c], stop = c+1 < nClusters? clusterStarts[c+1] : nTris; i < stop; i++)
+				sorted.push_back(order[i]);
+		order.swap(sorted);
 	}
 };
 
-typedef std::map<int3, int, CompareVid> VidMap;
-	// int3 is key, int is value
+} // end namespace
+
+void OptimizeTriangleOrder(vector<vec3> &points, vector<int3> &triangles, vector<vec3> *normals, vector<vec2> *uvs,
+						   vector<int4> *quads, vector<Group> *triangleGroups, vector<Mtl> *triangleMtls,
+						   int cacheSize, float overdrawThreshold, float *acmrBefore, float *acmrAfter, int nThreads) {
+	int nTriangles = (int) triangles.size(), nPoints = (int) points.size();
+	if (acmrBefore)
+		*acmrBefore = ACMR(triangles, cacheSize);
+	for (int t = 0; t < nTriangles; t++)
+		for (int k = 0; k < 3; k++)
+			if (triangles[t][k] < 0 || triangles[t][k] >= nPoints) {
+				printf("OptimizeTriangleOrder: bad vertex id %i\n", triangles[t][k]);
+				if (acmrAfter)
+					*acmrAfter = acmrBefore? *acmrBefore : ACMR(triangles, cacheSize);
+				return;
+			}
+	// ranges bounded by every group and material start and end, so both remain valid
+	vector<int> bounds = TriangleRangeBounds(nTriangles, triangleGroups, triangleMtls);
+	// reorder each range independently
+	ParallelFor((int) bounds.size()-1, [&](int r) {
+		int start = bounds[r], nTris = bounds[r+1]-start;
+		TriangleOrder range(triangles.data()+start, nTris, cacheSize);
+		vector<int> order, clusterStarts;
+		range.Tipsify(order, clusterStarts);
+		if (overdrawThreshold > 0) {
+			range.SoftBoundaries(order, clusterStarts, overdrawThreshold);
+			range.SortClusters(order, clusterStarts, points);
+		}
+		for (int i = 0; i < nTris; i++) {
+			const int3 &t = range.tris[order[i]];
+			triangles[start+i] = int3(range.vertexIds[t.i1], range.vertexIds[t.i2], range.vertexIds[t.i3]);
+		}
+	}, nThreads);
+	// vertices in order of first use, unused vertices last
+	vector<int> newIds(nPoints, -1), oldIds;
+	oldIds.reserve(nPoints);
+	for (int t = 0; t < nTriangles; t++)
+		for (int k = 0; k < 3; k++)
+			if (newIds[triangles[t][k]] < 0) {
+				newIds[triangles[t][k]] = (int) oldIds.size();
+				oldIds.push_back(triangles[t][k]);
+			}
+	if (quads)
+		for (int4 &q : *quads)
+			for (int k = 0; k < 4; k++)
+				if (q[k] >= 0 && q[k] < nPoints && newIds[q[k]] < 0) {
+					newIds[q[k]] = (int) oldIds.size();
+					oldIds.push_back(q[k]);
+				}
+	for (int i = 0; i < nPoints; i++)
+		if (newIds[i] < 0) {
+			newIds[i] = (int) oldIds.size();
+			oldIds.push_back(i);
+		}
+	auto Permute = [&](auto &v) {
+		if ((int) v.size() != nPoints)
+			return;
+		typename std::remove_reference<decltype(v)>::type permuted(nPoints);
+		for (int i = 0; i < nPoints; i++)
+			permuted[i] = v[oldIds[i]];
+		v.swap(permuted);
+	};
+	Permute(points);
+	if (normals)
+		Permute(*normals);
+	if (uvs)
+		Permute(*uvs);
+	for (int3 &t : triangles)
+		t = int3(newIds[t.i1], newIds[t.i2], newIds[t.i3]);
+	if (quads)
+		for (int4 &q : *quads)
+			for (int k = 0; k < 4; k++)
+				if (q[k] >= 0 && q[k] < nPoints)
+					q[k] = newIds[q[k]];
+	if (acmrAfter)
+		*acmrAfter = ACMR(triangles, cacheSize);
+}
+
+class ObjFaces {
+	// face assembly shared by the OBJ readers:
+	// convert face vid/tid/nid triplets to points, triangles, quads, segs
+public:
+	vector<vec3> &points;
+	vector<int3> &triangles;
+	vector<vec3> *normals;
+	vector<vec2> *textures;
+	vector<int4> *quads;
+	vector<int2> *segs;
+	vector<vec3> tmpVertices, tmpNormals;
+	vector<vec2> tmpTextures;
+	size_t nVertices = 0, nTextures = 0, nNormals = 0; // # read when current face began
+	bool hashedTriangles = false;	// true if any triangle vertex specified with different point/normal/texture id
+	bool hashedVertices = false;	// true if point/normal/texture arrays different (non-zero) size
+	int nQuadsConvertedToTris = 0;
+	size_t nExpectedVertices = 0;	// if known, # vertices in file, to pre-size vidMap
+	Int3Map vidMap;					// vid/tid/nid to output vertex
+	vector<int> vids;
+	ObjFaces(vector<vec3> &points, vector<int3> &triangles, vector<vec3> *normals, vector<vec2> *textures,
+			 vector<int4> *quads, vector<int2> *segs) :
+		points(points), triangles(triangles), normals(normals), textures(textures), quads(quads), segs(segs) { }
+	static bool HashedVertices(size_t nvids, size_t ntids, size_t nnids) {
+		return (ntids && ntids != nvids) || (nnids && nnids != nvids);
+	}
+	void Begin() { Begin(tmpVertices.size(), tmpTextures.size(), tmpNormals.size()); }
+	void Begin(size_t nvids, size_t ntids, size_t nnids) {
+		// nvids, ntids, nnids are # vertices, textures, normals that precede the face in the file
+		nVertices = nvids;
+		nTextures = ntids;
+		nNormals = nnids;
+		if (HashedVertices(nvids, ntids, nnids))
+			hashedVertices = true;
+		vids.resize(0);
+	}
+	void Add(int vid, int tid, int nid) {
+		// vid, tid, nid indexed from 0
+		if ((tid >= 0 && tid != vid) || (nid >= 0 && nid != vid))
+			hashedTriangles = true;
+		if (!hashedVertices && !hashedTriangles) {
+			vids.push_back(vid);
+			return;
+		}
+		if (!vidMap.Size())
+			vidMap.Reserve(std::max(nExpectedVertices, std::max(tmpVertices.size(), std::max(tmpTextures.size(), tmpNormals.size()))));
+		bool inserted;
+		int *it = vidMap.Insert(int3(vid, tid, nid), (int) points.size(), inserted);
+		// following can fail on early vertices
+		// to support OBJ must support triangle vid1/tid1/nid1, vid2/tid2/nid2, vid3/tid3/nid3
+		// which would mean changing current implementation
+		// instead, test for hashed vertices (ie, has vid ever not equaled tid or nid?)
+		// but we add specific test for simple impl
+		// need a straightforward implementation for when
+		// vid=tid=nid and/or there is no tid, no nid
+		if (inserted) {
+			size_t nvrts = points.size();
+			points.push_back(tmpVertices[vid]); // *** suspect
+			if (normals && (int) nNormals > nid)
+				normals->push_back(tmpNormals[nid]);
+			if (textures && (int) nTextures > tid)
+				textures->push_back(tmpTextures[tid]);
+			vids.push_back(nvrts);
+		}
+		else
+			vids.push_back(*it);
+	}
+	int3 Triangle(int id1, int id2, int id3) const {
+		if (normals && (int) normals->size() > id1) {
+			vec3 p1, p2, p3;
+			if (hashedVertices || hashedTriangles) { p1 = points[id1]; p2 = points[id2]; p3 = points[id3]; }
+			else { p1 = tmpVertices[id1]; p2 = tmpVertices[id2]; p3 = tmpVertices[id3]; }
+			vec3 a(p2-p1), b(p3-p2), n(cross(a, b));
+			if (dot(n, (*normals)[id1]) < 0)
+				// reverse triangle order to correspond with vertex normal
+				return int3(id3, id2, id1);
+		}
+		return int3(id1, id2, id3);
+	}
+	void End() {
+		int nids = vids.size();
+		if (nids == 3)
+			triangles.push_back(Triangle(vids[0], vids[1], vids[2]));
+		else if (nids == 4 && quads)
+			quads->push_back(int4(vids[0], vids[1], vids[2], vids[3]));
+		else if (nids == 2 && segs)
+			segs->push_back(int2(vids[0], vids[1]));
+		else
+			// create polygon as nvids-2 triangles
+			for (int i = 1; i < nids-1; i++) {
+				triangles.push_back(int3(vids[0], vids[i], vids[(i+1)%nids]));
+			}
+		if (nids == 4 && !quads) nQuadsConvertedToTris++;
+	}
+	void Finish(vector<Group> *triangleGroups, vector<Mtl> *triangleMtls) {
+		if (nQuadsConvertedToTris) printf("(%i quads converted to triangles)\n", nQuadsConvertedToTris);
+		if (!hashedVertices && !hashedTriangles) {
+			points = std::move(tmpVertices);
+			if (normals)
+				*normals = std::move(tmpNormals);
+			if (textures)
+				*textures = std::move(tmpTextures);
+		}
+		if (triangleGroups) {
+			int nGroups = triangleGroups->size();
+			for (int i = 0; i < nGroups; i++) {
+				int next = i < nGroups-1? (*triangleGroups)[i+1].startTriangle : triangles.size();
+				(*triangleGroups)[i].nTriangles = next-(*triangleGroups)[i].startTriangle;
+			}
+		}
+		if (triangleMtls) {
+			int nMtls = triangleMtls->size();
+			for (int i = 0; i < nMtls; i++) {
+				int next = i < nMtls-1? (*triangleMtls)[i+1].startTriangle : triangles.size();
+				(*triangleMtls)[i].nTriangles = next-(*triangleMtls)[i].startTriangle;
+			}
+		}
+	}
+};
 
 bool ReadAsciiObj(const char      *filename,
 				  vector<vec3>    &points,
@@ -337,15 +1291,9 @@ bool ReadAsciiObj(const char      *filename,
 		return false;
 	vec2 t;
 	vec3 v;
-	int group = 0;
 	char line[LineLim], word[WordLim];
-	bool hashedTriangles = false;	// true if any triangle vertex specified with different point/normal/texture id
-	bool hashedVertices = false;	// true if point/normal/texture arrays different (non-zero) size
-	vector<vec3> tmpVertices, tmpNormals;
-	vector<vec2> tmpTextures;
-	VidMap vidMap;
+	ObjFaces faces(points, triangles, normals, textures, quads, segs);
 	MtlMap mtlMap;
-	int nQuadsConvertedToTris = 0;
 	for (int lineNum = 0;; lineNum++) {
 		line[0] = 0;
 		fgets(line, LineLim, in);                           // \ line continuation not supported
@@ -413,7 +1361,7 @@ bool ReadAsciiObj(const char      *filename,
 				printf("bad line %d in object file", lineNum);
 				return false;
 			}
-			tmpVertices.push_back(vec3(v.x, v.y, v.z));
+			faces.tmpVertices.push_back(vec3(v.x, v.y, v.z));
 		}
 		else if (!strcmp(word, "vn")) {                     // read vertex normal
 			nNlines++;
@@ -421,7 +1369,7 @@ bool ReadAsciiObj(const char      *filename,
 				printf("bad line %d in object file", lineNum);
 				return false;
 			}
-			tmpNormals.push_back(vec3(v.x, v.y, v.z));
+			faces.tmpNormals.push_back(vec3(v.x, v.y, v.z));
 		}
 		else if (!strcmp(word, "vt")) {                     // read vertex texture
 			nTlines++;
@@ -429,15 +1377,11 @@ bool ReadAsciiObj(const char      *filename,
 				printf("bad line in object file");
 				return false;
 			}
-			tmpTextures.push_back(vec2(t.x, t.y));
+			faces.tmpTextures.push_back(vec2(t.x, t.y));
 		}
 		else if (!strcmp(word, "f")) {                      // read triangle or polygon
 			nFlines++;
-			size_t nvids = tmpVertices.size(), ntids = tmpTextures.size(), nnids = tmpNormals.size();
-			if ((ntids && ntids != nvids) || (nnids && nnids != nvids))
-				hashedVertices = true;
-			static vector<int> vids;
-			vids.resize(0);
+			faces.Begin();
 			while (ReadWord(ptr, word, WordLim)) {          // read arbitrary # face vid/tid/nid
 				// set texture and normal pointers to preceding /
 				char *tPtr = strchr(word+1, '/');           // pointer to /, or null if not found
@@ -457,70 +1401,9 @@ bool ReadAsciiObj(const char      *filename,
 					printf("bad format on line %d\n", lineNum);
 					break;
 				}
-				if ((tid >= 0 && tid != vid) || (nid >= 0 && nid != vid))
-					hashedTriangles = true;
-				bool hashed = hashedVertices || hashedTriangles;
-				if (!hashedVertices && !hashedTriangles) {
-					vids.push_back(vid);
-				}
-				if (hashedVertices || hashedTriangles) {
-					int3 key(vid, tid, nid);
-					VidMap::iterator it = vidMap.find(key);
-					// following can fail on early vertices
-					// to support OBJ must support triangle vid1/tid1/nid1, vid2/tid2/nid2, vid3/tid3/nid3
-					// which would mean changing current implementation
-					// instead, test for hashed vertices (ie, has vid ever not equaled tid or nid?)
-					// but we add specific test for simple impl
-					// need a straightforward implementation for when
-					// vid=tid=nid and/or there is no tid, no nid
-					// printf("incoming vid = %i, ", vid);
-					if (it == vidMap.end()) {
-						size_t nvrts = points.size();
-						vidMap[key] = nvrts;
-						points.push_back(tmpVertices[vid]); // *** suspect
-						if (normals && (int) tmpNormals.size() > nid)
-							normals->push_back(tmpNormals[nid]);
-						if (textures && (int) tmpTextures.size() > tid)
-							textures->push_back(tmpTextures[tid]);
-						vids.push_back(nvrts);
-						// printf("pushed %i\n", nvrts);
-					}
-					else {
-						vids.push_back(it->second);
-						// printf("pushed second = %i\n", it->second);
-					}
-				}
+				faces.Add(vid, tid, nid);
 			}
-			int nids = vids.size();
-			if (nids == 3) {
-				int id1 = vids[0], id2 = vids[1], id3 = vids[2];
-				if (normals && (int) normals->size() > id1) {
-					vec3 p1, p2, p3;
-					if (hashedVertices || hashedTriangles) { p1 = points[id1]; p2 = points[id2]; p3 = points[id3]; }
-					else { p1 = tmpVertices[id1]; p2 = tmpVertices[id2]; p3 = tmpVertices[id3]; }
-					vec3 a(p2-p1), b(p3-p2), n(cross(a, b));
-					if (dot(n, (*normals)[id1]) < 0) {
-						// reverse triangle order to correspond with vertex normal
-						int tmp = id1;
-						id1 = id3;
-						id3 = tmp;
-					}
-				}
-				// create triangle
-				int3 id(id1, id2, id3);
-				triangles.push_back(id);
-				// printf("triangle[%i] = (%i, %i, %i)\n", triangles.size()-1, id1+1, id2+1, id3+1);
-			}
-			else if (nids == 4 && quads)
-				quads->push_back(int4(vids[0], vids[1], vids[2], vids[3]));
-			else if (nids == 2 && segs)
-				segs->push_back(int2(vids[0], vids[1]));
-			else
-				// create polygon as nvids-2 triangles
-				for (int i = 1; i < nids-1; i++) {
-					triangles.push_back(int3(vids[0], vids[i], vids[(i+1)%nids]));
-				}
-			if (nids == 4 && !quads) nQuadsConvertedToTris++;
+			faces.End();
 		} // end "f"
 		else if (*word == 0 || *word == '\n')               // skip blank line
 			continue;
@@ -529,103 +1412,2588 @@ bool ReadAsciiObj(const char      *filename,
 			continue; // return false;
 		}
 	} // end read til end of file
-	if (nQuadsConvertedToTris) printf("(%i quads converted to triangles)\n", nQuadsConvertedToTris);
-//	printf("hashedVertices = %s, hashedTriangles = %s\n", hashedVertices? "true" : "false", hashedTriangles? "true" : "false");
-	if (!hashedVertices && !hashedTriangles) {
-		int nPoints = tmpVertices.size();
-		points.resize(nPoints);
-		for (int i = 0; i < nPoints; i++)
-			points[i] = tmpVertices[i];
-		if (normals) {
-			int nNormals = tmpNormals.size();
-			normals->resize(nNormals);
-			for (int i = 0; i < nNormals; i++)
-				(*normals)[i] = tmpNormals[i];
-		}
-		if (textures) {
-			int nTextures = tmpTextures.size();
-			textures->resize(nTextures);
-			for (int i = 0; i < nTextures; i++)
-				(*textures)[i] = tmpTextures[i];
-		}
-	}
-	if (triangleGroups) {
-		int nGroups = triangleGroups->size();
-		for (int i = 0; i < nGroups; i++) {
-			int next = i < nGroups-1? (*triangleGroups)[i+1].startTriangle : triangles.size();
-			(*triangleGroups)[i].nTriangles = next-(*triangleGroups)[i].startTriangle;
-		}
-	}
-	if (triangleMtls) {
-		int nMtls = triangleMtls->size();
-		for (int i = 0; i < nMtls; i++) {
-			int next = i < nMtls-1? (*triangleMtls)[i+1].startTriangle : triangles.size();
-			(*triangleMtls)[i].nTriangles = next-(*triangleMtls)[i].startTriangle;
-		}
-	}
+	fclose(in);
+	faces.Finish(triangleGroups, triangleMtls);
 //	printf("%i vlines, %i nlines, %i tlines, %i flines\n", nVlines, nNlines, nTlines, nFlines);
 	return true;
 } // end ReadAsciiObj
 
-bool WriteAsciiObj(const char    *filename,
-				   vector<vec3>  &points,
-				   vector<vec3>  &normals,
-				   vector<vec2>  &uvs,
-				   vector<int3>  *triangles,
-				   vector<int4>  *quads,
-				   vector<int2>  *segs,
-				   vector<Group> *triangleGroups) {
-	FILE *file = fopen(filename, "w");
-	if (!file) {
-		printf("can't write %s\n", filename);
+// Memory-mapped OBJ: lines and words are scanned in place, without per-line copies
+
+namespace {
+
+inline bool IsBlank(char c) { return c == ' ' || c == '\t'; }					// ReadWord delimiters
+inline bool IsSpace(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }	// as skipped by sscanf, atoi
+inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+bool NextWord(const char *&ptr, const char *end, const char *&word) {
+	// as ReadWord: on return, word is start of next non-white-space run and ptr is its end
+	while (ptr < end && IsBlank(*ptr))
+		ptr++;
+	word = ptr;
+	while (ptr < end && !IsBlank(*ptr))
+		ptr++;
+	return ptr > word;
+}
+
+bool Keyword(const char *word, const char *end, const char *key) {
+	// case-insensitive comparison of [word, end) with key
+	for (; word < end && *key; word++, key++)
+		if ((*word | 0x20) != *key)
+			return false;
+	return word == end && !*key;
+}
+
+int AtoI(const char *c, const char *end) {
+	// as atoi, limited to [c, end)
+	while (c < end && IsSpace(*c))
+		c++;
+	bool negative = c < end && *c == '-';
+	if (c < end && (*c == '-' || *c == '+'))
+		c++;
+	unsigned int n = 0;
+	for (; c < end && IsDigit(*c); c++)
+		n = 10*n+(*c-'0');
+	return negative? -(int) n : (int) n;
+}
+
+bool ScanFloat(const char *&ptr, const char *end, float &f) {
+	// slow path: sscanf a null-terminated copy of the rest of the line
+	char buf[LineLim];
+	size_t nChars = end-ptr < LineLim-1? end-ptr : LineLim-1;
+	memcpy(buf, ptr, nChars);
+	buf[nChars] = 0;
+	int nRead = 0;
+	if (sscanf(buf, "%g%n", &f, &nRead) != 1)
 		return false;
-	}
+	ptr += nRead;
+	return true;
+}
+
+bool ParseFloat(const char *&ptr, const char *end, float &f) {
+	// equivalent to sscanf %g: skip white space, read float, advance ptr
+	// decimal mantissas of up to 19 digits are accumulated as integers; if the mantissa fits a double and the
+	// exponent is within 22, the double quotient/product is correctly rounded (Clinger's fast path) and so is
+	// its conversion to float, unless the double lies on a float rounding midpoint; anything else is scanned
+	static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+								   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+	while (ptr < end && IsSpace(*ptr))
+		ptr++;
+	const char *c = ptr;
+	bool negative = c < end && *c == '-';
+	if (c < end && (*c == '-' || *c == '+'))
+		c++;
+	unsigned long long mantissa = 0;
+	int nDigits = 0, nSignificant = 0, exponent = 0;
+	for (; c < end && IsDigit(*c); c++, nDigits++)
+		if (mantissa || *c != '0') {
+			mantissa = 10*mantissa+(*c-'0');
+			nSignificant++;
+		}
+	if (c < end && *c == '.')
+		for (c++; c < end && IsDigit(*c); c++, nDigits++, exponent--)
+			if (mantissa || *c != '0') {
+				mantissa = 10*mantissa+(*c-'0');
+				nSignificant++;
+			}
+	if (!nDigits || nSignificant > 19)
+		return ScanFloat(ptr, end, f);
+	if (c < end && (*c == 'e' || *c == 'E')) {
+		const char *e = c+1;
+		bool negativeExponent = e < end && *e == '-';
+		if (e < end && (*e == '-' || *e == '+'))
+			e++;
+		if (e == end || !IsDigit(*e))
+			return ScanFloat(ptr, end, f);
+		int x = 0;
+		for (; e < end && IsDigit(*e); e++)
+			if (x < 10000)
+				x = 10*x+(*e-'0');
+		exponent += negativeExponent? -x : x;
+		c = e;
+	}
+	if (c < end && !IsSpace(*c))							// eg, hexadecimal, inf, nan
+		return ScanFloat(ptr, end, f);
+	double d = 0;
+	if (mantissa) {
+		if (mantissa >= (1ull << 53) || exponent < -22 || exponent > 22)
+			return ScanFloat(ptr, end, f);
+		d = exponent < 0? (double) mantissa/pow10[-exponent] : (double) mantissa*pow10[exponent];
+		unsigned long long bits;
+		memcpy(&bits, &d, sizeof(d));
+		if ((bits & 0x1fffffff) == 0x10000000)				// low 29 bits halfway between floats
+			return ScanFloat(ptr, end, f);
+	}
+	f = (float) (negative? -d : d);
+	ptr = c;
+	return true;
+}
+
+enum ObjError { ObjLineTooLong, ObjBadVertex, ObjBadTexture, ObjBadFace };
+
+void PrintObjError(ObjError e, int lineNum) {
+	if (e == ObjLineTooLong) printf("line %d too long\n", lineNum);
+	if (e == ObjBadVertex) printf("bad line %d in object file", lineNum);
+	if (e == ObjBadTexture) printf("bad line in object file");
+	if (e == ObjBadFace) printf("bad format on line %d\n", lineNum);
+}
+
+string Word(const char *word, const char *end) {
+	// as copied by ReadWord (limited to WordLim-1 characters)
+	return string(word, end-word < WordLim-1? end : word+WordLim-1);
+}
+
+template<class Sink> int ParseObj(const char *data, const char *end, Sink &sink) {
+	// scan lines in [data, end), report their contents to sink
+	// return # lines scanned, or -1 if a fatal error (reported to sink)
+	// as with ReadAsciiObj, a final line not terminated by newline is ignored, unless too long (also an error there)
+	const char *eol = NULL;
+	int lineNum = 0;
+	for (; data < end; lineNum++, data = eol+1) {
+		eol = (const char *) memchr(data, '\n', end-data);
+		if (!eol) {
+			// final, unterminated line: ReadAsciiObj's fgets fills its buffer (LineLim-1 chars) before reaching EOF
+			if ((size_t) (end-data) >= LineLim-1) {
+				sink.Error(ObjLineTooLong, lineNum);
+				return -1;
+			}
+			break;
+		}
+		if ((size_t) (eol-data+1) >= LineLim-1) {
+			sink.Error(ObjLineTooLong, lineNum);
+			return -1;
+		}
+		const char *ptr = data, *word;
+		if (!NextWord(ptr, eol, word) || *word == '#')
+			continue;
+		const char *wordEnd = ptr;
+		if (Keyword(word, wordEnd, "v")) {
+			vec3 v;
+			if (!ParseFloat(ptr, eol, v.x) || !ParseFloat(ptr, eol, v.y) || !ParseFloat(ptr, eol, v.z)) {
+				sink.Error(ObjBadVertex, lineNum);
+				return -1;
+			}
+			sink.Vertex(v);
+		}
+		else if (Keyword(word, wordEnd, "f")) {
+			sink.BeginFace();
+			while (NextWord(ptr, eol, word)) {
+				const char *w = word, *we = ptr-word < WordLim-1? ptr : word+WordLim-1;
+				int vid = AtoI(w, we);
+				if (!vid)
+					break;
+				const char *tPtr = (const char *) memchr(w+1, '/', we-w-1);
+				const char *nPtr = tPtr? (const char *) memchr(tPtr+1, '/', we-tPtr-1) : NULL;
+				int tid = tPtr && (tPtr+1 == we || tPtr[1] != '/')? AtoI(tPtr+1, we) : vid;
+				int nid = nPtr && nPtr+1 < we? AtoI(nPtr+1, we) : vid;
+				vid--;
+				tid--;
+				nid--;
+				if (vid < 0 || tid < 0 || nid < 0) {
+					sink.Error(ObjBadFace, lineNum);
+					break;
+				}
+				sink.Corner(vid, tid, nid);
+			}
+			sink.EndFace();
+		}
+		else if (Keyword(word, wordEnd, "vn")) {
+			vec3 n;
+			if (!ParseFloat(ptr, eol, n.x) || !ParseFloat(ptr, eol, n.y) || !ParseFloat(ptr, eol, n.z)) {
+				sink.Error(ObjBadVertex, lineNum);
+				return -1;
+			}
+			sink.Normal(n);
+		}
+		else if (Keyword(word, wordEnd, "vt")) {
+			vec2 t;
+			if (!ParseFloat(ptr, eol, t.x) || !ParseFloat(ptr, eol, t.y)) {
+				sink.Error(ObjBadTexture, lineNum);
+				return -1;
+			}
+			sink.Texture(t);
+		}
+		else if (Keyword(word, wordEnd, "g")) {
+			const char *s = (const char *) memchr(ptr, '(', eol-ptr);
+			sink.AddGroup(string(ptr, s? s : eol));
+		}
+		else if (Keyword(word, wordEnd, "usemtl")) {
+			if (NextWord(ptr, eol, word))
+				sink.UseMtl(Word(word, ptr));
+		}
+		else if (Keyword(word, wordEnd, "mtllib")) {
+			if (NextWord(ptr, eol, word))
+				sink.MtlLib(Word(word, ptr));
+		}
+	}
+	return lineNum;
+}
+
+class ObjSink {
+	// send parsed lines directly to face assembly, groups and materials
+public:
+	ObjFaces &faces;
+	vector<Group> *triangleGroups;
+	vector<Mtl> *triangleMtls;
+	const char *filename;
+	MtlMap mtlMap;
+	vector<string> *mtlLibs = NULL;	// if non-null, append path of each material file read
+	int lineOffset = 0;				// # lines preceding those being parsed
+	ObjSink(ObjFaces &faces, vector<Group> *triangleGroups, vector<Mtl> *triangleMtls, const char *filename) :
+		faces(faces), triangleGroups(triangleGroups), triangleMtls(triangleMtls), filename(filename) { }
+	void Vertex(const vec3 &v) { faces.tmpVertices.push_back(v); }
+	void Normal(const vec3 &n) { faces.tmpNormals.push_back(n); }
+	void Texture(const vec2 &t) { faces.tmpTextures.push_back(t); }
+	void BeginFace() { faces.Begin(); }
+	void Corner(int vid, int tid, int nid) { faces.Add(vid, tid, nid); }
+	void EndFace() { faces.End(); }
+	void AddGroup(const string &name) { AddGroup(name, faces.triangles.size()); }
+	void AddGroup(const string &name, int startTriangle) {
+		if (triangleGroups)
+			triangleGroups->push_back(Group(startTriangle, name));
+	}
+	void UseMtl(const string &name) { UseMtl(name, faces.triangles.size()); }
+	void UseMtl(const string &name, int startTriangle) {
+		MtlMap::iterator it = mtlMap.find(name);
+		if (it != mtlMap.end() && triangleMtls) {
+			Mtl m = it->second;
+			m.startTriangle = startTriangle;
+			triangleMtls->push_back(m);
+		}
+	}
+	void MtlLib(const string &name) {
+		// material file is relative to directory of object file
+		const char *p = strrchr(filename, '/');
+		string path = p? string(filename, p+1)+name : name;
+		mtlMap = ReadMaterial(path.c_str());
+		if (mtlLibs)
+			mtlLibs->push_back(path);
+	}
+	void Error(ObjError e, int lineNum) { PrintObjError(e, lineOffset+lineNum); }
+};
+
+class ObjChunk {
+	// a line-aligned section of an OBJ file, parsed independently of other chunks
+	// vertex indices are global (as in file), vertex counts are local to chunk
+public:
+	enum EventType { GroupEvent, UseMtlEvent, MtlLibEvent, ErrorEvent };
+	struct Face { int nCorners, nVertices, nTextures, nNormals; };
+	struct Event {
+		EventType type;
+		int face = 0;				// # faces begun before event
+		int lineNum = 0;			// for ErrorEvent, local to chunk
+		ObjError error = ObjBadFace;
+		int startTriangle = 0;		// for GroupEvent, UseMtlEvent, when triangles emitted in parallel
+		string name;
+		Event(EventType type, int face, string name = "") : type(type), face(face), name(name) { }
+	};
+	const char *begin = NULL, *end = NULL;
+	int nLines = 0;					// -1 if fatal error
+	bool hashedCorners = false;		// true if any face corner has tid or nid different from vid
+	vector<vec3> vertices, normals;
+	vector<vec2> textures;
+	vector<int3> corners;			// vid, tid, nid
+	vector<Face> faces;
+	vector<Event> events;
+	void Parse() { nLines = ParseObj(begin, end, *this); }
+	// parse sink
+	void Vertex(const vec3 &v) { vertices.push_back(v); }
+	void Normal(const vec3 &n) { normals.push_back(n); }
+	void Texture(const vec2 &t) { textures.push_back(t); }
+	void BeginFace() {
+		Face f = {0, (int) vertices.size(), (int) textures.size(), (int) normals.size()};
+		faces.push_back(f);
+	}
+	void Corner(int vid, int tid, int nid) {
+		corners.push_back(int3(vid, tid, nid));
+		faces.back().nCorners++;
+		if (tid != vid || nid != vid)
+			hashedCorners = true;
+	}
+	void EndFace() { }
+	void AddGroup(const string &name) { events.push_back(Event(GroupEvent, faces.size(), name)); }
+	void UseMtl(const string &name) { events.push_back(Event(UseMtlEvent, faces.size(), name)); }
+	void MtlLib(const string &name) { events.push_back(Event(MtlLibEvent, faces.size(), name)); }
+	void Error(ObjError e, int lineNum) {
+		events.push_back(Event(ErrorEvent, faces.size()));
+		events.back().lineNum = lineNum;
+		events.back().error = e;
+	}
+};
+
+void ApplyEvent(ObjChunk::Event &e, ObjSink &sink, int lineOffset, bool emitted) {
+	// emitted true if triangles already in place (startTriangle valid)
+	int start = emitted? e.startTriangle : sink.faces.triangles.size();
+	if (e.type == ObjChunk::GroupEvent) sink.AddGroup(e.name, start);
+	if (e.type == ObjChunk::UseMtlEvent) sink.UseMtl(e.name, start);
+	if (e.type == ObjChunk::MtlLibEvent) sink.MtlLib(e.name);
+	if (e.type == ObjChunk::ErrorEvent) sink.Error(e.error, lineOffset+e.lineNum);
+}
+
+void Replay(ObjChunk &c, ObjSink &sink, size_t vOffset, size_t tOffset, size_t nOffset, int lineOffset) {
+	// serially assemble faces of chunk, as if parsed by ObjSink
+	ObjFaces &faces = sink.faces;
+	size_t e = 0, corner = 0;
+	for (size_t f = 0; f < c.faces.size(); f++) {
+		for (; e < c.events.size() && c.events[e].face <= (int) f; e++)
+			ApplyEvent(c.events[e], sink, lineOffset, false);
+		ObjChunk::Face &face = c.faces[f];
+		faces.Begin(vOffset+face.nVertices, tOffset+face.nTextures, nOffset+face.nNormals);
+		for (int k = 0; k < face.nCorners; k++, corner++)
+			faces.Add(c.corners[corner].i1, c.corners[corner].i2, c.corners[corner].i3);
+		faces.End();
+	}
+	for (; e < c.events.size(); e++)
+		ApplyEvent(c.events[e], sink, lineOffset, false);
+}
+
+} // end namespace
+
+bool ReadAsciiObjMapped(const char      *filename,
+						vector<vec3>    &points,
+						vector<int3>    &triangles,
+						vector<vec3>    *normals,
+						vector<vec2>    *textures,
+						vector<Group>   *triangleGroups,
+						vector<Mtl>     *triangleMtls,
+						vector<int4>    *quads,
+						vector<int2>    *segs) {
+	return ReadAsciiObjParallel(filename, points, triangles, normals, textures, triangleGroups, triangleMtls, quads, segs, 1);
+}
+
+bool ReadAsciiObjParallel(const char      *filename,
+						  vector<vec3>    &points,
+						  vector<int3>    &triangles,
+						  vector<vec3>    *normals,
+						  vector<vec2>    *textures,
+						  vector<Group>   *triangleGroups,
+						  vector<Mtl>     *triangleMtls,
+						  vector<int4>    *quads,
+						  vector<int2>    *segs,
+						  int              nThreads,
+						  vector<string>  *mtlLibs) {
+	// chunks are parsed concurrently, then merged in file order: vertex arrays are concatenated and,
+	// unless vertices must be hashed (which depends on file order), faces are emitted concurrently
+	MappedFile file;
+	if (!file.Open(filename))
+		return false;
+	const char *data = file.data, *end = data+file.size;
+	const size_t minChunkSize = 1 << 20;
+	nThreads = NumThreads(nThreads);
+	int nChunks = nThreads < 2? 1 : (int) (file.size/minChunkSize < (size_t) 4*nThreads? file.size/minChunkSize+1 : 4*nThreads);
+	ObjFaces faces(points, triangles, normals, textures, quads, segs);
+	ObjSink sink(faces, triangleGroups, triangleMtls, filename);
+	sink.mtlLibs = mtlLibs;
+	if (mtlLibs)
+		mtlLibs->resize(0);
+	if (nChunks == 1) {
+		// pre-size arrays from line counts
+		size_t nVlines = 0, nNlines = 0, nTlines = 0, nFlines = 0;
+		for (const char *c = data; c < end; c++) {
+			if (*c == 'v' && c+1 < end)
+				c[1] == 'n'? nNlines++ : c[1] == 't'? nTlines++ : nVlines++;
+			if (*c == 'f')
+				nFlines++;
+			c = (const char *) memchr(c, '\n', end-c);
+			if (!c)
+				break;
+		}
+		faces.tmpVertices.reserve(nVlines);
+		faces.tmpNormals.reserve(nNlines);
+		faces.tmpTextures.reserve(nTlines);
+		triangles.reserve(triangles.size()+nFlines);
+		faces.nExpectedVertices = std::max(nVlines, std::max(nNlines, nTlines));
+		if (ParseObj(data, end, sink) < 0)
+			return false;
+		faces.Finish(triangleGroups, triangleMtls);
+		return true;
+	}
+	// split file at line boundaries, parse
+	vector<ObjChunk> chunks(nChunks);
+	for (int i = 0; i < nChunks; i++) {
+		const char *b = i? chunks[i-1].end : data, *e = data+file.size*(i+1)/nChunks;
+		if (e < b) e = b;
+		const char *eol = i < nChunks-1? (const char *) memchr(e, '\n', end-e) : NULL;
+		chunks[i].begin = b;
+		chunks[i].end = eol? eol+1 : end;
+	}
+	ParallelFor(nChunks, [&](int i) { chunks[i].Parse(); }, nThreads);
+	// offsets of chunk vertices, lines
+	vector<size_t> vOffsets(nChunks+1, 0), tOffsets(nChunks+1, 0), nOffsets(nChunks+1, 0);
+	vector<int> lineOffsets(nChunks+1, 0);
+	bool fatal = false, hashed = false;
+	for (int i = 0; i < nChunks; i++) {
+		ObjChunk &c = chunks[i];
+		vOffsets[i+1] = vOffsets[i]+c.vertices.size();
+		tOffsets[i+1] = tOffsets[i]+c.textures.size();
+		nOffsets[i+1] = nOffsets[i]+c.normals.size();
+		lineOffsets[i+1] = lineOffsets[i]+(c.nLines > 0? c.nLines : 0);
+		fatal = fatal || c.nLines < 0;
+		hashed = hashed || c.hashedCorners;
+	}
+	// concatenate vertices
+	faces.tmpVertices.resize(vOffsets[nChunks]);
+	faces.tmpTextures.resize(tOffsets[nChunks]);
+	faces.tmpNormals.resize(nOffsets[nChunks]);
+	faces.nExpectedVertices = std::max(vOffsets[nChunks], std::max(tOffsets[nChunks], nOffsets[nChunks]));
+	ParallelFor(nChunks, [&](int i) {
+		ObjChunk &c = chunks[i];
+		if (c.vertices.size()) memcpy(&faces.tmpVertices[vOffsets[i]], c.vertices.data(), c.vertices.size()*sizeof(vec3));
+		if (c.textures.size()) memcpy(&faces.tmpTextures[tOffsets[i]], c.textures.data(), c.textures.size()*sizeof(vec2));
+		if (c.normals.size()) memcpy(&faces.tmpNormals[nOffsets[i]], c.normals.data(), c.normals.size()*sizeof(vec3));
+	}, nThreads);
+	// count faces output per chunk; test whether any face would start vertex hashing
+	struct Count { size_t nTriangles, nQuads, nSegs; int nConverted; } zero = {0, 0, 0, 0};
+	vector<Count> counts(nChunks+1, zero);
+	if (!fatal && !hashed)
+		ParallelFor(nChunks, [&](int i) {
+			ObjChunk &c = chunks[i];
+			Count &n = counts[i+1];
+			for (size_t f = 0; f < c.faces.size(); f++) {
+				ObjChunk::Face &face = c.faces[f];
+				if (ObjFaces::HashedVertices(vOffsets[i]+face.nVertices, tOffsets[i]+face.nTextures, nOffsets[i]+face.nNormals)) {
+					c.hashedCorners = true;
+					break;
+				}
+				int nids = face.nCorners;
+				if (nids == 4 && quads) n.nQuads++;
+				else if (nids == 2 && segs) n.nSegs++;
+				else if (nids >= 3) n.nTriangles += nids-2;
+				if (nids == 4 && !quads) n.nConverted++;
+			}
+		}, nThreads);
+	for (int i = 0; i < nChunks; i++)
+		hashed = hashed || chunks[i].hashedCorners;
+	if (fatal || hashed) {
+		// serial assembly, stopping at first fatal error
+		for (int i = 0; i < nChunks; i++) {
+			Replay(chunks[i], sink, vOffsets[i], tOffsets[i], nOffsets[i], lineOffsets[i]);
+			if (chunks[i].nLines < 0)
+				return false;
+		}
+		faces.Finish(triangleGroups, triangleMtls);
+		return true;
+	}
+	// emit triangles, quads, segs concurrently
+	for (int i = 0; i < nChunks; i++) {
+		counts[i+1].nTriangles += counts[i].nTriangles;
+		counts[i+1].nQuads += counts[i].nQuads;
+		counts[i+1].nSegs += counts[i].nSegs;
+		faces.nQuadsConvertedToTris += counts[i+1].nConverted;
+	}
+	size_t triangleBase = triangles.size(), quadBase = quads? quads->size() : 0, segBase = segs? segs->size() : 0;
+	triangles.resize(triangleBase+counts[nChunks].nTriangles);
+	if (quads) quads->resize(quadBase+counts[nChunks].nQuads);
+	if (segs) segs->resize(segBase+counts[nChunks].nSegs);
+	ParallelFor(nChunks, [&](int i) {
+		ObjChunk &c = chunks[i];
+		int3 *t = triangles.data()+triangleBase+counts[i].nTriangles;
+		int4 *q = quads? quads->data()+quadBase+counts[i].nQuads : NULL;
+		int2 *s = segs? segs->data()+segBase+counts[i].nSegs : NULL;
+		size_t e = 0;
+		const int3 *corner = c.corners.data();
+		for (size_t f = 0; f <= c.faces.size(); f++) {
+			for (; e < c.events.size() && c.events[e].face <= (int) f; e++)
+				c.events[e].startTriangle = (int) (t-triangles.data());
+			if (f == c.faces.size())
+				break;
+			int nids = c.faces[f].nCorners;
+			const int3 *v = corner;
+			if (nids == 3)
+				*t++ = faces.Triangle(v[0].i1, v[1].i1, v[2].i1);
+			else if (nids == 4 && quads)
+				*q++ = int4(v[0].i1, v[1].i1, v[2].i1, v[3].i1);
+			else if (nids == 2 && segs)
+				*s++ = int2(v[0].i1, v[1].i1);
+			else
+				for (int k = 1; k < nids-1; k++)
+					*t++ = int3(v[0].i1, v[k].i1, v[(k+1)%nids].i1);
+			corner += nids;
+		}
+	}, nThreads);
+	// groups, materials, messages in file order
+	for (int i = 0; i < nChunks; i++)
+		for (size_t e = 0; e < chunks[i].events.size(); e++)
+			ApplyEvent(chunks[i].events[e], sink, lineOffsets[i], true);
+	faces.Finish(triangleGroups, triangleMtls);
+	return true;
+} // end ReadAsciiObjParallel
+
+// Incremental OBJ reading
+
+struct ObjReader::State {
+	MappedFile file;
+	string filename;
+	ObjFaces faces;
+	ObjSink sink;
+	vector<Group> *triangleGroups;
+	vector<Mtl> *triangleMtls;
+	size_t pos = 0;
+	bool done = false;
+	State(const char *name, vector<vec3> &points, vector<int3> &triangles, vector<vec3> *normals, vector<vec2> *textures,
+		  vector<Group> *triangleGroups, vector<Mtl> *triangleMtls, vector<int4> *quads, vector<int2> *segs) :
+		filename(name), faces(points, triangles, normals, textures, quads, segs),
+		sink(faces, triangleGroups, triangleMtls, filename.c_str()), triangleGroups(triangleGroups), triangleMtls(triangleMtls) { }
+};
+
+bool ObjReader::Open(const char    *filename,
+					 vector<vec3>  &points,
+					 vector<int3>  &triangles,
+					 vector<vec3>  *normals,
+					 vector<vec2>  *textures,
+					 vector<Group> *triangleGroups,
+					 vector<Mtl>   *triangleMtls,
+					 vector<int4>  *quads,
+					 vector<int2>  *segs) {
+	Close();
+	state = new State(filename, points, triangles, normals, textures, triangleGroups, triangleMtls, quads, segs);
+	if (!state->file.Open(filename)) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool ObjReader::Read(size_t nBytes) {
+	if (!state || state->done)
+		return state != NULL;
+	const char *data = state->file.data, *end = data+state->file.size, *start = data+state->pos;
+	// extend to end of line
+	const char *stop = nBytes < (size_t) (end-start)? start+nBytes : end;
+	const char *eol = stop > start && stop < end? (const char *) memchr(stop-1, '\n', end-stop+1) : NULL;
+	stop = eol? eol+1 : end;
+	int nLines = ParseObj(start, stop, state->sink);
+	if (nLines < 0) {
+		state->done = true;
+		return false;
+	}
+	state->sink.lineOffset += nLines;
+	state->pos = stop-data;
+	if (stop == end) {
+		state->faces.Finish(state->triangleGroups, state->triangleMtls);
+		state->done = true;
+	}
+	return true;
+}
+
+bool ObjReader::Done() const { return !state || state->done; }
+
+float ObjReader::Progress() const {
+	return !state || state->done || !state->file.size? 1.f : (float) state->pos/state->file.size;
+}
+
+const vector<vec3> &ObjReader::Vertices() const {
+	ObjFaces &f = state->faces;
+	return state->done || f.hashedVertices || f.hashedTriangles? f.points : f.tmpVertices;
+}
+
+const vector<vec3> &ObjReader::Normals() const {
+	static vector<vec3> none;
+	ObjFaces &f = state->faces;
+	return state->done || f.hashedVertices || f.hashedTriangles? (f.normals? *f.normals : none) : f.tmpNormals;
+}
+
+void ObjReader::Close() {
+	delete state;
+	state = NULL;
+}
+
+namespace {
+
+char *PutFloat(char *c, float f) {
+	// space, then fewest significant digits (6 to 9) that read back as f
+	*c++ = ' ';
+	int n = 0;
+	for (int digits = 6; digits <= 9; digits++) {
+		n = snprintf(c, 24, "%.*g", digits, f);
+		if (strtof(c, NULL) == f || f != f)
+			break;
+	}
+	return c+n;
+}
+
+char *PutInt(char *c, int i) {
+	*c++ = ' ';
+	char tmp[12], *t = tmp;
+	unsigned u = i < 0? 0u-(unsigned) i : (unsigned) i;
+	do
+		*t++ = (char) ('0'+u%10);
+	while (u /= 10);
+	if (i < 0)
+		*c++ = '-';
+	while (t > tmp)
+		*c++ = *--t;
+	return c;
+}
+
+template<class Format> bool WriteLines(FILE *file, size_t begin, size_t end, int nThreads, Format format) {
+	// format(i, c) writes line i at c (at most 96 chars), returns end of line
+	// blocks of lines are formatted concurrently, then written in order
+	const size_t blockSize = 1 << 15, maxLineChars = 96;
+	int nBatch = 4*NumThreads(nThreads);
+	vector<vector<char>> bufs(nBatch);
+	vector<size_t> sizes(nBatch);
+	bool ok = true;
+	for (size_t batchBegin = begin; batchBegin < end; batchBegin += nBatch*blockSize) {
+		int nBlocks = (int) ((end-batchBegin+blockSize-1)/blockSize);
+		if (nBlocks > nBatch)
+			nBlocks = nBatch;
+		ParallelFor(nBlocks, [&](int k) {
+			size_t b = batchBegin+k*blockSize, e = b+blockSize < end? b+blockSize : end;
+			bufs[k].resize((e-b)*maxLineChars);
+			char *c = bufs[k].data();
+			for (size_t i = b; i < e; i++)
+				c = format(i, c);
+			sizes[k] = c-bufs[k].data();
+		}, nThreads);
+		for (int k = 0; k < nBlocks; k++)
+			ok = ok && fwrite(bufs[k].data(), 1, sizes[k], file) == sizes[k];
+	}
+	return ok;
+}
+
+} // end namespace
+
+bool WriteAsciiObj(const char    *filename,
+				   vector<vec3>  &points,
+				   vector<vec3>  &normals,
+				   vector<vec2>  &uvs,
+				   vector<int3>  *triangles,
+				   vector<int4>  *quads,
+				   vector<int2>  *segs,
+				   vector<Group> *triangleGroups,
+				   int            nThreads) {
+	FILE *file = fopen(filename, "w");
+	if (!file) {
+		printf("can't write %s\n", filename);
+		return false;
+	}
+	setvbuf(file, NULL, _IOFBF, 1 << 20);
 	int nPoints = points.size(), nNormals = normals.size(), nUvs = uvs.size(), nTriangles = triangles? triangles->size() : 0;
+	bool ok = true;
+	auto Vec3Line = [](const char *key, const vec3 &v, char *c) {
+		while (*key)
+			*c++ = *key++;
+		c = PutFloat(PutFloat(PutFloat(c, v.x), v.y), v.z);
+		*c++ = '\n';
+		return c;
+	};
+	auto TriangleLine = [&](size_t i, char *c) {
+		int3 &t = (*triangles)[i];
+		*c++ = 'f';
+		c = PutInt(PutInt(PutInt(c, 1+t.i1), 1+t.i2), 1+t.i3);
+		*c++ = '\n';
+		return c;
+	};
 	if (nPoints) {
 		fprintf(file, "# %i vertices\n", nPoints);
-		for (int i = 0; i < nPoints; i++)
-			fprintf(file, "v %f %f %f \n", points[i].x, points[i].y, points[i].z);
+		ok = ok && WriteLines(file, 0, nPoints, nThreads, [&](size_t i, char *c) { return Vec3Line("v", points[i], c); });
 		fprintf(file, "\n");
 	}
 	if (nNormals) {
 		fprintf(file, "# %i normals\n", nNormals);
-		for (int i = 0; i < nNormals; i++)
-			fprintf(file, "vn %f %f %f \n", normals[i].x, normals[i].y, normals[i].z);
+		ok = ok && WriteLines(file, 0, nNormals, nThreads, [&](size_t i, char *c) { return Vec3Line("vn", normals[i], c); });
 		fprintf(file, "\n");
 	}
 	if (nUvs) {
 		fprintf(file, "# %i textures\n", nUvs);
-		for (int i = 0; i < nUvs; i++)
-			fprintf(file, "vt %f %f \n", uvs[i].x, uvs[i].y);
+		ok = ok && WriteLines(file, 0, nUvs, nThreads, [&](size_t i, char *c) {
+			*c++ = 'v';
+			*c++ = 't';
+			c = PutFloat(PutFloat(c, uvs[i].x), uvs[i].y);
+			*c++ = '\n';
+			return c;
+		});
 		fprintf(file, "\n");
 	}
 	// write triangles, quads (adding 1 to all vertex indices per OBJ format)
 	if (triangles) {
 		// non-grouped triangles
-		size_t nNonGrouped = triangleGroups && triangleGroups->size()? (*triangleGroups)[0].startTriangle : nTriangles; 
+		size_t nNonGrouped = triangleGroups && triangleGroups->size()? (*triangleGroups)[0].startTriangle : nTriangles;
 		if (nTriangles) fprintf(file, "# %i triangles\n", nTriangles);
-		for (size_t i = 0; i < nNonGrouped; i++)
-			fprintf(file, "f %d %d %d \n", 1+(*triangles)[i].i1, 1+(*triangles)[i].i2, 1+(*triangles)[i].i3);
+		ok = ok && WriteLines(file, 0, nNonGrouped, nThreads, TriangleLine);
 		if (triangleGroups)
 			for (size_t i = 0; i < triangleGroups->size(); i++) {
-				Group g = (*triangleGroups)[i];
+				Group &g = (*triangleGroups)[i];
 				if (g.nTriangles) {
 					fprintf(file, "g %s (%i triangles)\n", g.name.c_str(), g.nTriangles);
-					for (int t = g.startTriangle; t < g.startTriangle+g.nTriangles; t++)
-						fprintf(file, "f %d %d %d \n", 1+(*triangles)[t].i1, 1+(*triangles)[t].i2, 1+(*triangles)[t].i3);
+					ok = ok && WriteLines(file, g.startTriangle, g.startTriangle+g.nTriangles, nThreads, TriangleLine);
 				}
 			}
-	//	else
-	//		for (size_t i = 0; i < triangles->size(); i++)
-	//			fprintf(file, "f %d %d %d \n", 1+(*triangles)[i].i1, 1+(*triangles)[i].i2, 1+(*triangles)[i].i3);
 		fprintf(file, "\n");
 	}
 	if (quads)
-		for (size_t i = 0; i < quads->size(); i++)
-			fprintf(file, "f %d %d %d %d \n", 1+(*quads)[i].i1, 1+(*quads)[i].i2, 1+(*quads)[i].i3, 1+(*quads)[i].i4);
+		ok = ok && WriteLines(file, 0, quads->size(), nThreads, [&](size_t i, char *c) {
+			int4 &q = (*quads)[i];
+			*c++ = 'f';
+			c = PutInt(PutInt(PutInt(PutInt(c, 1+q.i1), 1+q.i2), 1+q.i3), 1+q.i4);
+			*c++ = '\n';
+			return c;
+		});
 	if (segs)
-		for (size_t i = 0; i < segs->size(); i++)
-			fprintf(file, "f %d %d \n", 1+(*segs)[i].i1, 1+(*segs)[i].i2);
-	fclose(file);
+		ok = ok && WriteLines(file, 0, segs->size(), nThreads, [&](size_t i, char *c) {
+			*c++ = 'f';
+			c = PutInt(PutInt(c, 1+(*segs)[i].i1), 1+(*segs)[i].i2);
+			*c++ = '\n';
+			return c;
+		});
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+		printf("can't write %s\n", filename);
+	return ok;
+}
+
+// STL
+
+namespace {
+
+int FloatKey(float f) {
+	// bit pattern of f, with -0 as 0
+	if (f == 0)
+		f = 0;
+	int i;
+	memcpy(&i, &f, sizeof(int));
+	return i;
+}
+
+class STLWelder {
+	// merge coincident vertices with a spatial hash, accumulate oriented triangles
+public:
+	vector<vec3> &points;
+	vector<int3> &triangles;
+	float tolerance, scale;
+	Int3Map cells;					// tolerance 0: point to id; else cell to first point in cell
+	vector<int> next;				// next point in same cell, or -1
+	STLWelder(vector<vec3> &points, vector<int3> &triangles, float tolerance, size_t nTriangles) :
+		points(points), triangles(triangles), tolerance(tolerance), scale(tolerance > 0? 1/tolerance : 0), cells(nTriangles/2+1) {
+			triangles.reserve(nTriangles);
+			points.reserve(nTriangles/2+3);
+	}
+	int Add(const vec3 &p) {
+		bool inserted;
+		if (tolerance <= 0) {
+			int *id = cells.Insert(int3(FloatKey(p.x), FloatKey(p.y), FloatKey(p.z)), points.size(), inserted);
+			if (inserted)
+				points.push_back(p);
+			return *id;
+		}
+		int3 c((int) floor(p.x*scale), (int) floor(p.y*scale), (int) floor(p.z*scale));
+		for (int dx = -1; dx <= 1; dx++)
+			for (int dy = -1; dy <= 1; dy++)
+				for (int dz = -1; dz <= 1; dz++) {
+					const int *head = cells.Find(int3(c.i1+dx, c.i2+dy, c.i3+dz));
+					for (int i = head? *head : -1; i >= 0; i = next[i]) {
+						vec3 d = points[i]-p;
+						if (dot(d, d) <= tolerance*tolerance)
+							return i;
+					}
+				}
+		int id = points.size();
+		int *head = cells.Insert(c, id, inserted);
+		next.push_back(inserted? -1 : *head);
+		*head = id;
+		points.push_back(p);
+		return id;
+	}
+	void Facet(const vec3 &n, vec3 *v) {
+		// orient to facet normal (as ReadSTL); skip triangles degenerate after welding
+		int3 t(Add(v[0]), Add(v[1]), Add(v[2]));
+		if (dot(cross(v[1]-v[0], v[2]-v[1]), n) < 0)
+			t = int3(t.i3, t.i2, t.i1);
+		if (t.i1 != t.i2 && t.i2 != t.i3 && t.i3 != t.i1)
+			triangles.push_back(t);
+	}
+};
+
+size_t BinarySTLTriangles(const MappedFile &file) {
+	// return # triangles if file is binary STL, else 0
+	// an ASCII file begins "solid", but so do some binary headers: if the size matches the triangle count exactly,
+	// the file is binary; otherwise, if it begins "solid" it is ASCII, else binary if large enough (trailing bytes ok)
+	if (file.size < 84)
+		return 0;
+	unsigned int n;
+	memcpy(&n, file.data+80, 4);
+	size_t nFit = (file.size-84)/50;
+	if (nFit == n && file.size == 84+50*nFit)
+		return n;
+	bool solid = !strncmp(file.data, "solid", 5);
+	return !solid && nFit >= n? n : 0;
+}
+
+template<class Facet> size_t ReadSTLFacets(const MappedFile &file, Facet facet) {
+	// call facet(normal, vertices) for each triangle in binary or ASCII STL; return # triangles
+	size_t nTriangles = BinarySTLTriangles(file);
+	vec3 n, v[3];
+	if (nTriangles) {
+		//  # bytes      use                  significance
+		//  -------      ---                  ------------
+		//       80      header               none
+		//        4      unsigned long int    number of triangles
+		//       12      3 floats             triangle normal
+		//       36      9 floats             x,y,z for vertices 1, 2, 3
+		//        2      unsigned short int   attribute (0)
+		// endianness is assumed to be little endian
+		const char *record = file.data+84;
+		for (size_t i = 0; i < nTriangles; i++, record += 50) {
+			memcpy(&n, record, sizeof(vec3));
+			memcpy(v, record+12, 3*sizeof(vec3));
+			facet(n, v);
+		}
+		return nTriangles;
+	}
+	// ASCII: facet normal nx ny nz / outer loop / vertex x y z (3) / endloop / endfacet
+	const char *data = file.data, *end = data+file.size, *ptr, *word;
+	int nVertices = 0;
+	for (const char *eol; data < end; data = eol+1) {
+		eol = (const char *) memchr(data, '\n', end-data);
+		if (!eol)
+			eol = end;
+		ptr = data;
+		while (ptr < eol && IsSpace(*ptr))
+			ptr++;
+		if (!NextWord(ptr, eol, word))
+			continue;
+		if (Keyword(word, ptr, "vertex")) {
+			vec3 &p = v[nVertices < 3? nVertices : 2];
+			if (!ParseFloat(ptr, eol, p.x) || !ParseFloat(ptr, eol, p.y) || !ParseFloat(ptr, eol, p.z))
+				return nTriangles;
+			if (++nVertices == 3) {
+				facet(n, v);
+				nTriangles++;
+			}
+		}
+		else if (Keyword(word, ptr, "facet")) {
+			n = vec3(0, 0, 0);
+			nVertices = 0;
+			if (NextWord(ptr, eol, word) && Keyword(word, ptr, "normal"))
+				if (!ParseFloat(ptr, eol, n.x) || !ParseFloat(ptr, eol, n.y) || !ParseFloat(ptr, eol, n.z))
+					n = vec3(0, 0, 0);
+		}
+	}
+	return nTriangles;
+}
+
+} // end namespace
+
+int ReadSTL(const char *filename, vector<VertexSTL> &vertices) {
+	// the facet normal should point outwards from the solid object; if this is zero,
+	// most software will calculate a normal from the ordered triangle vertices using the right-hand rule
+	MappedFile file;
+	if (!file.Open(filename))
+		return 0;
+	size_t nBinary = BinarySTLTriangles(file);
+	vertices.reserve(vertices.size()+3*nBinary);
+	return (int) ReadSTLFacets(file, [&](vec3 &n, vec3 *v) {
+		if (dot(cross(v[1]-v[0], v[2]-v[1]), n) < 0)
+			std::swap(v[0], v[2]);
+		for (int k = 0; k < 3; k++)
+			vertices.push_back(VertexSTL(&v[k].x, &n.x));
+	});
+}
+
+bool ReadSTL(const char *filename, vector<vec3> &points, vector<int3> &triangles, vector<vec3> *normals, float weldTolerance) {
+	MappedFile file;
+	if (!file.Open(filename))
+		return false;
+	points.resize(0);
+	triangles.resize(0);
+	size_t nBinary = BinarySTLTriangles(file);
+	STLWelder welder(points, triangles, weldTolerance, nBinary? nBinary : file.size/256);
+	if (!ReadSTLFacets(file, [&](vec3 &n, vec3 *v) { welder.Facet(n, v); }))
+		return false;
+	if (normals) {
+		normals->resize(0);
+		SetVertexNormals(points, triangles, *normals);
+	}
+	return true;
+}
+
+// PLY
+
+namespace {
+
+bool PlyKeyword(const char *word, const char *end, const char *key) {
+	// case-sensitive comparison of [word, end) with key
+	size_t n = strlen(key);
+	return (size_t) (end-word) == n && !strncmp(word, key, n);
+}
+
+int PlyTypeSize(const char *word, const char *end) {
+	// return # bytes of scalar type, or 0 if unknown
+	const char *types[] = {"char", "int8", "uchar", "uint8", "short", "int16", "ushort", "uint16",
+						   "int", "int32", "uint", "uint32", "float", "float32", "double", "float64"};
+	const int sizes[] = {1, 1, 1, 1, 2, 2, 2, 2, 4, 4, 4, 4, 4, 4, 8, 8};
+	for (int i = 0; i < 16; i++)
+		if (PlyKeyword(word, end, types[i]))
+			return sizes[i];
+	return 0;
+}
+
+struct PlyProperty {
+	string name;
+	int size = 0, offset = 0;			// scalar, or list item
+	bool isFloat = false, isSigned = false;
+	int countSize = 0;					// non-zero if list
+};
+
+struct PlyElement {
+	string name;
+	size_t count = 0;
+	vector<PlyProperty> properties;
+	int stride = 0;						// # bytes per element, if no list properties
+	int Find(const char *name) const {
+		for (size_t i = 0; i < properties.size(); i++)
+			if (properties[i].name == name && !properties[i].countSize)
+				return (int) i;
+		return -1;
+	}
+};
+
+double PlyValue(const char *c, const PlyProperty &p) {
+	// convert little-endian scalar at c
+	switch (p.size) {
+		case 1: return p.isSigned? (double) *(const signed char *) c : (double) *(const unsigned char *) c;
+		case 2: { short i; memcpy(&i, c, 2); return p.isSigned? (double) i : (double) (unsigned short) i; }
+		case 4: {
+			if (p.isFloat) { float f; memcpy(&f, c, 4); return f; }
+			int i; memcpy(&i, c, 4); return p.isSigned? (double) i : (double) (unsigned int) i;
+		}
+		case 8: { double d; memcpy(&d, c, 8); return d; }
+	}
+	return 0;
+}
+
+bool ReadPlyHeader(const MappedFile &file, vector<PlyElement> &elements, size_t &dataOffset) {
+	// parse ASCII header; only binary_little_endian is supported
+	const char *data = file.data, *end = data+file.size, *ptr, *word;
+	bool binary = false;
+	if (file.size < 4 || strncmp(data, "ply", 3))
+		return false;
+	for (const char *eol; data < end; data = eol+1) {
+		eol = (const char *) memchr(data, '\n', end-data);
+		if (!eol)
+			return false;
+		const char *lineEnd = eol;
+		while (lineEnd > data && lineEnd[-1] == '\r')
+			lineEnd--;
+		ptr = data;
+		if (!NextWord(ptr, lineEnd, word))
+			continue;
+		const char *wordEnd = ptr;
+		if (PlyKeyword(word, wordEnd, "end_header")) {
+			dataOffset = eol+1-file.data;
+			return binary;
+		}
+		if (PlyKeyword(word, wordEnd, "format"))
+			binary = NextWord(ptr, lineEnd, word) && PlyKeyword(word, ptr, "binary_little_endian");
+		else if (PlyKeyword(word, wordEnd, "element") && NextWord(ptr, lineEnd, word)) {
+			PlyElement e;
+			e.name = string(word, ptr);
+			e.count = (size_t) strtoull(ptr, NULL, 10);
+			elements.push_back(e);
+		}
+		else if (PlyKeyword(word, wordEnd, "property") && elements.size() && NextWord(ptr, lineEnd, word)) {
+			PlyElement &e = elements.back();
+			PlyProperty p;
+			if (PlyKeyword(word, ptr, "list")) {
+				if (!NextWord(ptr, lineEnd, word) || !(p.countSize = PlyTypeSize(word, ptr)) || !NextWord(ptr, lineEnd, word))
+					return false;
+			}
+			if (!(p.size = PlyTypeSize(word, ptr)))
+				return false;
+			p.isFloat = *word == 'f' || *word == 'd';
+			p.isSigned = p.isFloat || *word != 'u';
+			if (!NextWord(ptr, lineEnd, word))
+				return false;
+			p.name = string(word, ptr);
+			p.offset = e.stride;
+			if (p.countSize || e.stride < 0)
+				e.stride = -1;
+			else
+				e.stride += p.size;
+			e.properties.push_back(p);
+		}
+	}
+	return false;
+}
+
+const char *SkipPlyElement(const char *c, const char *end, const PlyElement &e) {
+	// return end of element data, or NULL if truncated
+	// sizes are compared with the bytes remaining before multiplying, so huge counts can't overflow
+	if (e.stride >= 0)
+		return !e.stride || e.count <= (size_t) (end-c)/e.stride? c+e.count*e.stride : NULL;
+	for (size_t i = 0; i < e.count; i++)
+		for (size_t k = 0; k < e.properties.size(); k++) {
+			const PlyProperty &p = e.properties[k];
+			size_t remaining = end-c;
+			if ((size_t) (p.countSize? p.countSize : p.size) > remaining)
+				return NULL;
+			if (p.countSize) {
+				PlyProperty countProperty;
+				countProperty.size = p.countSize;
+				double n = PlyValue(c, countProperty);
+				if (n < 0 || n > (double) ((remaining-p.countSize)/p.size))
+					return NULL;
+				c += p.countSize+(size_t) n*p.size;
+			}
+			else
+				c += p.size;
+		}
+	return c;
+}
+
+} // end namespace
+
+bool ReadPLY(const char *filename, vector<vec3> &points, vector<int3> *triangles, vector<vec3> *normals, vector<vec3> *colors) {
+	MappedFile file;
+	if (!file.Open(filename))
+		return false;
+	vector<PlyElement> elements;
+	size_t dataOffset = 0;
+	if (!ReadPlyHeader(file, elements, dataOffset)) {
+		printf("ReadPLY: %s not binary little-endian PLY\n", filename);
+		return false;
+	}
+	points.resize(0);
+	if (triangles) triangles->resize(0);
+	if (normals) normals->resize(0);
+	if (colors) colors->resize(0);
+	const char *c = file.data+dataOffset, *end = file.data+file.size;
+	for (size_t i = 0; i < elements.size(); i++) {
+		const PlyElement &e = elements[i];
+		const char *next = SkipPlyElement(c, end, e);
+		if (!next) {
+			printf("ReadPLY: %s truncated in element %s\n", filename, e.name.c_str());
+			return false;
+		}
+		if (e.name == "vertex" && e.stride < 0) {
+			printf("ReadPLY: %s vertex has list property\n", filename);
+			return false;
+		}
+		if (e.name == "vertex" && e.stride > 0) {
+			int x = e.Find("x"), nx = e.Find("nx"), r = e.Find("red");
+			size_t n = e.count;
+			// each attribute: if three consecutive floats, copy, else convert
+			auto Gather = [&](int id, vector<vec3> &v, float scale) {
+				const PlyProperty *p = &e.properties[id];
+				bool floats = id+2 < (int) e.properties.size() && p[0].isFloat && p[0].size == 4 &&
+							  p[1].isFloat && p[1].size == 4 && p[1].offset == p->offset+4 &&
+							  p[2].isFloat && p[2].size == 4 && p[2].offset == p->offset+8;
+				v.resize(n);
+				if (floats && e.stride == 12 && scale == 1) {
+					memcpy(v.data(), c, n*sizeof(vec3));
+					return;
+				}
+				const size_t blockSize = 1 << 16;
+				ParallelFor((int) ((n+blockSize-1)/blockSize), [&](int b) {
+					size_t i0 = b*blockSize, i1 = i0+blockSize < n? i0+blockSize : n;
+					const char *src = c+i0*e.stride;
+					for (size_t i = i0; i < i1; i++, src += e.stride)
+						if (floats && scale == 1)
+							memcpy(&v[i], src+p->offset, sizeof(vec3));
+						else
+							v[i] = scale*vec3((float) PlyValue(src+p[0].offset, p[0]), (float) PlyValue(src+p[1].offset, p[1]),
+											  (float) PlyValue(src+p[2].offset, p[2]));
+				});
+			};
+			if (x >= 0 && e.Find("y") == x+1 && e.Find("z") == x+2)
+				Gather(x, points, 1);
+			if (normals && nx >= 0 && e.Find("ny") == nx+1 && e.Find("nz") == nx+2)
+				Gather(nx, *normals, 1);
+			if (colors && r >= 0 && e.Find("green") == r+1 && e.Find("blue") == r+2) {
+				// integer colors span the full range of their type
+				const PlyProperty &p = e.properties[r];
+				Gather(r, *colors, p.isFloat? 1.f : p.size == 1? 1/255.f : p.size == 2? 1/65535.f : 1/4294967295.f);
+			}
+		}
+		if (e.name == "face" && triangles && e.properties.size() && e.properties[0].countSize) {
+			const PlyProperty &p = e.properties[0];
+			PlyProperty countProperty;
+			countProperty.size = p.countSize;
+			size_t faceSize = p.countSize+3*p.size;
+			bool allTriangles = e.properties.size() == 1 && (size_t) (next-c) == e.count*faceSize;
+			if (allTriangles && p.size == 4) {
+				// fixed layout: count 3, then three 32-bit indices
+				triangles->resize(e.count);
+				std::atomic<bool> ok(true);
+				const size_t blockSize = 1 << 16;
+				ParallelFor((int) ((e.count+blockSize-1)/blockSize), [&](int b) {
+					size_t i0 = b*blockSize, i1 = i0+blockSize < e.count? i0+blockSize : e.count;
+					const char *src = c+i0*faceSize;
+					for (size_t i = i0; i < i1; i++, src += faceSize) {
+						if (PlyValue(src, countProperty) != 3)
+							ok = false;
+						memcpy(&(*triangles)[i], src+p.countSize, sizeof(int3));
+					}
+				});
+				allTriangles = ok;
+			}
+			else
+				allTriangles = false;
+			if (!allTriangles) {
+				// general: polygons as triangle fans, other properties skipped
+				triangles->resize(0);
+				const char *f = c;
+				for (size_t i = 0; i < e.count; i++)
+					for (size_t k = 0; k < e.properties.size(); k++) {
+						const PlyProperty &q = e.properties[k];
+						if (!q.countSize) {
+							f += q.size;
+							continue;
+						}
+						PlyProperty qCount;
+						qCount.size = q.countSize;
+						int nIds = (int) PlyValue(f, qCount);
+						f += q.countSize;
+						if (k == 0)
+							for (int j = 1; j < nIds-1; j++)
+								triangles->push_back(int3((int) PlyValue(f, q), (int) PlyValue(f+j*q.size, q), (int) PlyValue(f+(j+1)*q.size, q)));
+						f += nIds*q.size;
+					}
+			}
+		}
+		c = next;
+	}
+	int nPoints = (int) points.size();
+	if (triangles)
+		for (size_t i = 0; i < triangles->size(); i++) {
+			const int3 &t = (*triangles)[i];
+			if (t.i1 < 0 || t.i2 < 0 || t.i3 < 0 || t.i1 >= nPoints || t.i2 >= nPoints || t.i3 >= nPoints) {
+				printf("ReadPLY: %s face %i has bad vertex index\n", filename, (int) i);
+				return false;
+			}
+		}
 	return true;
 }
+
+bool WritePLY(const char *filename, vector<vec3> &points, vector<int3> *triangles, vector<vec3> *normals, vector<vec3> *colors) {
+	FILE *file = fopen(filename, "wb");
+	if (!file) {
+		printf("can't write %s\n", filename);
+		return false;
+	}
+	size_t nPoints = points.size(), nTriangles = triangles? triangles->size() : 0;
+	bool useNormals = normals && normals->size() == nPoints, useColors = colors && colors->size() == nPoints;
+	fprintf(file, "ply\nformat binary_little_endian 1.0\nelement vertex %zu\n", nPoints);
+	fprintf(file, "property float x\nproperty float y\nproperty float z\n");
+	if (useNormals)
+		fprintf(file, "property float nx\nproperty float ny\nproperty float nz\n");
+	if (useColors)
+		fprintf(file, "property uchar red\nproperty uchar green\nproperty uchar blue\n");
+	if (triangles)
+		fprintf(file, "element face %zu\nproperty list uchar int vertex_indices\n", nTriangles);
+	fprintf(file, "end_header\n");
+	// vertices, then faces, in blocks
+	size_t stride = sizeof(vec3)+(useNormals? sizeof(vec3) : 0)+(useColors? 3 : 0), blockSize = 1 << 16;
+	vector<char> buf(blockSize*(stride > 13? stride : 13));
+	bool ok = true;
+	for (size_t i0 = 0; i0 < nPoints && ok; i0 += blockSize) {
+		size_t i1 = i0+blockSize < nPoints? i0+blockSize : nPoints;
+		char *c = buf.data();
+		for (size_t i = i0; i < i1; i++) {
+			memcpy(c, &points[i], sizeof(vec3));
+			c += sizeof(vec3);
+			if (useNormals) {
+				memcpy(c, &(*normals)[i], sizeof(vec3));
+				c += sizeof(vec3);
+			}
+			if (useColors)
+				for (int k = 0; k < 3; k++) {
+					float f = (*colors)[i][k];
+					*c++ = (unsigned char) (f <= 0? 0 : f >= 1? 255 : (int) (255*f+.5f));
+				}
+		}
+		ok = fwrite(buf.data(), 1, c-buf.data(), file) == (size_t) (c-buf.data());
+	}
+	for (size_t i0 = 0; i0 < nTriangles && ok; i0 += blockSize) {
+		size_t i1 = i0+blockSize < nTriangles? i0+blockSize : nTriangles;
+		char *c = buf.data();
+		for (size_t i = i0; i < i1; i++) {
+			*c++ = 3;
+			memcpy(c, &(*triangles)[i], sizeof(int3));
+			c += sizeof(int3);
+		}
+		ok = fwrite(buf.data(), 1, c-buf.data(), file) == (size_t) (c-buf.data());
+	}
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+		printf("can't write %s\n", filename);
+	return ok;
+}
+
+// FBX
+
+namespace {
+
+struct FbxProperty {
+	char type = 0;					// Y C I F D L (scalar), S R (string, raw), f d l i b (array)
+	const char *data = NULL;		// scalar, string, or (possibly compressed) array contents
+	unsigned size = 0;				// # bytes at data
+	unsigned count = 0;				// # array elements
+	unsigned encoding = 0;			// 1: zlib compressed
+	double Number() const {
+		switch (type) {
+			case 'C': return *data;
+			case 'Y': { short v; memcpy(&v, data, 2); return v; }
+			case 'I': { int v; memcpy(&v, data, 4); return v; }
+			case 'F': { float v; memcpy(&v, data, 4); return v; }
+			case 'D': { double v; memcpy(&v, data, 8); return v; }
+			case 'L': { long long v; memcpy(&v, data, 8); return (double) v; }
+		}
+		return 0;
+	}
+	long long Id() const {
+		long long v = 0;
+		if (type == 'L') memcpy(&v, data, 8);
+		else if (type == 'I') { int i; memcpy(&i, data, 4); v = i; }
+		return v;
+	}
+	string Text() const { return type == 'S'? string(data, size) : string(); }
+};
+
+struct FbxNode {
+	string name;
+	vector<FbxProperty> properties;
+	vector<FbxNode> children;
+	const FbxNode *Find(const char *n) const {
+		for (size_t i = 0; i < children.size(); i++)
+			if (children[i].name == n)
+				return &children[i];
+		return NULL;
+	}
+	const FbxProperty *Property(size_t i) const { return i < properties.size()? &properties[i] : NULL; }
+	string Text(const char *n) const {
+		// string value of child n
+		const FbxNode *c = Find(n);
+		return c && c->properties.size()? c->properties[0].Text() : string();
+	}
+};
+
+bool ParseFbxNode(const char *&c, const char *begin, const char *end, bool wide, FbxNode &node, bool &isNull, int depth) {
+	// parse node record at c; isNull if end-of-list marker
+	size_t headerSize = wide? 25 : 13;
+	if ((size_t) (end-c) < headerSize || depth > 64)
+		return false;
+	unsigned long long endOffset = 0, nProperties = 0;
+	if (wide) {
+		memcpy(&endOffset, c, 8);
+		memcpy(&nProperties, c+8, 8);
+	}
+	else {
+		unsigned v[3];
+		memcpy(v, c, 12);
+		endOffset = v[0];
+		nProperties = v[1];
+	}
+	unsigned char nameLength = (unsigned char) c[headerSize-1];
+	isNull = endOffset == 0;
+	if (isNull) {
+		c += headerSize;
+		return true;
+	}
+	const char *nodeEnd = begin+endOffset;
+	if (nodeEnd > end || nodeEnd < c+headerSize+nameLength)
+		return false;
+	node.name = string(c+headerSize, nameLength);
+	c += headerSize+nameLength;
+	for (unsigned long long i = 0; i < nProperties; i++) {
+		if (c >= nodeEnd)
+			return false;
+		FbxProperty p;
+		p.type = *c++;
+		const char *scalar = "YCIFDL";
+		const int scalarSizes[] = {2, 1, 4, 4, 8, 8};
+		if (const char *s = p.type? strchr(scalar, p.type) : NULL) {
+			p.size = scalarSizes[s-scalar];
+			p.data = c;
+		}
+		else if (p.type == 'S' || p.type == 'R') {
+			if (nodeEnd-c < 4)
+				return false;
+			memcpy(&p.size, c, 4);
+			p.data = c += 4;
+		}
+		else if (p.type && strchr("fdlib", p.type)) {
+			unsigned v[3];
+			if (nodeEnd-c < 12)
+				return false;
+			memcpy(v, c, 12);
+			p.count = v[0];
+			p.encoding = v[1];
+			p.size = v[2];
+			p.data = c += 12;
+		}
+		else
+			return false;
+		if ((size_t) (nodeEnd-c) < p.size)
+			return false;
+		c += p.size;
+		node.properties.push_back(p);
+	}
+	// nested list, terminated by null record
+	while (c < nodeEnd) {
+		FbxNode child;
+		bool childNull;
+		if (!ParseFbxNode(c, begin, nodeEnd, wide, child, childNull, depth+1))
+			return false;
+		if (childNull)
+			break;
+		node.children.push_back(std::move(child));
+	}
+	c = nodeEnd;
+	return true;
+}
+
+int FbxElementSize(char type) { return type == 'd' || type == 'l'? 8 : type == 'b'? 1 : 4; }
+
+struct FbxArrays {
+	// array properties, inflated as needed (in parallel)
+	std::map<const FbxProperty *, string> inflated;
+	void Add(const FbxProperty *p) {
+		if (p && p->encoding == 1)
+			inflated[p];
+	}
+	bool Inflate(int nThreads) {
+		vector<std::pair<const FbxProperty *, string *>> tasks;
+		for (auto it = inflated.begin(); it != inflated.end(); it++)
+			tasks.push_back(std::make_pair(it->first, &it->second));
+		std::atomic<bool> ok(true);
+		ParallelFor((int) tasks.size(), [&](int i) {
+			const FbxProperty *p = tasks[i].first;
+			string &out = *tasks[i].second;
+			size_t nBytes = (size_t) p->count*FbxElementSize(p->type);
+			if (nBytes > INT_MAX || nBytes > 1032*(size_t) p->size+64) {	// beyond deflate's maximum ratio
+				ok = false;
+				return;
+			}
+			out.resize(nBytes);
+			if (stbi_zlib_decode_buffer(&out[0], (int) nBytes, p->data, (int) p->size) != (int) nBytes)
+				ok = false;
+		}, nThreads);
+		return ok;
+	}
+	const char *Data(const FbxProperty *p) const {
+		// return array contents, or NULL if malformed
+		if (!p || !p->type || !strchr("fdlib", p->type))
+			return NULL;
+		if (p->encoding == 0)
+			return (size_t) p->count*FbxElementSize(p->type) <= p->size? p->data : NULL;
+		auto it = inflated.find(p);
+		return it != inflated.end() && it->second.size()? it->second.data() : NULL;
+	}
+	template<class T> bool Get(const FbxProperty *p, vector<T> &v) const {
+		// convert array elements to T
+		const char *d = Data(p);
+		if (!d)
+			return false;
+		v.resize(p->count);
+		for (unsigned i = 0; i < p->count; i++)
+			switch (p->type) {
+				case 'd': { double x; memcpy(&x, d+8*i, 8); v[i] = (T) x; break; }
+				case 'f': { float x; memcpy(&x, d+4*i, 4); v[i] = (T) x; break; }
+				case 'l': { long long x; memcpy(&x, d+8*i, 8); v[i] = (T) x; break; }
+				case 'i': { int x; memcpy(&x, d+4*i, 4); v[i] = (T) x; break; }
+				case 'b': v[i] = (T) d[i]; break;
+			}
+		return true;
+	}
+};
+
+const FbxProperty *FbxArray(const FbxNode *n, const char *child) {
+	const FbxNode *c = n? n->Find(child) : NULL;
+	return c? c->Property(0) : NULL;
+}
+
+vec3 FbxVector(const FbxNode *node, const char *name, vec3 def) {
+	// Properties70 P entry: name, type, label, flags, values
+	const FbxNode *props = node? node->Find("Properties70") : NULL;
+	if (props)
+		for (size_t i = 0; i < props->children.size(); i++) {
+			const FbxNode &p = props->children[i];
+			if (p.name == "P" && p.properties.size() >= 5 && p.properties[0].Text() == name) {
+				vec3 v;		// scalar replicated
+				for (int k = 0; k < 3; k++)
+					v[k] = 4+k < (int) p.properties.size()? (float) p.properties[4+k].Number() : v[k-1];
+				return v;
+			}
+		}
+	return def;
+}
+
+float FbxNumber(const FbxNode *node, const char *name, float def) { return FbxVector(node, name, vec3(def, def, def)).x; }
+
+mat4 FbxRotate(vec3 r, int order = 0) {
+	// euler angles (degrees); order 0 (XYZ) rotates about X first
+	mat4 x = RotateX(r.x), y = RotateY(r.y), z = RotateZ(r.z);
+	switch (order) {
+		case 1: return y*z*x;	// XZY
+		case 2: return x*z*y;	// YZX
+		case 3: return z*x*y;	// YXZ
+		case 4: return y*x*z;	// ZXY
+		case 5: return x*y*z;	// ZYX
+	}
+	return z*y*x;
+}
+
+mat4 FbxLocalMatrix(const FbxNode *model) {
+	// T*Roff*Rp*Rpre*R*Rpost^-1*Rp^-1*Soff*Sp*S*Sp^-1
+	vec3 t = FbxVector(model, "Lcl Translation", vec3(0, 0, 0)), r = FbxVector(model, "Lcl Rotation", vec3(0, 0, 0));
+	vec3 s = FbxVector(model, "Lcl Scaling", vec3(1, 1, 1));
+	vec3 rOff = FbxVector(model, "RotationOffset", vec3(0, 0, 0)), rPivot = FbxVector(model, "RotationPivot", vec3(0, 0, 0));
+	vec3 sOff = FbxVector(model, "ScalingOffset", vec3(0, 0, 0)), sPivot = FbxVector(model, "ScalingPivot", vec3(0, 0, 0));
+	vec3 pre = FbxVector(model, "PreRotation", vec3(0, 0, 0)), post = FbxVector(model, "PostRotation", vec3(0, 0, 0));
+	mat4 rPost = FbxRotate(post), rPostInv;
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			rPostInv[i][j] = rPost[j][i];
+	int order = (int) FbxNumber(model, "RotationOrder", 0);
+	return Translate(t)*Translate(rOff)*Translate(rPivot)*FbxRotate(pre)*FbxRotate(r, order)*rPostInv*Translate(-rPivot)*
+		   Translate(sOff)*Translate(sPivot)*Scale(s)*Translate(-sPivot);
+}
+
+mat4 FbxGeometricMatrix(const FbxNode *model) {
+	// applied to geometry only, not inherited
+	return Translate(FbxVector(model, "GeometricTranslation", vec3(0, 0, 0)))*
+		   FbxRotate(FbxVector(model, "GeometricRotation", vec3(0, 0, 0)))*
+		   Scale(FbxVector(model, "GeometricScaling", vec3(1, 1, 1)));
+}
+
+mat4 FbxAxisMatrix(const FbxNode *globalSettings) {
+	// convert scene axes to x right, y up, z front
+	int axes[3] = {(int) FbxNumber(globalSettings, "CoordAxis", 0), (int) FbxNumber(globalSettings, "UpAxis", 1), (int) FbxNumber(globalSettings, "FrontAxis", 2)};
+	float signs[3] = {FbxNumber(globalSettings, "CoordAxisSign", 1), FbxNumber(globalSettings, "UpAxisSign", 1), FbxNumber(globalSettings, "FrontAxisSign", 1)};
+	mat4 m(0);
+	m[3][3] = 1;
+	for (int i = 0; i < 3; i++) {
+		if (axes[i] < 0 || axes[i] > 2 || (axes[i] == axes[(i+1)%3]))
+			return mat4();
+		m[i][axes[i]] = signs[i] < 0? -1.f : 1.f;
+	}
+	return m;
+}
+
+struct FbxLayer {
+	// per polygon-vertex attribute: mapping and optional index array
+	const FbxProperty *values = NULL, *indices = NULL;
+	bool byPolygonVertex = false, byPolygon = false, allSame = false;	// else by (control point) vertex
+	void Set(const FbxNode *layer, const char *valuesName, const char *indexName) {
+		if (!layer)
+			return;
+		string mapping = layer->Text("MappingInformationType"), reference = layer->Text("ReferenceInformationType");
+		byPolygonVertex = mapping == "ByPolygonVertex";
+		byPolygon = mapping == "ByPolygon";
+		allSame = mapping == "AllSame";
+		values = FbxArray(layer, valuesName);
+		if (reference == "IndexToDirect" || reference == "Index")
+			indices = FbxArray(layer, indexName);
+	}
+	void Add(FbxArrays &arrays) const { arrays.Add(values); arrays.Add(indices); }
+};
+
+struct FbxModel {
+	// mesh model with its geometry, transform, and materials
+	string name;
+	const FbxNode *geometry = NULL;
+	mat4 toWorld;
+	vector<int> materials;			// model material slot -> scene material
+	FbxLayer normals, uvs, mtls;
+	// output of conversion
+	vector<vec3> points, normalsOut;
+	vector<vec2> uvsOut;
+	vector<int3> triangles;
+	vector<int> triangleMtls;		// scene material per triangle, or -1
+	bool ok = true;
+};
+
+int FbxLayerIndex(const FbxLayer &l, const vector<int> &indices, int polygonVertex, int polygon, int vertex) {
+	int i = l.allSame? 0 : l.byPolygonVertex? polygonVertex : l.byPolygon? polygon : vertex;
+	if (l.indices)
+		i = i >= 0 && i < (int) indices.size()? indices[i] : -1;
+	return i;
+}
+
+void ConvertFbxModel(FbxModel &m, const FbxArrays &arrays) {
+	// unique vertices per point/normal/uv triplet; normals canonicalized by value so equal normals share vertices
+	vector<double> points, normals, uvs;
+	vector<int> polygons, normalIds, uvIds, mtlIds;
+	if (!arrays.Get(FbxArray(m.geometry, "Vertices"), points) || !arrays.Get(FbxArray(m.geometry, "PolygonVertexIndex"), polygons)) {
+		m.ok = false;
+		return;
+	}
+	bool hasNormals = m.normals.values && arrays.Get(m.normals.values, normals) && (!m.normals.indices || arrays.Get(m.normals.indices, normalIds));
+	bool hasUvs = m.uvs.values && arrays.Get(m.uvs.values, uvs) && (!m.uvs.indices || arrays.Get(m.uvs.indices, uvIds));
+	bool hasMtls = m.mtls.values && arrays.Get(m.mtls.values, mtlIds);
+	int nPoints = (int) points.size()/3, nNormals = (int) normals.size()/3, nUvs = (int) uvs.size()/2;
+	mat4 normalMatrix;
+	InvertAffine(m.toWorld, normalMatrix);
+	Int3Map normalMap, vertexMap(polygons.size()/2);
+	vector<int> normalCanon(nNormals), polygon;
+	for (int i = 0; i < nNormals; i++) {
+		vec3 n((float) normals[3*i], (float) normals[3*i+1], (float) normals[3*i+2]);
+		int bits[3];
+		memcpy(bits, &n, sizeof(vec3));
+		bool inserted;
+		normalCanon[i] = *normalMap.Insert(int3(bits), i, inserted);
+	}
+	auto Vertex = [&](int point, int normal, int uv) {
+		bool inserted;
+		int *id = vertexMap.Insert(int3(point, normal, uv), (int) m.points.size(), inserted);
+		if (inserted) {
+			m.points.push_back(Vec3(m.toWorld*vec4((float) points[3*point], (float) points[3*point+1], (float) points[3*point+2], 1)));
+			if (hasNormals) {
+				vec3 n = normal < 0? vec3(0, 0, 0) : vec3((float) normals[3*normal], (float) normals[3*normal+1], (float) normals[3*normal+2]);
+				vec3 w(dot(vec3(normalMatrix[0][0], normalMatrix[1][0], normalMatrix[2][0]), n),
+					   dot(vec3(normalMatrix[0][1], normalMatrix[1][1], normalMatrix[2][1]), n),
+					   dot(vec3(normalMatrix[0][2], normalMatrix[1][2], normalMatrix[2][2]), n));
+				m.normalsOut.push_back(normal < 0 || length(w) == 0? w : normalize(w));
+			}
+			if (hasUvs)
+				m.uvsOut.push_back(uv < 0? vec2(0, 0) : vec2((float) uvs[2*uv], (float) uvs[2*uv+1]));
+		}
+		return *id;
+	};
+	// polygon ends with negative index (bitwise complement)
+	for (int i = 0, nPolygon = 0; i < (int) polygons.size(); i++) {
+		int index = polygons[i], point = index < 0? ~index : index;
+		if (point >= nPoints) {
+			m.ok = false;
+			return;
+		}
+		int normal = hasNormals? FbxLayerIndex(m.normals, normalIds, i, nPolygon, point) : -1;
+		int uv = hasUvs? FbxLayerIndex(m.uvs, uvIds, i, nPolygon, point) : -1;
+		normal = normal >= 0 && normal < nNormals? normalCanon[normal] : -1;
+		uv = uv >= 0 && uv < nUvs? uv : -1;
+		polygon.push_back(Vertex(point, normal, uv));
+		if (index < 0) {
+			// material slot: same for all polygons, or per polygon
+			int slot = !hasMtls || !mtlIds.size()? -1 : m.mtls.allSame? mtlIds[0] :
+					   m.mtls.byPolygon && nPolygon < (int) mtlIds.size()? mtlIds[nPolygon] : -1;
+			int mtl = slot >= 0 && slot < (int) m.materials.size()? m.materials[slot] : -1;
+			for (size_t k = 2; k < polygon.size(); k++) {
+				m.triangles.push_back(int3(polygon[0], polygon[k-1], polygon[k]));
+				m.triangleMtls.push_back(mtl);
+			}
+			polygon.resize(0);
+			nPolygon++;
+		}
+	}
+}
+
+} // end namespace
+
+bool ReadFBX(const char    *filename,
+			 vector<vec3>  &points,
+			 vector<int3>  &triangles,
+			 vector<vec3>  *normals,
+			 vector<vec2>  *textures,
+			 vector<Group> *triangleGroups,
+			 vector<Mtl>   *triangleMtls,
+			 int            nThreads) {
+	MappedFile file;
+	if (!file.Open(filename)) {
+		printf("ReadFBX: can't open %s\n", filename);
+		return false;
+	}
+	const char magic[] = "Kaydara FBX Binary  ";
+	unsigned version = 0;
+	if (file.size < 27 || memcmp(file.data, magic, 20)) {
+		printf("ReadFBX: %s not binary FBX\n", filename);
+		return false;
+	}
+	memcpy(&version, file.data+23, 4);
+	// node tree (arrays still compressed)
+	FbxNode root;
+	const char *c = file.data+27, *end = file.data+file.size;
+	for (;;) {
+		FbxNode node;
+		bool isNull;
+		if (!ParseFbxNode(c, file.data, end, version >= 7500, node, isNull, 0)) {
+			printf("ReadFBX: %s malformed\n", filename);
+			return false;
+		}
+		if (isNull)
+			break;
+		root.children.push_back(std::move(node));
+	}
+	const FbxNode *objects = root.Find("Objects"), *connections = root.Find("Connections");
+	if (!objects) {
+		printf("ReadFBX: %s has no objects\n", filename);
+		return false;
+	}
+	// objects by id, and object-object connections (child, parent) in file order
+	std::map<long long, const FbxNode *> byId;
+	for (size_t i = 0; i < objects->children.size(); i++) {
+		const FbxNode &o = objects->children[i];
+		if (o.properties.size())
+			byId[o.properties[0].Id()] = &o;
+	}
+	auto Get = [&](long long id, const char *type) {
+		auto it = byId.find(id);
+		return it != byId.end() && it->second->name == type? it->second : (const FbxNode *) NULL;
+	};
+	std::map<long long, long long> modelParent;
+	std::map<long long, long long> geometryModel;
+	vector<std::pair<long long, long long>> materialModel, textureMaterial;
+	if (connections)
+		for (size_t i = 0; i < connections->children.size(); i++) {
+			const FbxNode &cn = connections->children[i];
+			if (cn.name != "C" || cn.properties.size() < 3)
+				continue;
+			string kind = cn.properties[0].Text();
+			long long child = cn.properties[1].Id(), parent = cn.properties[2].Id();
+			if (kind == "OO" && Get(child, "Model"))
+				modelParent[child] = parent;
+			if (kind == "OO" && Get(child, "Geometry") && Get(parent, "Model"))
+				geometryModel[child] = parent;
+			if (kind == "OO" && Get(child, "Material") && Get(parent, "Model"))
+				materialModel.push_back(std::make_pair(child, parent));
+			if (kind == "OP" && Get(child, "Texture") && Get(parent, "Material") && cn.properties.size() > 3 &&
+				cn.properties[3].Text() == "DiffuseColor")
+				textureMaterial.push_back(std::make_pair(child, parent));
+		}
+	// scene materials
+	string name(filename), dir;
+	size_t slash = name.find_last_of("/\\");
+	if (slash != string::npos)
+		dir = name.substr(0, slash+1);
+	vector<Mtl> mtls;
+	std::map<long long, int> mtlIds;
+	for (size_t i = 0; i < objects->children.size(); i++) {
+		const FbxNode &o = objects->children[i];
+		if (o.name != "Material" || o.properties.size() < 2)
+			continue;
+		Mtl mtl;
+		string n = o.properties[1].Text();
+		mtl.name = n.substr(0, n.find('\0'));
+		mtl.ka = FbxVector(&o, "AmbientColor", vec3(0, 0, 0))*FbxNumber(&o, "AmbientFactor", 1);
+		mtl.kd = FbxVector(&o, "DiffuseColor", vec3(.8f, .8f, .8f))*FbxNumber(&o, "DiffuseFactor", 1);
+		mtl.ks = FbxVector(&o, "SpecularColor", vec3(0, 0, 0))*FbxNumber(&o, "SpecularFactor", 1);
+		mtl.ns = FbxNumber(&o, "ShininessExponent", FbxNumber(&o, "Shininess", 0));
+		mtl.d = FbxNumber(&o, "Opacity", 1-FbxNumber(&o, "TransparencyFactor", 0)*FbxVector(&o, "TransparentColor", vec3(0, 0, 0)).x);
+		mtlIds[o.properties[0].Id()] = (int) mtls.size();
+		mtls.push_back(mtl);
+	}
+	for (size_t i = 0; i < textureMaterial.size(); i++) {
+		const FbxNode *texture = Get(textureMaterial[i].first, "Texture");
+		string texFile = texture->Text("RelativeFilename");
+		if (texFile.empty())
+			texFile = texture->Text("FileName");
+		if (texFile.size())
+			mtls[mtlIds[textureMaterial[i].second]].mapKd = texFile[0] == '/' || strchr(texFile.c_str(), ':')? texFile : dir+texFile;
+	}
+	// mesh models: geometry, world transform (through model parents), material slots
+	mat4 axes = FbxAxisMatrix(root.Find("GlobalSettings"));
+	vector<FbxModel> models;
+	for (size_t i = 0; i < objects->children.size(); i++) {
+		const FbxNode &o = objects->children[i];
+		auto it = geometryModel.find(o.name == "Geometry" && o.properties.size()? o.properties[0].Id() : 0);
+		if (it == geometryModel.end())
+			continue;
+		FbxModel m;
+		m.geometry = &o;
+		const FbxNode *model = Get(it->second, "Model");
+		string n = model->properties.size() > 1? model->properties[1].Text() : string();
+		m.name = n.substr(0, n.find('\0'));
+		m.toWorld = FbxGeometricMatrix(model);
+		int depth = 0;
+		for (long long id = it->second; Get(id, "Model") && depth < 256; depth++) {
+			m.toWorld = FbxLocalMatrix(Get(id, "Model"))*m.toWorld;
+			auto p = modelParent.find(id);
+			id = p == modelParent.end()? 0 : p->second;
+		}
+		m.toWorld = axes*m.toWorld;
+		for (size_t k = 0; k < materialModel.size(); k++)
+			if (materialModel[k].second == it->second)
+				m.materials.push_back(mtlIds[materialModel[k].first]);
+		m.normals.Set(m.geometry->Find("LayerElementNormal"), "Normals", "NormalsIndex");
+		m.uvs.Set(m.geometry->Find("LayerElementUV"), "UV", "UVIndex");
+		m.mtls.Set(m.geometry->Find("LayerElementMaterial"), "Materials", "");
+		models.push_back(m);
+	}
+	// inflate compressed arrays, then convert models, in parallel
+	FbxArrays arrays;
+	for (size_t i = 0; i < models.size(); i++) {
+		arrays.Add(FbxArray(models[i].geometry, "Vertices"));
+		arrays.Add(FbxArray(models[i].geometry, "PolygonVertexIndex"));
+		models[i].normals.Add(arrays);
+		models[i].uvs.Add(arrays);
+		models[i].mtls.Add(arrays);
+	}
+	if (!arrays.Inflate(nThreads)) {
+		printf("ReadFBX: %s has corrupt compressed array\n", filename);
+		return false;
+	}
+	ParallelFor((int) models.size(), [&](int i) { ConvertFbxModel(models[i], arrays); }, nThreads);
+	// merge
+	bool anyNormals = false, anyUvs = false;
+	size_t nPoints = 0, nTriangles = 0;
+	for (size_t i = 0; i < models.size(); i++) {
+		if (!models[i].ok) {
+			printf("ReadFBX: %s has bad geometry for %s\n", filename, models[i].name.c_str());
+			return false;
+		}
+		anyNormals = anyNormals || models[i].normalsOut.size();
+		anyUvs = anyUvs || models[i].uvsOut.size();
+		nPoints += models[i].points.size();
+		nTriangles += models[i].triangles.size();
+	}
+	points.resize(0);
+	points.reserve(nPoints);
+	triangles.resize(0);
+	triangles.reserve(nTriangles);
+	if (normals) normals->resize(0);
+	if (textures) textures->resize(0);
+	if (triangleGroups) triangleGroups->resize(0);
+	if (triangleMtls) triangleMtls->resize(0);
+	vector<std::pair<int, int>> runs;	// start triangle, material
+	for (size_t i = 0; i < models.size(); i++) {
+		FbxModel &m = models[i];
+		int base = (int) points.size(), start = (int) triangles.size();
+		points.insert(points.end(), m.points.begin(), m.points.end());
+		if (normals && anyNormals) {
+			if (m.normalsOut.size())
+				normals->insert(normals->end(), m.normalsOut.begin(), m.normalsOut.end());
+			else
+				normals->resize(points.size(), vec3(0, 0, 0));
+		}
+		if (textures && anyUvs) {
+			if (m.uvsOut.size())
+				textures->insert(textures->end(), m.uvsOut.begin(), m.uvsOut.end());
+			else
+				textures->resize(points.size(), vec2(0, 0));
+		}
+		for (size_t t = 0; t < m.triangles.size(); t++) {
+			int3 &tri = m.triangles[t];
+			triangles.push_back(int3(tri.i1+base, tri.i2+base, tri.i3+base));
+			int mtl = m.triangleMtls[t];
+			if (runs.empty() || runs.back().second != mtl)
+				runs.push_back(std::make_pair(start+(int) t, mtl));
+		}
+		if (triangleGroups && m.triangles.size()) {
+			Group g(start, m.name);
+			g.nTriangles = (int) m.triangles.size();
+			triangleGroups->push_back(g);
+		}
+	}
+	// one Mtl per run of triangles with the same material
+	if (triangleMtls)
+		for (size_t i = 0; i < runs.size(); i++)
+			if (runs[i].second >= 0) {
+				Mtl run = mtls[runs[i].second];
+				run.startTriangle = runs[i].first;
+				run.nTriangles = (i+1 < runs.size()? runs[i+1].first : (int) triangles.size())-run.startTriangle;
+				triangleMtls->push_back(run);
+			}
+	return true;
+}
+
+// Binary mesh cache
+
+namespace {
+
+const char meshBinMagic[8] = {'M', 'E', 'S', 'H', 'B', 'I', 'N', 0};
+const unsigned meshBinVersion = 3;
+
+struct MeshBinHeader {
+	char magic[8];
+	unsigned version, flags;
+	long long sourceModified;
+	unsigned long long nPoints, nNormals, nUvs, nTriangles, nQuads, nGroups, nMtls;
+	unsigned long long verticesOffset, trianglesOffset, quadsOffset, groupsOffset, mtlsOffset, fileSize;
+	unsigned long long nDependencies, dependenciesOffset;
+};
+
+struct MeshBinGroup { int startTriangle, nTriangles; vec3 color; unsigned nameLength; };
+struct MeshBinMtl { int startTriangle, nTriangles; vec3 ka, kd, ks; float ns, d; unsigned nameLength, mapKdLength; };
+struct MeshBinDependency { long long modified; unsigned nameLength; };
+	// each followed by name (and, for MeshBinMtl, mapKd), padded to multiple of 8 bytes
+
+size_t Align8(size_t n) { return (n+7) & ~(size_t) 7; }
+
+void Append(vector<char> &buf, const void *data, size_t size) {
+	// append data, pad to 8-byte alignment
+	size_t start = buf.size();
+	buf.resize(Align8(start+size), 0);
+	if (size)
+		memcpy(&buf[start], data, size);
+}
+
+} // end namespace
+
+bool WriteMeshBin(const char    *filename,
+				  time_t         sourceModified,
+				  unsigned       flags,
+				  vector<vec3>  &points,
+				  vector<vec3>  &normals,
+				  vector<vec2>  &uvs,
+				  vector<int3>  &triangles,
+				  vector<int4>  &quads,
+				  vector<Group> &triangleGroups,
+				  vector<Mtl>   &triangleMtls,
+				  const vector<string> *dependencies) {
+	MeshBinHeader h = {};
+	memcpy(h.magic, meshBinMagic, sizeof(h.magic));
+	h.version = meshBinVersion;
+	h.flags = flags;
+	h.sourceModified = (long long) sourceModified;
+	h.nPoints = points.size();
+	h.nNormals = normals.size();
+	h.nUvs = uvs.size();
+	h.nTriangles = triangles.size();
+	h.nQuads = quads.size();
+	h.nGroups = triangleGroups.size();
+	h.nMtls = triangleMtls.size();
+	h.nDependencies = dependencies? dependencies->size() : 0;
+	size_t sizePoints = points.size()*sizeof(vec3), sizeNormals = normals.size()*sizeof(vec3), sizeUvs = uvs.size()*sizeof(vec2);
+	vector<char> buf;
+	buf.reserve(sizeof(h)+sizePoints+sizeNormals+sizeUvs+triangles.size()*sizeof(int3)+quads.size()*sizeof(int4)+1024);
+	Append(buf, &h, sizeof(h));
+	h.verticesOffset = buf.size();
+	// vertices contiguous (no padding between arrays)
+	vector<char> vertices(sizePoints+sizeNormals+sizeUvs);
+	if (sizePoints) memcpy(vertices.data(), points.data(), sizePoints);
+	if (sizeNormals) memcpy(vertices.data()+sizePoints, normals.data(), sizeNormals);
+	if (sizeUvs) memcpy(vertices.data()+sizePoints+sizeNormals, uvs.data(), sizeUvs);
+	Append(buf, vertices.data(), vertices.size());
+	h.trianglesOffset = buf.size();
+	Append(buf, triangles.data(), triangles.size()*sizeof(int3));
+	h.quadsOffset = buf.size();
+	Append(buf, quads.data(), quads.size()*sizeof(int4));
+	h.groupsOffset = buf.size();
+	for (size_t i = 0; i < triangleGroups.size(); i++) {
+		Group &g = triangleGroups[i];
+		MeshBinGroup r = {g.startTriangle, g.nTriangles, g.color, (unsigned) g.name.size()};
+		Append(buf, &r, sizeof(r));
+		Append(buf, g.name.data(), g.name.size());
+	}
+	h.mtlsOffset = buf.size();
+	for (size_t i = 0; i < triangleMtls.size(); i++) {
+		Mtl &m = triangleMtls[i];
+		MeshBinMtl r = {m.startTriangle, m.nTriangles, m.ka, m.kd, m.ks, m.ns, m.d, (unsigned) m.name.size(), (unsigned) m.mapKd.size()};
+		Append(buf, &r, sizeof(r));
+		Append(buf, m.name.data(), m.name.size());
+		Append(buf, m.mapKd.data(), m.mapKd.size());
+	}
+	h.dependenciesOffset = buf.size();
+	for (size_t i = 0; i < h.nDependencies; i++) {
+		const string &name = (*dependencies)[i];
+		MeshBinDependency r = {(long long) FileModified(name.c_str()), (unsigned) name.size()};
+		Append(buf, &r, sizeof(r));
+		Append(buf, name.data(), name.size());
+	}
+	h.fileSize = buf.size();
+	memcpy(buf.data(), &h, sizeof(h));
+	FILE *out = fopen(filename, "wb");
+	if (!out)
+		return false;
+	bool ok = fwrite(buf.data(), 1, buf.size(), out) == buf.size();
+	ok = fclose(out) == 0 && ok;
+	if (!ok)
+		remove(filename);
+	return ok;
+}
+
+bool MeshBin::Open(const char *filename, time_t sourceModified, unsigned flags) {
+	file.Close();
+	if (!file.Open(filename))
+		return false;
+	MeshBinHeader h;
+	bool ok = file.size >= sizeof(h);
+	if (ok)
+		memcpy(&h, file.data, sizeof(h));
+	ok = ok && !memcmp(h.magic, meshBinMagic, sizeof(h.magic)) && h.version == meshBinVersion && h.flags == flags &&
+		 h.sourceModified == (long long) sourceModified && h.fileSize == file.size;
+	// validate array extents
+	ok = ok && h.verticesOffset+h.nPoints*sizeof(vec3)+h.nNormals*sizeof(vec3)+h.nUvs*sizeof(vec2) <= h.trianglesOffset &&
+		 h.trianglesOffset+h.nTriangles*sizeof(int3) <= h.quadsOffset &&
+		 h.quadsOffset+h.nQuads*sizeof(int4) <= h.groupsOffset && h.groupsOffset <= h.mtlsOffset &&
+		 h.mtlsOffset <= h.dependenciesOffset && h.dependenciesOffset <= h.fileSize;
+	// dependencies unchanged since written
+	const char *p = file.data+h.dependenciesOffset, *end = file.data+file.size;
+	for (size_t i = 0; ok && i < h.nDependencies; i++) {
+		MeshBinDependency r;
+		ok = p+sizeof(r) <= end;
+		if (ok)
+			memcpy(&r, p, sizeof(r));
+		p += Align8(sizeof(r));
+		ok = ok && r.nameLength <= (size_t) (end-p) && r.modified == (long long) FileModified(string(p, r.nameLength).c_str());
+		p += ok? Align8(r.nameLength) : 0;
+	}
+	if (!ok) {
+		file.Close();
+		return false;
+	}
+	nPoints = (size_t) h.nPoints;
+	nNormals = (size_t) h.nNormals;
+	nUvs = (size_t) h.nUvs;
+	nTriangles = (size_t) h.nTriangles;
+	nQuads = (size_t) h.nQuads;
+	nGroups = (size_t) h.nGroups;
+	nMtls = (size_t) h.nMtls;
+	verticesOffset = (size_t) h.verticesOffset;
+	trianglesOffset = (size_t) h.trianglesOffset;
+	quadsOffset = (size_t) h.quadsOffset;
+	groupsOffset = (size_t) h.groupsOffset;
+	mtlsOffset = (size_t) h.mtlsOffset;
+	dependenciesOffset = (size_t) h.dependenciesOffset;
+	return true;
+}
+
+const char *MeshBin::Vertices() const { return file.data+verticesOffset; }
+
+size_t MeshBin::VerticesSize() const { return (nPoints+nNormals)*sizeof(vec3)+nUvs*sizeof(vec2); }
+
+const vec3 *MeshBin::Points() const { return (const vec3 *) Vertices(); }
+
+const vec3 *MeshBin::Normals() const { return Points()+nPoints; }
+
+const vec2 *MeshBin::Uvs() const { return (const vec2 *) (Normals()+nNormals); }
+
+const int3 *MeshBin::Triangles() const { return (const int3 *) (file.data+trianglesOffset); }
+
+const int4 *MeshBin::Quads() const { return (const int4 *) (file.data+quadsOffset); }
+
+void MeshBin::Get(vector<vec3> &points, vector<vec3> &normals, vector<vec2> &uvs, vector<int3> &triangles,
+				  vector<int4> &quads, vector<Group> &triangleGroups, vector<Mtl> &triangleMtls) const {
+	points.assign(Points(), Points()+nPoints);
+	normals.assign(Normals(), Normals()+nNormals);
+	uvs.assign(Uvs(), Uvs()+nUvs);
+	triangles.assign(Triangles(), Triangles()+nTriangles);
+	quads.assign(Quads(), Quads()+nQuads);
+	triangleGroups.resize(0);
+	triangleMtls.resize(0);
+	const char *p = file.data+groupsOffset, *end = file.data+mtlsOffset;
+	for (size_t i = 0; i < nGroups && p+sizeof(MeshBinGroup) <= end; i++) {
+		MeshBinGroup r;
+		memcpy(&r, p, sizeof(r));
+		p += Align8(sizeof(r));
+		if (p+r.nameLength > end)
+			break;
+		Group g(r.startTriangle, string(p, r.nameLength), r.color);
+		g.nTriangles = r.nTriangles;
+		triangleGroups.push_back(g);
+		p += Align8(r.nameLength);
+	}
+	p = file.data+mtlsOffset;
+	end = file.data+dependenciesOffset;
+	for (size_t i = 0; i < nMtls && p+sizeof(MeshBinMtl) <= end; i++) {
+		MeshBinMtl r;
+		memcpy(&r, p, sizeof(r));
+		p += Align8(sizeof(r));
+		if (p+Align8(r.nameLength)+r.mapKdLength > end)
+			break;
+		Mtl m(r.startTriangle, string(p, r.nameLength), r.ka, r.kd, r.ks);
+		m.nTriangles = r.nTriangles;
+		m.ns = r.ns;
+		m.d = r.d;
+		p += Align8(r.nameLength);
+		m.mapKd = string(p, r.mapKdLength);
+		p += Align8(r.mapKdLength);
+		triangleMtls.push_back(m);
+	}
+}
+
+bool WriteBinaryObj(const char    *filename,
+					vector<vec3>  &points,
+					vector<vec3>  &normals,
+					vector<vec2>  &uvs,
+					vector<int3>  *triangles,
+					vector<int4>  *quads,
+					vector<Group> *triangleGroups,
+					vector<Mtl>   *triangleMtls) {
+	vector<int3> noTriangles;
+	vector<int4> noQuads;
+	vector<Group> noGroups;
+	vector<Mtl> noMtls;
+	return WriteMeshBin(filename, 0, 0, points, normals, uvs, triangles? *triangles : noTriangles, quads? *quads : noQuads,
+						triangleGroups? *triangleGroups : noGroups, triangleMtls? *triangleMtls : noMtls);
+}
+
+bool ReadBinaryObj(const char    *filename,
+				   vector<vec3>  &points,
+				   vector<vec3>  &normals,
+				   vector<vec2>  &uvs,
+				   vector<int3>  &triangles,
+				   vector<int4>  *quads,
+				   vector<Group> *triangleGroups,
+				   vector<Mtl>   *triangleMtls) {
+	MeshBin bin;
+	if (!bin.Open(filename, 0, 0))
+		return false;
+	vector<int4> q;
+	vector<Group> g;
+	vector<Mtl> m;
+	bin.Get(points, normals, uvs, triangles, quads? *quads : q, triangleGroups? *triangleGroups : g, triangleMtls? *triangleMtls : m);
+	return true;
+}
+
+// glTF
+
+namespace {
+
+struct Json {
+	enum Type { IsNull, IsBool, IsNumber, IsString, IsArray, IsObject } type = IsNull;
+	double number = 0;				// also 1/0 for true/false
+	string text;
+	vector<string> keys;			// if Object
+	vector<Json> values;			// if Array or Object
+	const Json *Find(const char *key) const {
+		for (size_t i = 0; i < keys.size(); i++)
+			if (keys[i] == key)
+				return &values[i];
+		return NULL;
+	}
+	double Number(const char *key, double def = 0) const {
+		const Json *j = Find(key);
+		return j && j->type == IsNumber? j->number : def;
+	}
+	int Int(const char *key, int def = -1) const { return (int) Number(key, def); }
+	string Text(const char *key) const {
+		const Json *j = Find(key);
+		return j && j->type == IsString? j->text : string();
+	}
+	const vector<Json> &Items(const char *key) const {
+		// array elements, or empty
+		static const vector<Json> none;
+		const Json *j = Find(key);
+		return j && j->type == IsArray? j->values : none;
+	}
+};
+
+void SkipJsonSpace(const char *&c, const char *end) {
+	while (c < end && (*c == ' ' || *c == '\t' || *c == '\n' || *c == '\r'))
+		c++;
+}
+
+void PutUtf8(string &s, unsigned code) {
+	if (code < 0x80)
+		s += (char) code;
+	else if (code < 0x800) {
+		s += (char) (0xc0 | code >> 6);
+		s += (char) (0x80 | (code & 0x3f));
+	}
+	else if (code < 0x10000) {
+		s += (char) (0xe0 | code >> 12);
+		s += (char) (0x80 | (code >> 6 & 0x3f));
+		s += (char) (0x80 | (code & 0x3f));
+	}
+	else {
+		s += (char) (0xf0 | code >> 18);
+		s += (char) (0x80 | (code >> 12 & 0x3f));
+		s += (char) (0x80 | (code >> 6 & 0x3f));
+		s += (char) (0x80 | (code & 0x3f));
+	}
+}
+
+bool ParseJsonHex(const char *&c, const char *end, unsigned &code) {
+	if (end-c < 4)
+		return false;
+	code = 0;
+	for (int i = 0; i < 4; i++, c++) {
+		char h = *c | 0x20;
+		int d = h >= '0' && h <= '9'? h-'0' : h >= 'a' && h <= 'f'? h-'a'+10 : -1;
+		if (d < 0)
+			return false;
+		code = 16*code+d;
+	}
+	return true;
+}
+
+bool ParseJsonString(const char *&c, const char *end, string &s) {
+	// c at opening quote
+	for (c++; c < end && *c != '"'; c++) {
+		if (*c != '\\') {
+			s += *c;
+			continue;
+		}
+		if (++c >= end)
+			return false;
+		switch (*c) {
+			case 'b': s += '\b'; break;
+			case 'f': s += '\f'; break;
+			case 'n': s += '\n'; break;
+			case 'r': s += '\r'; break;
+			case 't': s += '\t'; break;
+			case 'u': {
+				unsigned code, low;
+				c++;
+				if (!ParseJsonHex(c, end, code))
+					return false;
+				if (code >= 0xd800 && code < 0xdc00 && end-c >= 6 && c[0] == '\\' && c[1] == 'u') {
+					const char *save = c;
+					c += 2;
+					if (ParseJsonHex(c, end, low) && low >= 0xdc00 && low < 0xe000)
+						code = 0x10000+((code-0xd800) << 10)+(low-0xdc00);
+					else
+						c = save;
+				}
+				PutUtf8(s, code);
+				c--;
+				break;
+			}
+			default: s += *c;	// quote, backslash, slash
+		}
+	}
+	if (c >= end)
+		return false;
+	c++;
+	return true;
+}
+
+bool ParseJson(const char *&c, const char *end, Json &j, int depth = 0) {
+	SkipJsonSpace(c, end);
+	if (c >= end || depth > 256)
+		return false;
+	if (*c == '{' || *c == '[') {
+		bool object = *c++ == '{';
+		char close = object? '}' : ']';
+		j.type = object? Json::IsObject : Json::IsArray;
+		SkipJsonSpace(c, end);
+		if (c < end && *c == close) {
+			c++;
+			return true;
+		}
+		for (;;) {
+			SkipJsonSpace(c, end);
+			if (object) {
+				j.keys.push_back(string());
+				if (c >= end || *c != '"' || !ParseJsonString(c, end, j.keys.back()))
+					return false;
+				SkipJsonSpace(c, end);
+				if (c >= end || *c++ != ':')
+					return false;
+			}
+			j.values.push_back(Json());
+			if (!ParseJson(c, end, j.values.back(), depth+1))
+				return false;
+			SkipJsonSpace(c, end);
+			if (c >= end)
+				return false;
+			if (*c == close) {
+				c++;
+				return true;
+			}
+			if (*c++ != ',')
+				return false;
+		}
+	}
+	if (*c == '"') {
+		j.type = Json::IsString;
+		return ParseJsonString(c, end, j.text);
+	}
+	const char *words[] = {"true", "false", "null"};
+	for (int i = 0; i < 3; i++) {
+		size_t n = strlen(words[i]);
+		if ((size_t) (end-c) >= n && !strncmp(c, words[i], n)) {
+			j.type = i < 2? Json::IsBool : Json::IsNull;
+			j.number = i == 0? 1 : 0;
+			c += n;
+			return true;
+		}
+	}
+	// number: copy to terminated buffer for strtod
+	char buf[64];
+	int n = 0;
+	while (c < end && n < 63 && (IsDigit(*c) || *c == '-' || *c == '+' || *c == '.' || *c == 'e' || *c == 'E'))
+		buf[n++] = *c++;
+	buf[n] = 0;
+	char *numEnd;
+	j.type = Json::IsNumber;
+	j.number = strtod(buf, &numEnd);
+	return n > 0 && numEnd == buf+n;
+}
+
+bool DecodeBase64(const char *c, const char *end, string &out) {
+	out.resize(0);
+	out.reserve(3*(end-c)/4);
+	unsigned bits = 0;
+	int nBits = 0;
+	for (; c < end && *c != '='; c++) {
+		char ch = *c;
+		int v = ch >= 'A' && ch <= 'Z'? ch-'A' : ch >= 'a' && ch <= 'z'? ch-'a'+26 : ch >= '0' && ch <= '9'? ch-'0'+52 :
+				ch == '+' || ch == '-'? 62 : ch == '/' || ch == '_'? 63 : -1;
+		if (v < 0)
+			return false;
+		bits = bits << 6 | v;
+		if ((nBits += 6) >= 8) {
+			nBits -= 8;
+			out += (char) (bits >> nBits & 0xff);
+		}
+	}
+	return true;
+}
+
+string DecodeUri(const string &uri) {
+	// undo percent-encoding
+	string s;
+	for (size_t i = 0; i < uri.size(); i++) {
+		if (uri[i] == '%' && i+2 < uri.size() && isxdigit((unsigned char) uri[i+1]) && isxdigit((unsigned char) uri[i+2])) {
+			s += (char) strtol(uri.substr(i+1, 2).c_str(), NULL, 16);
+			i += 2;
+		}
+		else
+			s += uri[i];
+	}
+	return s;
+}
+
+struct Span { const char *data = NULL; size_t size = 0; int stride = 0; };
+
+mat4 NodeMatrix(const Json &node) {
+	// glTF matrices are column-major; mat4 rows
+	mat4 m;
+	const vector<Json> &a = node.Items("matrix");
+	if (a.size() == 16) {
+		for (int i = 0; i < 4; i++)
+			for (int k = 0; k < 4; k++)
+				m[k][i] = (float) a[4*i+k].number;
+		return m;
+	}
+	const vector<Json> &t = node.Items("translation"), &r = node.Items("rotation"), &s = node.Items("scale");
+	if (r.size() == 4) {
+		float x = (float) r[0].number, y = (float) r[1].number, z = (float) r[2].number, w = (float) r[3].number;
+		m = mat4(vec4(1-2*(y*y+z*z), 2*(x*y-w*z), 2*(x*z+w*y), 0),
+				 vec4(2*(x*y+w*z), 1-2*(x*x+z*z), 2*(y*z-w*x), 0),
+				 vec4(2*(x*z-w*y), 2*(y*z+w*x), 1-2*(x*x+y*y), 0),
+				 vec4(0, 0, 0, 1));
+	}
+	if (s.size() == 3)
+		m = m*Scale((float) s[0].number, (float) s[1].number, (float) s[2].number);
+	if (t.size() == 3)
+		m = Translate((float) t[0].number, (float) t[1].number, (float) t[2].number)*m;
+	return m;
+}
+
+int GltfComponentSize(int componentType) {
+	return componentType == GL_BYTE || componentType == GL_UNSIGNED_BYTE? 1 :
+		   componentType == GL_SHORT || componentType == GL_UNSIGNED_SHORT? 2 :
+		   componentType == GL_UNSIGNED_INT || componentType == GL_FLOAT? 4 : 0;
+}
+
+template<class T> void GetComponents(const GltfAccessor &a, T *out) {
+	// convert count*nComponents components to T
+	size_t n = a.count;
+	int nc = a.nComponents;
+	if (!a.data) {
+		memset(out, 0, n*nc*sizeof(T));
+		return;
+	}
+	const char *e = a.data;
+	for (size_t i = 0; i < n; i++, e += a.stride)
+		for (int k = 0; k < nc; k++, out++) {
+			float f = 0, scale = 1;
+			switch (a.componentType) {
+				case GL_BYTE: f = (float) ((const signed char *) e)[k]; scale = 127; break;
+				case GL_UNSIGNED_BYTE: f = (float) ((const unsigned char *) e)[k]; scale = 255; break;
+				case GL_SHORT: { short v; memcpy(&v, e+2*k, 2); f = v; scale = 32767; break; }
+				case GL_UNSIGNED_SHORT: { unsigned short v; memcpy(&v, e+2*k, 2); f = v; scale = 65535; break; }
+				case GL_UNSIGNED_INT: {
+					unsigned v;
+					memcpy(&v, e+4*k, 4);
+					if (std::is_integral<T>::value) { *out = (T) v; continue; }	// exact, for indices
+					f = (float) v;
+					scale = 4294967295.f;
+					break;
+				}
+				case GL_FLOAT: memcpy(&f, e+4*k, 4); break;
+			}
+			if (a.normalized && a.componentType != GL_FLOAT) {
+				f /= scale;
+				if (f < -1) f = -1;
+			}
+			*out = (T) f;
+		}
+}
+
+bool ParseGltf(const Json &root, const vector<Span> &buffers, const string &directory, Gltf &g, vector<string> &decoded) {
+	// buffer views
+	const vector<Json> &jViews = root.Items("bufferViews");
+	vector<Span> views(jViews.size());
+	for (size_t i = 0; i < views.size(); i++) {
+		const Json &v = jViews[i];
+		int b = v.Int("buffer");
+		size_t offset = (size_t) v.Number("byteOffset"), length = (size_t) v.Number("byteLength");
+		if (b < 0 || b >= (int) buffers.size() || !buffers[b].data || offset+length > buffers[b].size) {
+			printf("Gltf: bad buffer view %i\n", (int) i);
+			return false;
+		}
+		views[i].data = buffers[b].data+offset;
+		views[i].size = length;
+		views[i].stride = v.Int("byteStride", 0);
+	}
+	// accessors
+	const vector<Json> &jAccessors = root.Items("accessors");
+	vector<GltfAccessor> accessors(jAccessors.size());
+	const char *types[] = {"SCALAR", "VEC2", "VEC3", "VEC4", "MAT2", "MAT3", "MAT4"};
+	const int nComponents[] = {1, 2, 3, 4, 4, 9, 16};
+	for (size_t i = 0; i < accessors.size(); i++) {
+		const Json &j = jAccessors[i];
+		GltfAccessor &a = accessors[i];
+		string type = j.Text("type");
+		for (int k = 0; k < 7; k++)
+			if (type == types[k])
+				a.nComponents = nComponents[k];
+		a.componentType = j.Int("componentType", 0);
+		a.count = (size_t) j.Number("count");
+		a.normalized = j.Number("normalized") != 0;
+		size_t elementSize = a.nComponents*GltfComponentSize(a.componentType);
+		int view = j.Int("bufferView");
+		if (!elementSize) {
+			printf("Gltf: bad accessor %i\n", (int) i);
+			return false;
+		}
+		a.stride = (int) elementSize;
+		if (view < 0 || j.Find("sparse"))
+			continue;
+		if (view >= (int) views.size()) {
+			printf("Gltf: bad accessor %i\n", (int) i);
+			return false;
+		}
+		const Span &v = views[view];
+		size_t offset = (size_t) j.Number("byteOffset");
+		if (v.stride)
+			a.stride = v.stride;
+		a.data = v.data+offset;
+		if (a.count && offset+(a.count-1)*a.stride+elementSize > v.size) {
+			printf("Gltf: accessor %i exceeds buffer view\n", (int) i);
+			return false;
+		}
+	}
+	auto Accessor = [&](const Json *j) {
+		int id = j && j->type == Json::IsNumber? (int) j->number : -1;
+		return id >= 0 && id < (int) accessors.size()? accessors[id] : GltfAccessor();
+	};
+	// meshes
+	const vector<Json> &jMeshes = root.Items("meshes");
+	g.meshes.resize(jMeshes.size());
+	for (size_t i = 0; i < jMeshes.size(); i++) {
+		g.meshes[i].name = jMeshes[i].Text("name");
+		const vector<Json> &jPrims = jMeshes[i].Items("primitives");
+		for (size_t k = 0; k < jPrims.size(); k++) {
+			const Json &jp = jPrims[k], *attributes = jp.Find("attributes");
+			GltfPrimitive p;
+			if (attributes) {
+				p.points = Accessor(attributes->Find("POSITION"));
+				p.normals = Accessor(attributes->Find("NORMAL"));
+				p.uvs = Accessor(attributes->Find("TEXCOORD_0"));
+			}
+			p.indices = Accessor(jp.Find("indices"));
+			p.mode = jp.Int("mode", 4);
+			p.material = jp.Int("material", -1);
+			g.meshes[i].primitives.push_back(p);
+		}
+	}
+	// images, textures, materials
+	const vector<Json> &jImages = root.Items("images");
+	g.images.resize(jImages.size());
+	for (size_t i = 0; i < jImages.size(); i++) {
+		const Json &j = jImages[i];
+		GltfImage &im = g.images[i];
+		im.name = j.Text("name");
+		im.mimeType = j.Text("mimeType");
+		int view = j.Int("bufferView");
+		string uri = j.Text("uri");
+		if (view >= 0 && view < (int) views.size()) {
+			im.data = (const unsigned char *) views[view].data;
+			im.size = views[view].size;
+		}
+		else if (!uri.compare(0, 5, "data:")) {
+			size_t comma = uri.find(";base64,");
+			decoded.push_back(string());
+			if (comma != string::npos && DecodeBase64(uri.c_str()+comma+8, uri.c_str()+uri.size(), decoded.back())) {
+				im.data = (const unsigned char *) decoded.back().data();
+				im.size = decoded.back().size();
+			}
+		}
+		else if (uri.size())
+			im.filename = directory+DecodeUri(uri);
+	}
+	const vector<Json> &jTextures = root.Items("textures");
+	const vector<Json> &jMaterials = root.Items("materials");
+	g.materials.resize(jMaterials.size());
+	for (size_t i = 0; i < jMaterials.size(); i++) {
+		GltfMaterial &m = g.materials[i];
+		m.name = jMaterials[i].Text("name");
+		const Json *pbr = jMaterials[i].Find("pbrMetallicRoughness");
+		if (!pbr)
+			continue;
+		const vector<Json> &c = pbr->Items("baseColorFactor");
+		if (c.size() == 4)
+			m.baseColor = vec4((float) c[0].number, (float) c[1].number, (float) c[2].number, (float) c[3].number);
+		const Json *t = pbr->Find("baseColorTexture");
+		int texture = t? t->Int("index") : -1;
+		if (texture >= 0 && texture < (int) jTextures.size()) {
+			int source = jTextures[texture].Int("source");
+			m.image = source < (int) g.images.size()? source : -1;
+		}
+	}
+	// nodes and scene
+	const vector<Json> &jNodes = root.Items("nodes");
+	g.nodes.resize(jNodes.size());
+	vector<bool> hasParent(jNodes.size(), false);
+	for (size_t i = 0; i < jNodes.size(); i++) {
+		const Json &j = jNodes[i];
+		GltfNode &n = g.nodes[i];
+		n.name = j.Text("name");
+		n.mesh = j.Int("mesh");
+		if (n.mesh >= (int) g.meshes.size())
+			n.mesh = -1;
+		n.matrix = NodeMatrix(j);
+		const vector<Json> &children = j.Items("children");
+		for (size_t k = 0; k < children.size(); k++) {
+			int c = (int) children[k].number;
+			if (c < 0 || c >= (int) jNodes.size() || c == (int) i || hasParent[c]) {
+				printf("Gltf: bad child of node %i\n", (int) i);
+				return false;
+			}
+			hasParent[c] = true;
+			n.children.push_back(c);
+		}
+	}
+	const vector<Json> &jScenes = root.Items("scenes");
+	int scene = root.Int("scene", 0);
+	if (scene >= 0 && scene < (int) jScenes.size()) {
+		const vector<Json> &ids = jScenes[scene].Items("nodes");
+		for (size_t k = 0; k < ids.size(); k++)
+			if (ids[k].number >= 0 && ids[k].number < jNodes.size() && !hasParent[(int) ids[k].number])
+				g.roots.push_back((int) ids[k].number);
+	}
+	else
+		for (size_t i = 0; i < jNodes.size(); i++)
+			if (!hasParent[i])
+				g.roots.push_back((int) i);
+	return true;
+}
+
+} // end namespace
+
+int GltfAccessor::ComponentSize() const { return GltfComponentSize(componentType); }
+
+size_t GltfAccessor::Size() const { return count? (count-1)*stride+nComponents*ComponentSize() : 0; }
+
+bool GltfAccessor::Get(vector<vec3> &v) const {
+	if (nComponents != 3)
+		return false;
+	v.resize(count);
+	if (data && componentType == GL_FLOAT && Packed())
+		memcpy(v.data(), data, count*sizeof(vec3));
+	else
+		GetComponents(*this, (float *) v.data());
+	return true;
+}
+
+bool GltfAccessor::Get(vector<vec2> &v) const {
+	if (nComponents != 2)
+		return false;
+	v.resize(count);
+	if (data && componentType == GL_FLOAT && Packed())
+		memcpy(v.data(), data, count*sizeof(vec2));
+	else
+		GetComponents(*this, (float *) v.data());
+	return true;
+}
+
+bool GltfAccessor::Get(vector<int> &v) const {
+	if (nComponents != 1)
+		return false;
+	v.resize(count);
+	if (data && componentType == GL_UNSIGNED_INT && Packed())
+		memcpy(v.data(), data, count*sizeof(int));
+	else
+		GetComponents(*this, v.data());
+	return true;
+}
+
+bool Gltf::Open(const char *filename) {
+	Close();
+	if (!file.Open(filename)) {
+		printf("Gltf: can't open %s\n", filename);
+		return false;
+	}
+	string name(filename), directory;
+	size_t slash = name.find_last_of("/\\");
+	if (slash != string::npos)
+		directory = name.substr(0, slash+1);
+	// GLB: 12-byte header, JSON chunk, optional BIN chunk
+	const char *json = file.data, *jsonEnd = file.data+file.size;
+	Span bin;
+	if (file.size >= 20 && !strncmp(file.data, "glTF", 4)) {
+		unsigned header[3], chunk[2];
+		memcpy(header, file.data, 12);
+		size_t length = header[2] < file.size? header[2] : file.size;
+		for (size_t offset = 12; offset+8 <= length; ) {
+			memcpy(chunk, file.data+offset, 8);
+			const char *chunkData = file.data+offset+8;
+			if (chunk[0] > length-offset-8)
+				break;
+			if (chunk[1] == 0x4e4f534a && offset == 12) {		// "JSON"
+				json = chunkData;
+				jsonEnd = chunkData+chunk[0];
+			}
+			if (chunk[1] == 0x004e4942 && !bin.data) {			// "BIN"
+				bin.data = chunkData;
+				bin.size = chunk[0];
+			}
+			offset += 8+((chunk[0]+3) & ~3u);
+		}
+		if (json == file.data) {
+			printf("Gltf: %s has no JSON chunk\n", filename);
+			Close();
+			return false;
+		}
+	}
+	Json root;
+	if (!ParseJson(json, jsonEnd, root) || root.type != Json::IsObject) {
+		printf("Gltf: %s has malformed JSON\n", filename);
+		Close();
+		return false;
+	}
+	// buffers: GLB binary chunk, data: uri, or external file
+	const vector<Json> &jBuffers = root.Items("buffers");
+	vector<Span> buffers(jBuffers.size());
+	decoded.reserve(jBuffers.size()+root.Items("images").size());	// keep pointers to decoded data valid
+	for (size_t i = 0; i < jBuffers.size(); i++) {
+		string uri = jBuffers[i].Text("uri");
+		Span &b = buffers[i];
+		if (uri.empty())
+			b = i == 0? bin : Span();
+		else if (!uri.compare(0, 5, "data:")) {
+			size_t comma = uri.find(";base64,");
+			decoded.push_back(string());
+			if (comma != string::npos && DecodeBase64(uri.c_str()+comma+8, uri.c_str()+uri.size(), decoded.back())) {
+				b.data = decoded.back().data();
+				b.size = decoded.back().size();
+			}
+		}
+		else {
+			MappedFile *f = new MappedFile;
+			externals.push_back(f);
+			if (f->Open((directory+DecodeUri(uri)).c_str())) {
+				b.data = f->data;
+				b.size = f->size;
+			}
+		}
+		size_t declared = (size_t) jBuffers[i].Number("byteLength");
+		if (b.data && b.size > declared)
+			b.size = declared;
+	}
+	if (!ParseGltf(root, buffers, directory, *this, decoded)) {
+		printf("Gltf: can't read %s\n", filename);
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void Gltf::Close() {
+	meshes.resize(0);
+	materials.resize(0);
+	images.resize(0);
+	nodes.resize(0);
+	roots.resize(0);
+	for (size_t i = 0; i < externals.size(); i++)
+		delete externals[i];
+	externals.resize(0);
+	decoded.resize(0);
+	file.Close();
+}
@@ -0,0 +1,372 @@
+// Kernels.cpp - bulk geometry with SSE and AVX2 paths, scalar fallback
+// points are read and written in place as arrays of vec3: each group of four (SSE) or eight (AVX2) points
+// is loaded with three (or six) unaligned loads and shuffled to x, y, z registers, then shuffled back to store
+// each path performs the same float operations in the same order, so results do not depend on the path
+
+#include <float.h>
+#include <algorithm>
+#include "Kernels.h"
+#include "Parallel.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+	#define KERNELS_X86		// SSE2 always present
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define TARGET_AVX2
+	#else
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+// Run-time Selection
+
+namespace {
+
+SimdLevel Supported() {
+#ifdef KERNELS_X86
+  #ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	int nIds = info[0];
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+	if (nIds >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+		__cpuidex(info, 7, 0);
+		if (info[1] & (1 << 5))
+			return SimdAVX2;
+	}
+  #else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return SimdAVX2;
+  #endif
+	return SimdSSE;
+#endif
+	return SimdScalar;
+}
+
+SimdLevel &Level() {
+	static SimdLevel level = Supported();
+	return level;
+}
+
+} // end namespace
+
+SimdLevel Simd() { return Level(); }
+
+void SetSimd(SimdLevel level) {
+	SimdLevel supported = Supported();
+	Level() = level < supported? level : supported;
+}
+
+// Kernels
+
+namespace {
+
+enum Op { OpPoints, OpVectors, OpUnitVectors };
+
+void TransformScalar(const vec3 *in, vec3 *out, int n, const mat4 &m, Op op) {
+	for (int i = 0; i < n; i++) {
+		float x = in[i].x, y = in[i].y, z = in[i].z;
+		float tx = m[0][0]*x+m[0][1]*y+m[0][2]*z, ty = m[1][0]*x+m[1][1]*y+m[1][2]*z, tz = m[2][0]*x+m[2][1]*y+m[2][2]*z;
+		if (op == OpPoints) {
+			tx = tx+m[0][3];
+			ty = ty+m[1][3];
+			tz = tz+m[2][3];
+		}
+		if (op == OpUnitVectors) {
+			float l = sqrt(tx*tx+ty*ty+tz*tz), r = l > 0? 1.f/l : 0;
+			tx = tx*r;
+			ty = ty*r;
+			tz = tz*r;
+		}
+		out[i] = vec3(tx, ty, tz);
+	}
+}
+
+void MinMaxScalar(const vec3 *points, int n, vec3 &min, vec3 &max) {
+	for (int i = 0; i < n; i++) {
+		const vec3 &p = points[i];
+		for (int k = 0; k < 3; k++) {
+			min[k] = min[k] < p[k]? min[k] : p[k];
+			max[k] = max[k] > p[k]? max[k] : p[k];
+		}
+	}
+}
+
+void ScaleOffsetScalar(vec3 *points, int n, vec3 s, vec3 o) {
+	for (int i = 0; i < n; i++)
+		points[i] = vec3(points[i].x*s.x+o.x, points[i].y*s.y+o.y, points[i].z*s.z+o.z);
+}
+
+#ifdef KERNELS_X86
+
+// SSE: four points per iteration
+
+inline void Load4(const float *p, __m128 &x, __m128 &y, __m128 &z) {
+	// x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3 to x0 x1 x2 x3, y0.., z0..
+	__m128 m0 = _mm_loadu_ps(p), m1 = _mm_loadu_ps(p+4), m2 = _mm_loadu_ps(p+8);
+	__m128 xy = _mm_shuffle_ps(m1, m2, _MM_SHUFFLE(2, 1, 3, 2));	// x2 y2 x3 y3
+	__m128 yz = _mm_shuffle_ps(m0, m1, _MM_SHUFFLE(1, 0, 2, 1));	// y0 z0 y1 z1
+	x = _mm_shuffle_ps(m0, xy, _MM_SHUFFLE(2, 0, 3, 0));
+	y = _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+	z = _mm_shuffle_ps(yz, m2, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+inline void Store4(float *p, __m128 x, __m128 y, __m128 z) {
+	__m128 xy = _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));	// x0 x2 y0 y2
+	__m128 yz = _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));	// y1 y3 z1 z3
+	__m128 zx = _mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));	// z0 z2 x1 x3
+	_mm_storeu_ps(p, _mm_shuffle_ps(xy, zx, _MM_SHUFFLE(2, 0, 2, 0)));
+	_mm_storeu_ps(p+4, _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0)));
+	_mm_storeu_ps(p+8, _mm_shuffle_ps(zx, yz, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+int TransformSSE(const vec3 *in, vec3 *out, int n, const mat4 &m, Op op) {
+	// return # points transformed (a multiple of four)
+	__m128 r[3][4];
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 4; j++)
+			r[i][j] = _mm_set1_ps(m[i][j]);
+	__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1);
+	int n4 = n & ~3;
+	for (int i = 0; i < n4; i += 4) {
+		__m128 x, y, z, t[3];
+		Load4((const float *) (in+i), x, y, z);
+		for (int k = 0; k < 3; k++) {
+			t[k] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[k][0], x), _mm_mul_ps(r[k][1], y)), _mm_mul_ps(r[k][2], z));
+			if (op == OpPoints)
+				t[k] = _mm_add_ps(t[k], r[k][3]);
+		}
+		if (op == OpUnitVectors) {
+			__m128 l = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(t[0], t[0]), _mm_mul_ps(t[1], t[1])), _mm_mul_ps(t[2], t[2])));
+			__m128 s = _mm_and_ps(_mm_div_ps(one, l), _mm_cmpgt_ps(l, zero));
+			for (int k = 0; k < 3; k++)
+				t[k] = _mm_mul_ps(t[k], s);
+		}
+		Store4((float *) (out+i), t[0], t[1], t[2]);
+	}
+	return n4;
+}
+
+int MinMaxSSE(const vec3 *points, int n, vec3 &min, vec3 &max) {
+	__m128 lo[3], hi[3];
+	for (int k = 0; k < 3; k++) {
+		lo[k] = _mm_set1_ps(min[k]);
+		hi[k] = _mm_set1_ps(max[k]);
+	}
+	int n4 = n & ~3;
+	for (int i = 0; i < n4; i += 4) {
+		__m128 p[3];
+		Load4((const float *) (points+i), p[0], p[1], p[2]);
+		for (int k = 0; k < 3; k++) {
+			lo[k] = _mm_min_ps(lo[k], p[k]);
+			hi[k] = _mm_max_ps(hi[k], p[k]);
+		}
+	}
+	float l[4], h[4];
+	for (int k = 0; k < 3; k++) {
+		_mm_storeu_ps(l, lo[k]);
+		_mm_storeu_ps(h, hi[k]);
+		for (int j = 0; j < 4; j++) {
+			min[k] = min[k] < l[j]? min[k] : l[j];
+			max[k] = max[k] > h[j]? max[k] : h[j];
+		}
+	}
+	return n4;
+}
+
+int ScaleOffsetSSE(vec3 *points, int n, vec3 s, vec3 o) {
+	__m128 scale[3] = {_mm_set1_ps(s.x), _mm_set1_ps(s.y), _mm_set1_ps(s.z)};
+	__m128 offset[3] = {_mm_set1_ps(o.x), _mm_set1_ps(o.y), _mm_set1_ps(o.z)};
+	int n4 = n & ~3;
+	for (int i = 0; i < n4; i += 4) {
+		__m128 p[3];
+		Load4((const float *) (points+i), p[0], p[1], p[2]);
+		for (int k = 0; k < 3; k++)
+			p[k] = _mm_add_ps(_mm_mul_ps(p[k], scale[k]), offset[k]);
+		Store4((float *) (points+i), p[0], p[1], p[2]);
+	}
+	return n4;
+}
+
+// AVX2: eight points per iteration, as two groups of four in the 128-bit lanes
+
+TARGET_AVX2 inline void Load8(const float *p, __m256 &x, __m256 &y, __m256 &z) {
+	__m256 m0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p+12), 1);
+	__m256 m1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p+4)), _mm_loadu_ps(p+16), 1);
+	__m256 m2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p+8)), _mm_loadu_ps(p+20), 1);
+	__m256 xy = _mm256_shuffle_ps(m1, m2, _MM_SHUFFLE(2, 1, 3, 2));
+	__m256 yz = _mm256_shuffle_ps(m0, m1, _MM_SHUFFLE(1, 0, 2, 1));
+	x = _mm256_shuffle_ps(m0, xy, _MM_SHUFFLE(2, 0, 3, 0));
+	y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+	z = _mm256_shuffle_ps(yz, m2, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+TARGET_AVX2 inline void Store8(float *p, __m256 x, __m256 y, __m256 z) {
+	__m256 xy = _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+	__m256 yz = _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));
+	__m256 zx = _mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));
+	__m256 r0 = _mm256_shuffle_ps(xy, zx, _MM_SHUFFLE(2, 0, 2, 0));
+	__m256 r1 = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+	__m256 r2 = _mm256_shuffle_ps(zx, yz, _MM_SHUFFLE(3, 1, 3, 1));
+	_mm_storeu_ps(p, _mm256_castps256_ps128(r0));
+	_mm_storeu_ps(p+4, _mm256_castps256_ps128(r1));
+	_mm_storeu_ps(p+8, _mm256_castps256_ps128(r2));
+	_mm_storeu_ps(p+12, _mm256_extractf128_ps(r0, 1));
+	_mm_storeu_ps(p+16, _mm256_extractf128_ps(r1, 1));
+	_mm_storeu_ps(p+20, _mm256_extractf128_ps(r2, 1));
+}
+
+TARGET_AVX2 int TransformAVX2(const vec3 *in, vec3 *out, int n, const mat4 &m, Op op) {
+	__m256 r[3][4];
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 4; j++)
+			r[i][j] = _mm256_set1_ps(m[i][j]);
+	__m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1);
+	int n8 = n & ~7;
+	for (int i = 0; i < n8; i += 8) {
+		__m256 x, y, z, t[3];
+		Load8((const float *) (in+i), x, y, z);
+		for (int k = 0; k < 3; k++) {
+			t[k] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[k][0], x), _mm256_mul_ps(r[k][1], y)), _mm256_mul_ps(r[k][2], z));
+			if (op == OpPoints)
+				t[k] = _mm256_add_ps(t[k], r[k][3]);
+		}
+		if (op == OpUnitVectors) {
+			__m256 l = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(t[0], t[0]), _mm256_mul_ps(t[1], t[1])), _mm256_mul_ps(t[2], t[2])));
+			__m256 s = _mm256_and_ps(_mm256_div_ps(one, l), _mm256_cmp_ps(l, zero, _CMP_GT_OQ));
+			for (int k = 0; k < 3; k++)
+				t[k] = _mm256_mul_ps(t[k], s);
+		}
+		Store8((float *) (out+i), t[0], t[1], t[2]);
+	}
+	return n8;
+}
+
+TARGET_AVX2 int MinMaxAVX2(const vec3 *points, int n, vec3 &min, vec3 &max) {
+	__m256 lo[3], hi[3];
+	for (int k = 0; k < 3; k++) {
+		lo[k] = _mm256_set1_ps(min[k]);
+		hi[k] = _mm256_set1_ps(max[k]);
+	}
+	int n8 = n & ~7;
+	for (int i = 0; i < n8; i += 8) {
+		__m256 p[3];
+		Load8((const float *) (points+i), p[0], p[1], p[2]);
+		for (int k = 0; k < 3; k++) {
+			lo[k] = _mm256_min_ps(lo[k], p[k]);
+			hi[k] = _mm256_max_ps(hi[k], p[k]);
+		}
+	}
+	float l[8], h[8];
+	for (int k = 0; k < 3; k++) {
+		_mm256_storeu_ps(l, lo[k]);
+		_mm256_storeu_ps(h, hi[k]);
+		for (int j = 0; j < 8; j++) {
+			min[k] = min[k] < l[j]? min[k] : l[j];
+			max[k] = max[k] > h[j]? max[k] : h[j];
+		}
+	}
+	return n8;
+}
+
+TARGET_AVX2 int ScaleOffsetAVX2(vec3 *points, int n, vec3 s, vec3 o) {
+	__m256 scale[3] = {_mm256_set1_ps(s.x), _mm256_set1_ps(s.y), _mm256_set1_ps(s.z)};
+	__m256 offset[3] = {_mm256_set1_ps(o.x), _mm256_set1_ps(o.y), _mm256_set1_ps(o.z)};
+	int n8 = n & ~7;
+	for (int i = 0; i < n8; i += 8) {
+		__m256 p[3];
+		Load8((const float *) (points+i), p[0], p[1], p[2]);
+		for (int k = 0; k < 3; k++)
+			p[k] = _mm256_add_ps(_mm256_mul_ps(p[k], scale[k]), offset[k]);
+		Store8((float *) (points+i), p[0], p[1], p[2]);
+	}
+	return n8;
+}
+
+#endif // KERNELS_X86
+
+void Transform(const vec3 *in, vec3 *out, int n, const mat4 &m, Op op) {
+	int done = 0;
+#ifdef KERNELS_X86
+	SimdLevel level = Simd();
+	done = level == SimdAVX2? TransformAVX2(in, out, n, m, op) : level == SimdSSE? TransformSSE(in, out, n, m, op) : 0;
+#endif
+	TransformScalar(in+done, out+done, n-done, m, op);
+}
+
+void Bound(const vec3 *points, int n, vec3 &min, vec3 &max) {
+	int done = 0;
+#ifdef KERNELS_X86
+	SimdLevel level = Simd();
+	done = level == SimdAVX2? MinMaxAVX2(points, n, min, max) : level == SimdSSE? MinMaxSSE(points, n, min, max) : 0;
+#endif
+	MinMaxScalar(points+done, n-done, min, max);
+}
+
+void Affine(vec3 *points, int n, vec3 s, vec3 o) {
+	int done = 0;
+#ifdef KERNELS_X86
+	SimdLevel level = Simd();
+	done = level == SimdAVX2? ScaleOffsetAVX2(points, n, s, o) : level == SimdSSE? ScaleOffsetSSE(points, n, s, o) : 0;
+#endif
+	ScaleOffsetScalar(points+done, n-done, s, o);
+}
+
+// Threads
+
+const int blockSize = 1 << 16;	// points per task
+
+int Blocks(int n, int &nThreads) {
+	// # blocks, and threads for them: one thread (by default) unless several blocks per core
+	int nBlocks = (n+blockSize-1)/blockSize;
+	if (nThreads <= 0)
+		nThreads = nBlocks >= 4? NumThreads() : 1;
+	return nBlocks;
+}
+
+} // end namespace
+
+// Public
+
+void TransformPoints(const vec3 *in, vec3 *out, int n, const mat4 &m, int nThreads) {
+	int nBlocks = Blocks(n, nThreads);
+	ParallelFor(nBlocks, [&](int b) {
+		int start = b*blockSize;
+		Transform(in+start, out+start, std::min(blockSize, n-start), m, OpPoints);
+	}, nThreads);
+}
+
+void TransformVectors(const vec3 *in, vec3 *out, int n, const mat4 &m, bool unitLength, int nThreads) {
+	int nBlocks = Blocks(n, nThreads);
+	ParallelFor(nBlocks, [&](int b) {
+		int start = b*blockSize;
+		Transform(in+start, out+start, std::min(blockSize, n-start), m, unitLength? OpUnitVectors : OpVectors);
+	}, nThreads);
+}
+
+void MinMax(const vec3 *points, int n, vec3 &min, vec3 &max, int nThreads) {
+	int nBlocks = Blocks(n, nThreads);
+	std::vector<vec3> mins(nBlocks, vec3(FLT_MAX)), maxs(nBlocks, vec3(-FLT_MAX));
+	ParallelFor(nBlocks, [&](int b) {
+		int start = b*blockSize;
+		Bound(points+start, std::min(blockSize, n-start), mins[b], maxs[b]);
+	}, nThreads);
+	min = vec3(FLT_MAX);
+	max = vec3(-FLT_MAX);
+	for (int b = 0; b < nBlocks; b++)
+		for (int k = 0; k < 3; k++) {
+			min[k] = min[k] < mins[b][k]? min[k] : mins[b][k];
+			max[k] = max[k] > maxs[b][k]? max[k] : maxs[b][k];
+		}
+}
+
+void ScaleOffset(vec3 *points, int n, vec3 scale, vec3 offset, int nThreads) {
+	int nBlocks = Blocks(n, nThreads);
+	ParallelFor(nBlocks, [&](int b) {
+		int start = b*blockSize;
+		Affine(points+start, std::min(blockSize, n-start), scale, offset);
+	}, nThreads);
+}
@@ -4,6 +4,11 @@
 #include "Draw.h"
 #include "Misc.h"
 #include "Mesh.h"
+#include "Int3Map.h"
+#include "Kernels.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <chrono>
 
 namespace {
 
@@ -23,12 +28,19 @@ const char *meshVertexShader = R"(
 	out vec2 vUv;
 //	out vec3 vColor;
 	uniform bool useInstance = false;
+	uniform bool octNormals = false;		// normal.xy octahedral-encoded (compact layout)
 	uniform mat4 modelview;
 	uniform mat4 persp;
+	vec3 OctDecode(vec2 e) {
+		vec3 n = vec3(e, 1-abs(e.x)-abs(e.y));
+		if (n.z < 0)
+			n.xy = (1-abs(n.yx))*vec2(n.x >= 0? 1 : -1, n.y >= 0? 1 : -1);
+		return normalize(n);
+	}
 	void main() {
 		mat4 m = useInstance? modelview*instance : modelview;
 		vPoint = (m*vec4(point, 1)).xyz;
-		vNormal = (m*vec4(normal, 0)).xyz;
+		vNormal = (m*vec4(octNormals? OctDecode(normal.xy) : normal, 0)).xyz;
 		gl_Position = persp*vec4(vPoint, 1);
 		vUv = uv;
 //		vColor = color;
@@ -65,6 +77,7 @@ const char *meshGeometryShader = R"(
 			gNormal = vNormal[i];
 			gUv = vUv[i];
 			gl_Position = gl_in[i].gl_Position;
+			gl_PrimitiveID = gl_PrimitiveIDIn;
 			EmitVertex();
 		}
 		EndPrimitive();
@@ -93,6 +106,19 @@ const char *meshPixelShaderLines = R"(
 	uniform float outlineWidth = 1;
 	uniform float outlineTransition = 1;
 	out vec4 pColor;
+	struct Material { vec4 ka, kd, ks; ivec4 range; };	// kd.w: opacity, ks.w: shininess, range.x: start triangle
+	layout (std140) uniform Materials { Material mtls[256]; };
+	uniform bool useMaterial = false;
+	uniform int nMtls = 0, firstTriangle = 0;
+	Material FindMaterial() {
+		// binary search for material containing current triangle
+		int t = firstTriangle+gl_PrimitiveID, lo = 0, hi = nMtls-1;
+		while (lo < hi) {
+			int mid = (lo+hi+1)/2;
+			if (mtls[mid].range.x <= t) lo = mid; else hi = mid-1;
+		}
+		return mtls[lo];
+	}
 	float Intensity(vec3 normalV, vec3 eyeV, vec3 point, vec3 light) {
 		vec3 lightV = normalize(light-point);		// light vector
 		vec3 reflectV = reflect(lightV, normalV);   // highlight vector
@@ -114,16 +140,23 @@ const char *meshPixelShaderLines = R"(
 					intensity += Intensity(N, E, gPoint, lights[i]);
 		}
 		intensity = clamp(intensity, 0, 1);
+		vec3 c = color;
+		float o = opacity;
+		if (useMaterial) {
+			Material m = FindMaterial();
+			c = m.kd.rgb;
+			o = m.kd.w;
+		}
 		if (useTexture) {
-			pColor = vec4(intensity*texture(textureImage, gUv).rgb, opacity);
-			if (useTint) {
-				pColor.r *= color.r;
-				pColor.g *= color.g;
-				pColor.b *= color.b;
+			pColor = vec4(intensity*texture(textureImage, gUv).rgb, o);
+			if (useTint || useMaterial) {
+				pColor.r *= c.r;
+				pColor.g *= c.g;
+				pColor.b *= c.b;
 			}
 		}
 		else
-			pColor = vec4(intensity*color, opacity);
+			pColor = vec4(intensity*c, o);
 		float minDist = min(gEdgeDistance.x, gEdgeDistance.y);
 		minDist = min(minDist, gEdgeDistance.z);
 		float t = smoothstep(outlineWidth-outlineTransition, outlineWidth+outlineTransition, minDist);
@@ -153,6 +186,20 @@ const char *meshPixelShaderNoLines = R"(
 	uniform float amb = .1, dif = .7, spc =.7;		// ambient, diffuse, specular
 	out vec4 pColor;
 	float d = 0, s = 0;								// diffuse, specular terms
+	float shininess = 50;
+	struct Material { vec4 ka, kd, ks; ivec4 range; };	// kd.w: opacity, ks.w: shininess, range.x: start triangle
+	layout (std140) uniform Materials { Material mtls[256]; };
+	uniform bool useMaterial = false;
+	uniform int nMtls = 0, firstTriangle = 0;
+	Material FindMaterial() {
+		// binary search for material containing current triangle
+		int t = firstTriangle+gl_PrimitiveID, lo = 0, hi = nMtls-1;
+		while (lo < hi) {
+			int mid = (lo+hi+1)/2;
+			if (mtls[mid].range.x <= t) lo = mid; else hi = mid-1;
+		}
+		return mtls[lo];
+	}
 	vec3 N, E;
 	void Intensity(vec3 light) {
 		vec3 L = normalize(light-vPoint);
@@ -163,7 +210,7 @@ const char *meshPixelShaderNoLines = R"(
 			d += abs(dd);
 			vec3 R = reflect(L, N);					// highlight vector
 			float h = max(0, dot(R, E));			// highlight term
-			s += pow(h, 50);						// specular term
+			s += pow(h, shininess);					// specular term
 		}
 	}
 	void main() {
@@ -171,6 +218,11 @@ const char *meshPixelShaderNoLines = R"(
 		if (fwdFacingOnly && N.z < 0)
 			discard;
 		E = normalize(vPoint);						// eye vector
+		Material m;
+		if (useMaterial) {
+			m = FindMaterial();
+			shininess = m.ks.w > 0? m.ks.w : 50;
+		}
 		float ads = useLight? 0 : 1;
 		if (useLight) {
 			if (nLights == 0)
@@ -180,7 +232,12 @@ const char *meshPixelShaderNoLines = R"(
 					Intensity(lights[i]);
 			ads = clamp(amb+dif*d, 0, 1)+spc*s;
 		}
-		if (useTexture) {
+		if (useMaterial) {
+			vec3 kd = useTexture? m.kd.rgb*texture(textureImage, vUv).rgb : m.kd.rgb;
+			vec3 rgb = useLight? clamp(amb*(kd+m.ka.rgb)+dif*d*kd, 0, 1)+s*m.ks.rgb : kd;
+			pColor = vec4(rgb, m.kd.w);
+		}
+		else if (useTexture) {
 			pColor = vec4(ads*texture(textureImage, vUv).rgb, opacity);
 			if (useTint) {
 				pColor.r *= color.r;
@@ -193,17 +250,33 @@ const char *meshPixelShaderNoLines = R"(
 	}
 )";
 
+const int maxMtls = 256;			// size of Materials uniform block array
+const GLuint mtlBinding = 0;		// uniform buffer binding point for Materials
+
+struct MtlParams { vec4 ka, kd, ks; int range[4]; };	// std140 layout of shader Material
+
+GLuint BindMaterials(GLuint program) {
+	GLuint block = glGetUniformBlockIndex(program, "Materials");
+	if (block != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, block, mtlBinding);
+	return program;
+}
+
+// set per mesh by Display: skip uploads of unchanged values (eg, persp)
+Uniform<mat4> meshModelview("modelview"), meshPersp("persp");
+Uniform<bool> meshOctNormals("octNormals");
+
 } // end namespace
 
 GLuint GetMeshShader(bool lines) {
 	if (lines) {
 		if (!meshShaderLines)
-			meshShaderLines = LinkProgramViaCode(&meshVertexShader, NULL, NULL, &meshGeometryShader, &meshPixelShaderLines);
+			meshShaderLines = BindMaterials(LinkProgramViaCode(&meshVertexShader, NULL, NULL, &meshGeometryShader, &meshPixelShaderLines));
 		return meshShaderLines;
 	}
 	else {
 		if (!meshShaderNoLines)
-			meshShaderNoLines = LinkProgramViaCode(&meshVertexShader, &meshPixelShaderNoLines);
+			meshShaderNoLines = BindMaterials(LinkProgramViaCode(&meshVertexShader, &meshPixelShaderNoLines));
 		return meshShaderNoLines;
 	}
 }
@@ -227,7 +300,7 @@ bool Mesh::SetWrtParent() {
 	// set wrtParent: toWorld = parent.toWorld*wrtParent
 	if (parent != NULL) {
 		mat4 inv;
-		if (!InverseMatrix4x4((float *) &parent->toWorld, (float *) &inv))
+		if (!InvertAffine(parent->toWorld, inv))
 			return false;
 		wrtParent = inv*toWorld;
 	}
@@ -251,28 +324,79 @@ void Mesh::Display(Camera camera, int textureUnit, bool lines, bool useGroupColo
 		SetUniform(shader, "textureImage", textureUnit); // but app can unset useTexture
 	}
 	// set matrices
-	SetUniform(shader, "modelview", camera.modelview*toWorld);
-	SetUniform(shader, "persp", camera.persp);
+	meshModelview.Set(shader, camera.modelview*toWorld*dequantize);
+	meshPersp.Set(shader, camera.persp);
+	meshOctNormals.Set(shader, octNormals);
 	if (lines)
 		SetUniform(shader, "vp", Viewport());
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eBufferId);
+	int width, height, lod = 0;
+	if (lods.size()) {
+		ViewportSize(width, height);
+		lod = SelectLod(camera, height);
+	}
+	vector<char> visible;
+	if (!lod && meshlets.size())
+		CullMeshlets(camera, visible);
+	auto Draw = [&](int start, int n) { DrawTriangles(lod, start, n, visible.size()? &visible : NULL); };
 	if (useGroupColor) {
 		int textureSet = 0;
 		glGetUniformiv(shader, glGetUniformLocation(shader, "useTexture"), &textureSet);
 		// show ungrouped triangles without texture mapping
 		int nGroups = triangleGroups.size(), nUngrouped = nGroups? triangleGroups[0].startTriangle : nTris;
 		SetUniform(shader, "useTexture", false);
-		glDrawElements(GL_TRIANGLES, 3*nUngrouped, GL_UNSIGNED_INT, 0); // triangles.data());
+		Draw(0, nUngrouped);
 		// show grouped triangles with texture mapping
 		SetUniform(shader, "useTexture", textureSet == 1);
 		for (int i = 0; i < nGroups; i++) {
 			Group g = triangleGroups[i];
 			SetUniform(shader, "color", g.color);
-			glDrawElements(GL_TRIANGLES, 3*g.nTriangles, GL_UNSIGNED_INT, (void *) (3*g.startTriangle*sizeof(int)));
+			Draw(g.startTriangle, g.nTriangles);
+		}
+	}
+	else if (mtlBatches.size()) {
+		// triangles preceding first material as usual, then one draw per texture map
+		int nPreceding = mtlBatches[0].startTriangle;
+		Draw(0, nPreceding);
+		glBindBufferBase(GL_UNIFORM_BUFFER, mtlBinding, mtlBuffer);
+		SetUniform(shader, "useMaterial", true);
+		SetUniform(shader, "nMtls", (int) triangleMtls.size());
+		int unit = textureUnit >= 0? textureUnit : 0;
+		glActiveTexture(GL_TEXTURE0+unit);
+		SetUniform(shader, "textureImage", unit);
+		for (size_t i = 0; i < mtlBatches.size(); i++) {
+			MtlBatch &b = mtlBatches[i];
+			SetUniform(shader, "useTexture", b.textureName > 0);
+			glBindTexture(GL_TEXTURE_2D, b.textureName);
+			if (!lod && visible.empty()) {
+				SetUniform(shader, "firstTriangle", b.startTriangle);
+				Draw(b.startTriangle, b.nTriangles);
+			}
+			else
+				// gl_PrimitiveID restarts with each coarser level or visible meshlet run, but the triangles
+				// drawn for a material are no more than at full resolution, so firstTriangle+gl_PrimitiveID
+				// stays within its range and finds its parameters
+				for (Mtl &m : triangleMtls)
+					if (m.startTriangle >= b.startTriangle && m.startTriangle < b.startTriangle+b.nTriangles) {
+						SetUniform(shader, "firstTriangle", m.startTriangle);
+						Draw(m.startTriangle, m.nTriangles);
+					}
+		}
+		SetUniform(shader, "useMaterial", false);
+		SetUniform(shader, "useTexture", useTexture);
+#ifdef GL_QUADS
+		// quads are not in material batches; draw as without materials
+		if (useTexture) {
+			glActiveTexture(GL_TEXTURE0+textureUnit);
+			glBindTexture(GL_TEXTURE_2D, textureName);
+			SetUniform(shader, "textureImage", textureUnit);
 		}
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		glDrawElements(GL_QUADS, 4*nQuads, GL_UNSIGNED_INT, quads.data());
+#endif
 	}
 	else {
-		glDrawElements(GL_TRIANGLES, 3*nTris, GL_UNSIGNED_INT, 0);
+		Draw(0, (int) nTris);
 #ifdef GL_QUADS
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 		glDrawElements(GL_QUADS, 4*nQuads, GL_UNSIGNED_INT, quads.data());
@@ -286,9 +410,151 @@ void Enable(int id, int ncomps, int offset) {
 	glVertexAttribPointer(id, ncomps, GL_FLOAT, GL_FALSE, 0, (void *) offset);
 }
 
+namespace {
+
+unsigned short FloatToHalf(float f) {
+	// IEEE half, round to nearest even
+	unsigned bits;
+	memcpy(&bits, &f, 4);
+	unsigned sign = bits >> 16 & 0x8000, exponent = bits >> 23 & 0xff, mantissa = bits & 0x7fffff;
+	if (exponent == 0xff)													// inf, nan
+		return (unsigned short) (sign | 0x7c00 | (mantissa? 0x200 : 0));
+	int e = (int) exponent-127+15;
+	if (e >= 31)															// overflow
+		return (unsigned short) (sign | 0x7c00);
+	if (e <= 0) {															// denormal or zero
+		if (e < -10)
+			return (unsigned short) sign;
+		mantissa |= 0x800000;
+		int shift = 14-e;
+		unsigned half = mantissa >> shift, rest = mantissa & ((1u << shift)-1), mid = 1u << (shift-1);
+		if (rest > mid || (rest == mid && (half & 1)))
+			half++;
+		return (unsigned short) (sign | half);
+	}
+	unsigned half = (unsigned) e << 10 | mantissa >> 13, rest = mantissa & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		half++;																// may carry into exponent, correctly
+	return (unsigned short) (sign | half);
+}
+
+void OctEncode(vec3 n, short *e) {
+	// unit normal to octahedral snorm16 pair
+	float l1 = fabs(n.x)+fabs(n.y)+fabs(n.z);
+	float x = l1 > 0? n.x/l1 : 0, y = l1 > 0? n.y/l1 : 0;
+	if (n.z < 0) {
+		float ox = (1-fabs(y))*(x >= 0? 1 : -1), oy = (1-fabs(x))*(y >= 0? 1 : -1);
+		x = ox;
+		y = oy;
+	}
+	e[0] = (short) floor(32767*x+.5f);
+	e[1] = (short) floor(32767*y+.5f);
+}
+
+void BufferElements(Mesh &m, const int3 *triangles) {
+	// element buffer: triangles, then those of each level of detail, as unsigned int or (per m.indexType) short
+	size_t nTriangles = m.triangles.size(), total = nTriangles, indexSize = m.indexType == GL_UNSIGNED_SHORT? 2 : 4;
+	if (m.lods.size() && (m.lodBounds.empty() || m.lodBounds.back() != (int) nTriangles))
+		m.lods.resize(0);	// stale: triangles changed since BuildLods
+	for (Mesh::Lod &l : m.lods) {
+		l.startTriangle = (int) total;
+		total += l.triangles.size();
+	}
+	glGenBuffers(1, &m.eBufferId);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.eBufferId);
+	if (indexSize == 4 && m.lods.empty()) {
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, nTriangles*sizeof(int3), triangles, GL_STATIC_DRAW);
+		return;
+	}
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, 3*total*indexSize, NULL, GL_STATIC_DRAW);
+	auto Upload = [&](const int3 *t, size_t n, size_t start) {
+		if (indexSize == 4)
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 3*start*indexSize, n*sizeof(int3), t);
+		else {
+			vector<unsigned short> ids(3*n);
+			const int *v = (const int *) t;
+			for (size_t i = 0; i < 3*n; i++)
+				ids[i] = (unsigned short) v[i];
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 3*start*indexSize, 3*n*indexSize, ids.data());
+		}
+	};
+	Upload(triangles, nTriangles, 0);
+	for (Mesh::Lod &l : m.lods)
+		Upload(l.triangles.data(), l.triangles.size(), l.startTriangle);
+}
+
+void BufferCompact(Mesh &m, vector<vec3> &pts, vector<vec3> *nrms, vector<vec2> *tex) {
+	// interleave quantized position (4 shorts), octahedral normal (2 shorts), half-float uv (2 halves)
+	size_t nPts = pts.size(), nNrms = nrms? nrms->size() : 0, nUvs = tex? tex->size() : 0;
+	vec3 min, max;
+	MinMax(pts.data(), (int) nPts, min, max);
+	float extent = 0;
+	for (int k = 0; k < 3; k++)
+		if (max[k]-min[k] > extent)
+			extent = max[k]-min[k];
+	if (extent <= 0)
+		extent = 1;
+	m.dequantize = Translate(min)*Scale(extent);	// uniform scale, so normals need no correction
+	m.octNormals = nNrms > 0;
+	size_t stride = 8+(nNrms? 4 : 0)+(nUvs? 4 : 0);
+	vector<char> vertices(nPts*stride);
+	for (size_t i = 0; i < nPts; i++) {
+		char *v = vertices.data()+i*stride;
+		unsigned short q[4] = {0, 0, 0, 0};
+		for (int k = 0; k < 3; k++) {
+			float t = (pts[i][k]-min[k])/extent;
+			q[k] = (unsigned short) floor(65535*(t < 0? 0 : t > 1? 1 : t)+.5f);
+		}
+		memcpy(v, q, 8);
+		v += 8;
+		if (nNrms) {
+			short e[2];
+			OctEncode(i < nNrms? (*nrms)[i] : vec3(0, 0, 1), e);
+			memcpy(v, e, 4);
+			v += 4;
+		}
+		if (nUvs) {
+			vec2 uv = i < nUvs? (*tex)[i] : vec2(0, 0);
+			unsigned short h[2] = {FloatToHalf(uv.x), FloatToHalf(uv.y)};
+			memcpy(v, h, 4);
+		}
+	}
+	if (!m.vBufferId)
+		glGenBuffers(1, &m.vBufferId);
+	glBindBuffer(GL_ARRAY_BUFFER, m.vBufferId);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
+	// 16-bit indices if possible
+	m.indexType = nPts <= 65536? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	BufferElements(m, m.triangles.data());
+	glGenVertexArrays(1, &m.vao);
+	glBindVertexArray(m.vao);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, (GLsizei) stride, (void *) 0);
+	if (nNrms) {
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, (GLsizei) stride, (void *) 8);
+	}
+	if (nUvs) {
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, (GLsizei) stride, (void *) (nNrms? 12 : 8));
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+} // end namespace
+
 void Mesh::Buffer(vector<vec3> &pts, vector<vec3> *nrms, vector<vec2> *tex) {
 	size_t nPts = pts.size(), nNrms = nrms? nrms->size() : 0, nUvs = tex? tex->size() : 0;
 	if (!nPts) { printf("Buffer: no points!\n"); return; }
+	if (compact) {
+		BufferCompact(*this, pts, nrms, tex);
+		BufferMaterials();
+		return;
+	}
+	dequantize = mat4();
+	octNormals = false;
+	indexType = GL_UNSIGNED_INT;
 	// create vertex buffer
 	if (!vBufferId)
 		glGenBuffers(1, &vBufferId);
@@ -301,11 +567,8 @@ void Mesh::Buffer(vector<vec3> &pts, vector<vec3> *nrms, vector<vec2> *tex) {
 	if (nPts) glBufferSubData(GL_ARRAY_BUFFER, 0, sizePoints, pts.data());
 	if (nNrms) glBufferSubData(GL_ARRAY_BUFFER, sizePoints, sizeNormals, nrms->data());
 	if (nUvs) glBufferSubData(GL_ARRAY_BUFFER, sizePoints+sizeNormals, sizeUvs, tex->data());
-	// create and load element buffer for triangles
-	size_t sizeTriangles = sizeof(int3)*triangles.size();
-	glGenBuffers(1, &eBufferId);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eBufferId);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeTriangles, triangles.data(), GL_STATIC_DRAW);
+	// create and load element buffer for triangles (and levels of detail)
+	BufferElements(*this, triangles.data());
 	// create vertex array object for mesh
 	glGenVertexArrays(1, &vao);
 	glBindVertexArray(vao);
@@ -315,6 +578,133 @@ void Mesh::Buffer(vector<vec3> &pts, vector<vec3> *nrms, vector<vec2> *tex) {
 	if (nUvs) Enable(2, 2, sizePoints+sizeNormals); // VertexAttribPointer(shader, "uv", 2, 0, (void *) (sizePoints+sizeNormals));
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
+	BufferMaterials();
+}
+
+void Mesh::Buffer(const MeshBin &bin) {
+	if (!bin.nPoints) { printf("Buffer: no points!\n"); return; }
+	if (compact) {
+		// cache holds float layout; quantize copies (set by MeshBin::Get)
+		Buffer();
+		return;
+	}
+	dequantize = mat4();
+	octNormals = false;
+	indexType = GL_UNSIGNED_INT;
+	if (!vBufferId)
+		glGenBuffers(1, &vBufferId);
+	glBindBuffer(GL_ARRAY_BUFFER, vBufferId);
+	glBufferData(GL_ARRAY_BUFFER, bin.VerticesSize(), bin.Vertices(), GL_STATIC_DRAW);
+	BufferElements(*this, bin.Triangles());
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	size_t sizePoints = bin.nPoints*sizeof(vec3), sizeNormals = bin.nNormals*sizeof(vec3);
+	Enable(0, 3, 0);
+	if (bin.nNormals) Enable(1, 3, sizePoints);
+	if (bin.nUvs) Enable(2, 2, sizePoints+sizeNormals);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	BufferMaterials();
+}
+
+void Mesh::Buffer(const GltfPrimitive &p) {
+	if (!p.points.data) { printf("Buffer: no points!\n"); return; }
+	// upload the bytes each attribute spans in its buffer view, once per set of interleaved attributes
+	const GltfAccessor *attributes[] = {&p.points, &p.normals, &p.uvs};
+	struct Range { const char *begin = NULL, *end = NULL; size_t offset = 0; } ranges[3];
+	int nRanges = 0, rangeIds[3] = {-1, -1, -1};
+	for (int k = 0; k < 3; k++) {
+		const GltfAccessor &a = *attributes[k];
+		if (!a.data || a.count != p.points.count)
+			continue;
+		const char *begin = a.data, *end = a.data+a.Size();
+		int r = 0;
+		while (r < nRanges && (end <= ranges[r].begin || begin >= ranges[r].end))
+			r++;
+		if (r == nRanges) {
+			ranges[nRanges].begin = begin;
+			ranges[nRanges++].end = end;
+		}
+		else {
+			ranges[r].begin = begin < ranges[r].begin? begin : ranges[r].begin;
+			ranges[r].end = end > ranges[r].end? end : ranges[r].end;
+		}
+		rangeIds[k] = r;
+	}
+	size_t bufferSize = 0;
+	for (int r = 0; r < nRanges; r++) {
+		ranges[r].offset = bufferSize;
+		bufferSize += (ranges[r].end-ranges[r].begin+3) & ~(size_t) 3;
+	}
+	if (!vBufferId)
+		glGenBuffers(1, &vBufferId);
+	glBindBuffer(GL_ARRAY_BUFFER, vBufferId);
+	glBufferData(GL_ARRAY_BUFFER, bufferSize, NULL, GL_STATIC_DRAW);
+	for (int r = 0; r < nRanges; r++)
+		glBufferSubData(GL_ARRAY_BUFFER, ranges[r].offset, ranges[r].end-ranges[r].begin, ranges[r].begin);
+	// element buffer: in place if 32- or 16-bit triangle list, else from triangles
+	const GltfAccessor &ids = p.indices;
+	bool inPlace = ids.data && (ids.componentType == GL_UNSIGNED_INT || ids.componentType == GL_UNSIGNED_SHORT) &&
+				   ids.Packed() && p.mode == GL_TRIANGLES && ids.count == 3*triangles.size() && lods.empty();
+	dequantize = mat4();
+	octNormals = false;
+	indexType = inPlace? ids.componentType : GL_UNSIGNED_INT;
+	if (inPlace) {
+		glGenBuffers(1, &eBufferId);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eBufferId);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, ids.count*ids.ComponentSize(), ids.data, GL_STATIC_DRAW);
+	}
+	else
+		BufferElements(*this, triangles.data());
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	for (int k = 0; k < 3; k++)
+		if (rangeIds[k] >= 0) {
+			const GltfAccessor &a = *attributes[k];
+			const Range &r = ranges[rangeIds[k]];
+			glEnableVertexAttribArray(k);
+			glVertexAttribPointer(k, a.nComponents, a.componentType, a.normalized, a.stride, (void *) (r.offset+(a.data-r.begin)));
+		}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	BufferMaterials();
+}
+
+void Mesh::BufferMaterials() {
+	// materials presumed sorted, each a contiguous range of triangles
+	mtlBatches.resize(0);
+	int nMtls = triangleMtls.size();
+	if (nMtls > maxMtls)
+		printf("%i materials exceed limit of %i: drawing without materials\n", nMtls, maxMtls);
+	if (!nMtls || nMtls > maxMtls)
+		return;
+	vector<MtlParams> params(nMtls);
+	for (int i = 0; i < nMtls; i++) {
+		Mtl &m = triangleMtls[i];
+		MtlParams &p = params[i];
+		p.ka = vec4(m.ka, 0);
+		p.kd = vec4(m.kd, m.d);
+		p.ks = vec4(m.ks, m.ns);
+		p.range[0] = m.startTriangle;
+		p.range[1] = m.nTriangles;
+		p.range[2] = p.range[3] = 0;
+		GLuint textureName = m.textureName? m.textureName : m.mapKd.size()? ReadTextureOnce(m.mapKd.c_str()) : 0;
+		if (mtlBatches.size() && mtlBatches.back().textureName == textureName)
+			mtlBatches.back().nTriangles = m.startTriangle+m.nTriangles-mtlBatches.back().startTriangle;
+		else {
+			MtlBatch b;
+			b.startTriangle = m.startTriangle;
+			b.nTriangles = m.nTriangles;
+			b.textureName = textureName;
+			mtlBatches.push_back(b);
+		}
+	}
+	if (!mtlBuffer)
+		glGenBuffers(1, &mtlBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, mtlBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, maxMtls*sizeof(MtlParams), NULL, GL_STATIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, nMtls*sizeof(MtlParams), params.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 void Mesh::Clear() {
@@ -325,6 +715,179 @@ void Mesh::Clear() {
 	quads.resize(0);
 	triangleGroups.resize(0);
 	triangleMtls.resize(0);
+	mtlBatches.resize(0);
+	lods.resize(0);
+	lodBounds.resize(0);
+	meshlets.resize(0);
+	bvh.Clear();
+}
+
+// Level of Detail
+
+void Mesh::BuildLods(int nLevels, float ratio, int nThreads) {
+	int nTriangles = (int) triangles.size(), nPoints = (int) points.size();
+	lods.resize(0);
+	lods.reserve(nLevels);
+	lodBounds = TriangleRangeBounds(nTriangles, &triangleGroups, &triangleMtls);
+	vec3 min, max;
+	MinMax(points.data(), nPoints, min, max);
+	lodCenter = (min+max)/2;
+	lodRadius = length(max-min)/2;
+	// keep points used by more than one range (else ranges would part), or coincident with another (seams)
+	vector<bool> locked(nPoints, false);
+	vector<int> rangeIds(nPoints, -1);
+	int nRanges = (int) lodBounds.size()-1;
+	for (int r = 0; r < nRanges; r++)
+		for (int t = lodBounds[r]; t < lodBounds[r+1]; t++)
+			for (int k = 0; k < 3; k++) {
+				int v = triangles[t][k];
+				if (v < 0 || v >= nPoints)
+					return;
+				if (rangeIds[v] >= 0 && rangeIds[v] != r)
+					locked[v] = true;
+				rangeIds[v] = r;
+			}
+	Int3Map coincident(nPoints);
+	for (int i = 0; i < nPoints; i++) {
+		bool inserted;
+		int bits[3];
+		memcpy(bits, &points[i], sizeof(vec3));
+		int *first = coincident.Insert(int3(bits), i, inserted);
+		if (!inserted)
+			locked[i] = locked[*first] = true;
+	}
+	// each level from the previous, range by range
+	const vector<int3> *previous = &triangles;
+	vector<int> previousStarts = lodBounds;
+	float error = 0;
+	for (int level = 0; level < nLevels; level++) {
+		vector<vector<int3>> results(nRanges);
+		vector<float> errors(nRanges, 0);
+		ParallelFor(nRanges, [&](int r) {
+			int start = previousStarts[r], n = previousStarts[r+1]-start;
+			if (n > 0)
+				errors[r] = SimplifyTriangles(points, previous->data()+start, n, (int) (ratio*n), results[r], &locked);
+		}, nThreads);
+		Lod l;
+		l.starts.push_back(0);
+		float levelError = 0;
+		for (int r = 0; r < nRanges; r++) {
+			l.triangles.insert(l.triangles.end(), results[r].begin(), results[r].end());
+			l.starts.push_back((int) l.triangles.size());
+			levelError = levelError > errors[r]? levelError : errors[r];
+		}
+		if (l.triangles.size() > .9f*previous->size())
+			break;
+		error += levelError;
+		l.error = error;
+		lods.push_back(l);
+		previous = &lods.back().triangles;
+		previousStarts = lods.back().starts;
+	}
+}
+
+int Mesh::SelectLod(const Camera &camera, int viewportHeight, int bias) {
+	int nLevels = (int) lods.size(), lod = 0;
+	if (lodPixelError > 0 && nLevels) {
+		mat4 m = camera.modelview*toWorld;
+		vec3 center = Vec3(m*vec4(lodCenter, 1));
+		float scale = 0;
+		for (int k = 0; k < 3; k++) {
+			float s = length(vec3(m[0][k], m[1][k], m[2][k]));
+			scale = s > scale? s : scale;
+		}
+		// pixels per object-space unit at nearest point: persp[1][1] is cot(fov/2), the viewport spans 2 in NDC
+		float distance = length(center)-scale*lodRadius;
+		if (distance > 0) {
+			float pixels = scale*camera.persp[1][1]*viewportHeight/(2*distance);
+			while (lod < nLevels && lods[lod].error*pixels <= lodPixelError)
+				lod++;
+		}
+	}
+	lod += bias;
+	return lod < nLevels? lod : nLevels;
+}
+
+// Meshlets
+
+void Mesh::BuildMeshlets(int maxVertices, int maxTriangles) {
+	::BuildMeshlets(points, triangles, meshlets, maxVertices, maxTriangles, &triangleGroups, &triangleMtls);
+	lods.resize(0);	// triangles reordered
+}
+
+int Mesh::CullMeshlets(const Camera &camera, vector<char> &visible) {
+	int nMeshlets = (int) meshlets.size(), nVisible = 0;
+	if (nMeshlets && meshlets.back().startTriangle+meshlets.back().nTriangles != (int) triangles.size())
+		meshlets.resize(0), nMeshlets = 0;	// stale: triangles changed since BuildMeshlets
+	// frustum planes (Gribb, Hartmann) and eye in object space
+	mat4 modelview = camera.modelview*toWorld, m = camera.persp*modelview;
+	vec4 planes[6] = {m[3]+m[0], m[3]-m[0], m[3]+m[1], m[3]-m[1], m[3]+m[2], m[3]-m[2]};
+	for (vec4 &p : planes) {
+		float l = length(vec3(p.x, p.y, p.z));
+		p = l > 0? p/l : p;
+	}
+	vec3 eye = Vec3(Invert(modelview)*vec4(0, 0, 0, 1));
+	visible.resize(nMeshlets);
+	for (int i = 0; i < nMeshlets; i++) {
+		const Meshlet &c = meshlets[i];
+		bool cull = false;
+		for (int k = 0; k < 6 && !cull; k++)
+			cull = dot(planes[k], vec4(c.center, 1)) < -c.radius;
+		if (!cull && cullBackfacing) {
+			vec3 v = c.center-eye;
+			cull = dot(v, c.coneAxis) >= c.coneCutoff*length(v)+c.radius;
+		}
+		visible[i] = !cull;
+		nVisible += !cull;
+	}
+	return nVisible;
+}
+
+void Mesh::DrawTriangles(int lod, int startTriangle, int nTriangles, const vector<char> *visibleMeshlets) {
+	size_t indexSize = indexType == GL_UNSIGNED_SHORT? 2 : 4;
+	if (lod || !visibleMeshlets || visibleMeshlets->size() != meshlets.size()) {
+		LodRange(lod, startTriangle, nTriangles, startTriangle, nTriangles);
+		if (nTriangles > 0)
+			glDrawElements(GL_TRIANGLES, 3*nTriangles, indexType, (void *) (3*startTriangle*indexSize));
+		return;
+	}
+	// visible meshlets within range, adjacent ones merged
+	vector<GLsizei> counts;
+	vector<const void *> offsets;
+	int stop = startTriangle+nTriangles, last = -1;
+	auto first = std::lower_bound(meshlets.begin(), meshlets.end(), startTriangle, [](const Meshlet &m, int t) {
+		return m.startTriangle < t;
+	});
+	for (size_t i = first-meshlets.begin(); i < meshlets.size() && meshlets[i].startTriangle < stop; i++) {
+		const Meshlet &m = meshlets[i];
+		if (!(*visibleMeshlets)[i])
+			continue;
+		if (m.startTriangle == last)
+			counts.back() += 3*m.nTriangles;
+		else {
+			counts.push_back(3*m.nTriangles);
+			offsets.push_back((const void *) (3*m.startTriangle*indexSize));
+		}
+		last = m.startTriangle+m.nTriangles;
+	}
+	if (counts.size())
+		glMultiDrawElements(GL_TRIANGLES, counts.data(), indexType, offsets.data(), (GLsizei) counts.size());
+}
+
+void Mesh::LodRange(int lod, int startTriangle, int nTriangles, int &lodStart, int &lodCount) {
+	if (lod <= 0 || lod > (int) lods.size()) {
+		lodStart = startTriangle;
+		lodCount = nTriangles;
+		return;
+	}
+	Lod &l = lods[lod-1];
+	int last = (int) lodBounds.size()-1;
+	int i = (int) (std::lower_bound(lodBounds.begin(), lodBounds.end(), startTriangle)-lodBounds.begin());
+	int j = (int) (std::lower_bound(lodBounds.begin(), lodBounds.end(), startTriangle+nTriangles)-lodBounds.begin());
+	i = i < last? i : last;
+	j = j < last? j : last;
+	lodStart = l.startTriangle+l.starts[i];
+	lodCount = l.starts[j]-l.starts[i];
 }
 
 void Mesh::Buffer() { Buffer(points, normals.size()? &normals : NULL, uvs.size()? &uvs : NULL); }
@@ -343,14 +906,69 @@ void Mesh::Set(vector<vec3> &pts, vector<vec3> *nrms, vector<vec2> *tex, vector<
 	Buffer(pts, nrms, tex);
 }
 
-bool Mesh::Read(string objFile, mat4 *m, bool standardize, bool buffer, bool forceTriangles) {
-	if (!ReadAsciiObj((char *) objFile.c_str(), points, triangles, &normals, &uvs, &triangleGroups, &triangleMtls, forceTriangles? NULL : &quads, NULL)) {
+void Mesh::Set(vector<vec3> &pts, vector<int3> &tris, vector<vec3> *nrms) {
+	// copy before Clear, in case arguments are this mesh's own arrays
+	vector<vec3> p = pts, n = nrms? *nrms : vector<vec3>();
+	vector<int3> t = tris;
+	Clear();
+	points.swap(p);
+	normals.swap(n);
+	triangles.swap(t);
+	Buffer();
+}
+
+bool Mesh::Read(string objFile, mat4 *m, bool standardize, bool buffer, bool forceTriangles, bool cache) {
+	// cached arrays depend on standardize, forceTriangles, optimizeOrder, and buildMeshlets;
+	// cached materials depend on the OBJ material files, whose modification times are also checked
+	string binFile = objFile+".meshbin";
+	time_t modified = cache? FileModified(objFile.c_str()) : 0;
+	unsigned flags = (standardize? 1 : 0) | (forceTriangles? 2 : 0) | (optimizeOrder? 4 : 0) | (buildMeshlets? 8 : 0);
+	MeshBin bin;
+	if (modified && bin.Open(binFile.c_str(), modified, flags)) {
+		bin.Get(points, normals, uvs, triangles, quads, triangleGroups, triangleMtls);
+		objFilename = objFile;
+		if (buildMeshlets)
+			BuildMeshlets();
+		if (lodLevels > 0)
+			BuildLods(lodLevels);
+		if (buffer) {
+			// BuildMeshlets may reorder triangles, so buffer them rather than the cached copy
+			if (buildMeshlets)
+				Buffer();
+			else
+				Buffer(bin);
+		}
+		if (m)
+			toWorld = *m;
+		return true;
+	}
+	// binary FBX by extension, else OBJ
+	size_t dot = objFile.find_last_of('.');
+	string ext = dot == string::npos? string() : objFile.substr(dot+1);
+	bool fbx = ext.size() == 3 && (ext[0] | 0x20) == 'f' && (ext[1] | 0x20) == 'b' && (ext[2] | 0x20) == 'x';
+	quads.resize(0);
+	vector<string> mtlLibs;
+	if (fbx? !ReadFBX(objFile.c_str(), points, triangles, &normals, &uvs, &triangleGroups, &triangleMtls) :
+			 !ReadAsciiObjParallel(objFile.c_str(), points, triangles, &normals, &uvs, &triangleGroups, &triangleMtls,
+								   forceTriangles? NULL : &quads, NULL, 0, &mtlLibs)) {
 		printf("Mesh.Read: can't read %s\n", objFile.c_str());
 		return false;
 	}
 	objFilename = objFile;
+	SortTrianglesByMaterial(triangles, triangleMtls, &triangleGroups);
 	if (standardize)
 		Standardize(points.data(), points.size(), 1);
+	if (optimizeOrder) {
+		float before, after;
+		OptimizeTriangleOrder(points, triangles, &normals, &uvs, &quads, &triangleGroups, &triangleMtls, 16, 1.05f, &before, &after);
+		printf("Mesh.Read: %s ACMR %.3f -> %.3f\n", objFile.c_str(), before, after);
+	}
+	if (buildMeshlets)
+		BuildMeshlets();
+	if (lodLevels > 0)
+		BuildLods(lodLevels);
+	if (modified)
+		WriteMeshBin(binFile.c_str(), modified, flags, points, normals, uvs, triangles, quads, triangleGroups, triangleMtls, &mtlLibs);
 	if (buffer)
 		Buffer();
 	if (m)
@@ -358,8 +976,8 @@ bool Mesh::Read(string objFile, mat4 *m, bool standardize, bool buffer, bool for
 	return true;
 }
 
-bool Mesh::Read(string objFile, string texFile, mat4 *m, bool standardize, bool buffer, bool forceTriangles) {
-	if (!Read(objFile, m, standardize, buffer, forceTriangles))
+bool Mesh::Read(string objFile, string texFile, mat4 *m, bool standardize, bool buffer, bool forceTriangles, bool cache) {
+	if (!Read(objFile, m, standardize, buffer, forceTriangles, cache))
 		return false;
 	objFilename = objFile;
 	texFilename = texFile;
@@ -369,6 +987,277 @@ bool Mesh::Read(string objFile, string texFile, mat4 *m, bool standardize, bool
 	return textureName > 0;
 }
 
+// glTF
+
+namespace {
+
+bool SetPrimitive(Mesh &m, const Gltf &g, const GltfPrimitive &p, vector<GLuint> &textures) {
+	// set vertices, triangles, and material from glTF primitive
+	// a primitive without POSITION is skipped (mesh left empty, not buffered), not an error
+	int nPoints = (int) p.points.count;
+	if (!nPoints)
+		return true;
+	if (!p.points.Get(m.points))
+		return false;
+	if (p.normals.count == p.points.count)
+		p.normals.Get(m.normals);
+	if (p.uvs.count == p.points.count)
+		p.uvs.Get(m.uvs);
+	vector<int> ids;
+	if (p.indices.count)
+		p.indices.Get(ids);
+	else
+		for (int i = 0; i < nPoints; i++)
+			ids.push_back(i);
+	int nIds = (int) ids.size();
+	if (p.mode == GL_TRIANGLES)
+		for (int i = 0; i+2 < nIds; i += 3)
+			m.triangles.push_back(int3(ids[i], ids[i+1], ids[i+2]));
+	else if (p.mode == GL_TRIANGLE_STRIP)
+		for (int i = 2; i < nIds; i++)
+			m.triangles.push_back(i%2? int3(ids[i-1], ids[i-2], ids[i]) : int3(ids[i-2], ids[i-1], ids[i]));
+	else if (p.mode == GL_TRIANGLE_FAN)
+		for (int i = 2; i < nIds; i++)
+			m.triangles.push_back(int3(ids[0], ids[i-1], ids[i]));
+	else
+		printf("ReadGltf: primitive mode %i unsupported\n", p.mode);
+	for (size_t i = 0; i < m.triangles.size(); i++) {
+		int3 &t = m.triangles[i];
+		if (t.i1 < 0 || t.i2 < 0 || t.i3 < 0 || t.i1 >= nPoints || t.i2 >= nPoints || t.i3 >= nPoints) {
+			printf("ReadGltf: triangle %i has bad vertex index\n", (int) i);
+			return false;
+		}
+	}
+	if (p.material >= 0 && p.material < (int) g.materials.size()) {
+		const GltfMaterial &gm = g.materials[p.material];
+		Mtl mtl;
+		mtl.name = gm.name;
+		mtl.kd = vec3(gm.baseColor.x, gm.baseColor.y, gm.baseColor.z);
+		mtl.d = gm.baseColor.w;
+		mtl.startTriangle = 0;
+		mtl.nTriangles = (int) m.triangles.size();
+		if (gm.image >= 0 && m.uvs.size()) {
+			GLuint &texture = textures[gm.image];
+			const GltfImage &image = g.images[gm.image];
+			// glTF uv origin is top-left of image, so images are not flipped
+			if (!texture && image.data)
+				texture = DecodeTexture(image.data, image.size, false);
+			if (!texture && image.filename.size()) {
+				MappedFile file(image.filename.c_str());
+				if (file.data)
+					texture = DecodeTexture((const unsigned char *) file.data, file.size, false);
+			}
+			mtl.textureName = m.textureName = texture;
+			m.texFilename = image.filename;
+		}
+		m.triangleMtls.push_back(mtl);
+	}
+	return true;
+}
+
+} // end namespace
+
+bool ReadGltf(const char *filename, vector<Mesh> &meshes, bool standardize, bool buffer) {
+	Gltf g;
+	meshes.clear();
+	if (!g.Open(filename))
+		return false;
+	// nodes reachable from scene, in depth-first order; one mesh for each, plus one for each extra primitive
+	vector<int> order, stack(g.roots.rbegin(), g.roots.rend());
+	size_t nMeshes = 1;
+	while (stack.size()) {
+		int n = stack.back();
+		stack.pop_back();
+		order.push_back(n);
+		const GltfNode &node = g.nodes[n];
+		nMeshes += node.mesh >= 0 && g.meshes[node.mesh].primitives.size() > 1? g.meshes[node.mesh].primitives.size() : 1;
+		stack.insert(stack.end(), node.children.rbegin(), node.children.rend());
+	}
+	meshes.resize(nMeshes);
+	vector<Mesh *> nodeMeshes(g.nodes.size(), NULL);
+	vector<GLuint> textures(g.images.size(), 0);
+	Mesh *root = &meshes[0];
+	root->objFilename = filename;
+	size_t next = 1;
+	for (size_t i = 0; i < order.size(); i++) {
+		const GltfNode &node = g.nodes[order[i]];
+		Mesh *m = nodeMeshes[order[i]] = &meshes[next++];
+		m->objFilename = filename;
+		m->wrtParent = node.matrix;
+		if (node.mesh < 0)
+			continue;
+		const vector<GltfPrimitive> &prims = g.meshes[node.mesh].primitives;
+		for (size_t k = 0; k < prims.size(); k++) {
+			Mesh *pm = m;
+			if (k > 0) {
+				pm = &meshes[next++];
+				pm->objFilename = filename;
+				pm->parent = m;
+				m->children.push_back(pm);
+			}
+			if (!SetPrimitive(*pm, g, prims[k], textures)) {
+				printf("ReadGltf: can't read %s\n", filename);
+				meshes.clear();
+				return false;
+			}
+		}
+	}
+	// link hierarchy
+	for (size_t r = 0; r < g.roots.size(); r++) {
+		Mesh *m = nodeMeshes[g.roots[r]];
+		m->parent = root;
+		root->children.push_back(m);
+	}
+	for (size_t i = 0; i < order.size(); i++) {
+		Mesh *m = nodeMeshes[order[i]];
+		const vector<int> &children = g.nodes[order[i]].children;
+		for (size_t k = 0; k < children.size(); k++) {
+			Mesh *c = nodeMeshes[children[k]];
+			c->parent = m;
+			m->children.push_back(c);
+		}
+	}
+	root->SetToWorld();
+	if (standardize) {
+		vec3 min(FLT_MAX, FLT_MAX, FLT_MAX), max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (size_t i = 1; i < meshes.size(); i++)
+			for (size_t k = 0; k < meshes[i].points.size(); k++) {
+				vec3 p = Vec3(meshes[i].toWorld*vec4(meshes[i].points[k]));
+				for (int j = 0; j < 3; j++) {
+					if (p[j] < min[j]) min[j] = p[j];
+					if (p[j] > max[j]) max[j] = p[j];
+				}
+			}
+		if (min.x <= max.x) {
+			root->wrtParent = NDCfromMinMax(min, max);
+			root->SetToWorld();
+		}
+	}
+	if (buffer)
+		for (size_t i = 0; i < order.size(); i++) {
+			const GltfNode &node = g.nodes[order[i]];
+			if (node.mesh < 0)
+				continue;
+			Mesh *m = nodeMeshes[order[i]];
+			const vector<GltfPrimitive> &prims = g.meshes[node.mesh].primitives;
+			for (size_t k = 0; k < prims.size(); k++)
+				if (prims[k].points.data)
+					(k == 0? m : m->children[k-1])->Buffer(prims[k]);
+		}
+	return true;
+}
+
+// incremental loading
+
+bool MeshLoader::Start(Mesh *m, string objFile, bool stdize, bool forceTriangles) {
+	Release();
+	mesh = m;
+	standardize = stdize;
+	mesh->Clear();
+	mesh->objFilename = objFile;
+	mesh->dequantize = mat4();
+	mesh->octNormals = false;
+	mesh->indexType = GL_UNSIGNED_INT;
+	vector<int4> *quads = forceTriangles? NULL : &mesh->quads;
+	if (!reader.Open(objFile.c_str(), mesh->points, mesh->triangles, &mesh->normals, &mesh->uvs, &mesh->triangleGroups, &mesh->triangleMtls, quads)) {
+		printf("MeshLoader: can't read %s\n", objFile.c_str());
+		mesh = NULL;
+		return false;
+	}
+	// buffers for progressive display (positions, normals), grown as needed
+	if (!mesh->vBufferId)
+		glGenBuffers(1, &mesh->vBufferId);
+	if (!mesh->eBufferId)
+		glGenBuffers(1, &mesh->eBufferId);
+	if (!mesh->vao)
+		glGenVertexArrays(1, &mesh->vao);
+	return true;
+}
+
+bool MeshLoader::Step(int budgetMicroseconds) {
+	if (Done())
+		return true;
+	const size_t sliceSize = 1 << 16;
+	auto start = std::chrono::steady_clock::now();
+	bool ok = true;
+	while (ok && !reader.Done() &&
+		   std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-start).count() < budgetMicroseconds)
+		ok = reader.Read(sliceSize);
+	if (!ok) {
+		printf("MeshLoader: can't read %s\n", mesh->objFilename.c_str());
+		Release();
+		return false;
+	}
+	if (reader.Done())
+		Finish();
+	else
+		Upload();
+	return true;
+}
+
+void MeshLoader::Upload() {
+	// buffer vertices and triangles read since last upload
+	const vector<vec3> &pts = reader.Vertices(), &nrms = reader.Normals();
+	const vector<int3> &tris = mesh->triangles;
+	if (tris.size() == nTriangles)
+		return;	// display nothing until faces arrive (by then, usually, all vertices have been read)
+	if (!nTriangles && !nVertices)
+		preview = standardize? StandardizeMat((vec3 *) pts.data(), pts.size(), 1) : mat4();
+	size_t nNewNormals = nrms.size() < pts.size()? nrms.size() : pts.size();
+	glBindVertexArray(mesh->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vBufferId);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->eBufferId);
+	if (pts.size() > vCapacity) {
+		// grow vertex buffer, re-buffer all
+		vCapacity = pts.size() > 2*vCapacity? pts.size() : 2*vCapacity;
+		glBufferData(GL_ARRAY_BUFFER, 2*vCapacity*sizeof(vec3), NULL, GL_STREAM_DRAW);
+		Enable(0, 3, 0);
+		Enable(1, 3, vCapacity*sizeof(vec3));
+		nVertices = nNormals = 0;
+	}
+	if (pts.size() > nVertices) {
+		vector<vec3> p(pts.begin()+nVertices, pts.end());
+		for (size_t i = 0; i < p.size(); i++)
+			p[i] = Vec3(preview*vec4(p[i]));
+		glBufferSubData(GL_ARRAY_BUFFER, nVertices*sizeof(vec3), p.size()*sizeof(vec3), p.data());
+		nVertices = pts.size();
+	}
+	if (nNewNormals > nNormals) {
+		glBufferSubData(GL_ARRAY_BUFFER, (vCapacity+nNormals)*sizeof(vec3), (nNewNormals-nNormals)*sizeof(vec3), nrms.data()+nNormals);
+		nNormals = nNewNormals;
+	}
+	if (tris.size() > tCapacity) {
+		tCapacity = tris.size() > 2*tCapacity? tris.size() : 2*tCapacity;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, tCapacity*sizeof(int3), NULL, GL_STREAM_DRAW);
+		nTriangles = 0;
+	}
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, nTriangles*sizeof(int3), (tris.size()-nTriangles)*sizeof(int3), tris.data()+nTriangles);
+	nTriangles = tris.size();
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MeshLoader::Finish() {
+	// final points are now in mesh; replace progressive buffers with those of Mesh::Buffer
+	SortTrianglesByMaterial(mesh->triangles, mesh->triangleMtls, &mesh->triangleGroups);
+	if (standardize)
+		Standardize(mesh->points.data(), mesh->points.size(), 1);
+	glDeleteBuffers(1, &mesh->eBufferId);
+	glDeleteVertexArrays(1, &mesh->vao);
+	mesh->eBufferId = mesh->vao = 0;
+	if (mesh->points.size())
+		mesh->Buffer();
+	mesh = NULL;
+	Release();
+}
+
+void MeshLoader::Release() {
+	// stop loading; mesh keeps what has been read
+	reader.Close();
+	mesh = NULL;
+	vCapacity = tCapacity = nVertices = nNormals = nTriangles = 0;
+}
+
 // intersections
 
 vec2 MajPln(vec3 &p, int mp) { return mp == 1? vec2(p.y, p.z) : mp == 2? vec2(p.x, p.z) : vec2(p.x, p.y); }
@@ -462,6 +1351,46 @@ void BuildQuadInfos(vector<vec3> &points, vector<int4> &quads, vector<QuadInfo>
 		quadInfos[i] = QuadInfo(points[quads[i].i1], points[quads[i].i2], points[quads[i].i3], points[quads[i].i4]);
 }
 
+void Mesh::BuildBVH(int nThreads) {
+	bvh.Build(points, triangles, &quads, 4, nThreads);
+}
+
+bool Mesh::RefitBVH(float rebuildRatio, int nThreads) {
+	if (bvh.Empty()) {
+		BuildBVH(nThreads);
+		return true;
+	}
+	return bvh.Refit(points, rebuildRatio, nThreads);
+}
+
+int Mesh::IntersectWithLine(vec3 p1, vec3 p2, float &alpha) {
+	if (bvh.Empty())
+		BuildBVH();
+	// alpha is unchanged by (affine) transformation of the line to object space
+	mat4 inv;
+	if (!InvertAffine(toWorld, inv)) {
+		alpha = FLT_MAX;
+		return -1;
+	}
+	return bvh.IntersectWithLine(Vec3(inv*vec4(p1, 1)), Vec3(inv*vec4(p2, 1)), alpha);
+}
+
+void SetTopBVH(TopBVH &top, vector<Mesh *> &meshes, int nThreads) {
+	top.Clear();
+	for (Mesh *m : meshes) {
+		if (m->bvh.Empty())
+			m->BuildBVH(nThreads);
+		top.Add(&m->bvh, m->toWorld);
+	}
+	top.Build(nThreads);
+}
+
+void UpdateTopBVH(TopBVH &top, vector<Mesh *> &meshes) {
+	for (size_t i = 0; i < meshes.size() && i < top.instances.size(); i++)
+		top.SetTransform((int) i, meshes[i]->toWorld);
+	top.Refit();
+}
+
 int IntersectWithLine(vec3 p1, vec3 p2, vector<TriInfo> &triInfos, float &retAlpha) {
 	int picked = -1;
 	float alpha, minAlpha = FLT_MAX;
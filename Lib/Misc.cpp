@@ -0,0 +1,30 @@
+// Misc.cpp - file utilities
+// (c) 2019-2022 Jules Bloomenthal
+
+#include "Misc.h"
+#include <sys/stat.h>
+#ifdef _WIN32
+	#include <direct.h>
+	#define getcwd _getcwd
+	#define stat _stat
+#else
+	#include <unistd.h>
+#endif
+
+// Misc
+
+string GetDirectory() {
+	char buf[256];
+	return getcwd(buf, sizeof(buf))? string(buf)+"/" : string();
+}
+
+time_t FileModified(const char *name) {
+	// return 0 if file can't be found
+	struct stat info;
+	return stat(name, &info) == 0? info.st_mtime : 0;
+}
+
+bool FileExists(const char *name) {
+	struct stat info;
+	return stat(name, &info) == 0;
+}
@@ -0,0 +1,298 @@
+// Pick.cpp - id framebuffer: per pixel, object+1, triangle+1 (0 for sprite), and depth bits (RGBA32UI)
+
+#include <limits.h>
+#include <string.h>
+#include "GLXtras.h"
+#include "Pick.h"
+
+namespace {
+
+GLuint meshPickProgram = 0, spritePickProgram = 0;
+
+const char *meshPickVert = R"(
+	#version 410 core
+	layout(location = 0) in vec3 point;
+	uniform mat4 view;					// camera.fullview*mesh.toWorld*mesh.dequantize
+	void main() {
+		gl_Position = view*vec4(point, 1);
+	}
+)";
+
+const char *meshPickFrag = R"(
+	#version 410 core
+	uniform uint object = 0u;
+	uniform int firstTriangle = 0;		// triangle index of the draw's first primitive
+	out uvec4 pId;
+	void main() {
+		pId = uvec4(object+1u, uint(firstTriangle+gl_PrimitiveID+1), floatBitsToUint(gl_FragCoord.z), 0);
+	}
+)";
+
+// as Sprite.cpp vertex shader
+#ifdef GL_QUADS
+const char *spritePickVert = R"(
+	#version 330
+	uniform mat4 view;
+	uniform float z = 0;
+	out vec2 uv;
+	void main() {
+		const vec2 pts[4] = vec2[4](vec2(-1,-1), vec2(-1,1), vec2(1,1), vec2(1,-1));
+		uv = (vec2(1,1)+pts[gl_VertexID])/2;
+		gl_Position = view*vec4(pts[gl_VertexID], z, 1);
+	}
+)";
+#else
+const char *spritePickVert = R"(
+	#version 330
+	uniform mat4 view;
+	uniform float z = 0;
+	out vec2 uv;
+	void main() {
+		const vec2 pts[6] = vec2[6](vec2(-1,-1), vec2(-1,1), vec2(1,1), vec2(-1,-1), vec2(1,1), vec2(1,-1));
+		uv = (vec2(1,1)+pts[gl_VertexID])/2;
+		gl_Position = view*vec4(pts[gl_VertexID], z, 1);
+	}
+)";
+#endif
+
+// discards as the Sprite.cpp pixel shader, so only visible sprite pixels are tagged
+const char *spritePickFrag = R"(
+	#version 330
+	in vec2 uv;
+	uniform mat4 uvTransform;
+	uniform sampler2D textureImage, textureMat;
+	uniform bool useMat;
+	uniform int nTexChannels = 3;
+	uniform uint object = 0u;
+	out uvec4 pId;
+	void main() {
+		vec2 st = (uvTransform*vec4(uv, 0, 1)).xy;
+		float a = nTexChannels == 4? texture(textureImage, st).a : useMat? texture(textureMat, st).r : 1;
+		if (a < .02)
+			discard;
+		pId = uvec4(object+1u, 0, floatBitsToUint(gl_FragCoord.z), 0);
+	}
+)";
+
+GLuint MeshPickProgram() {
+	if (!meshPickProgram)
+		meshPickProgram = LinkProgramViaCode(&meshPickVert, &meshPickFrag);
+	return meshPickProgram;
+}
+
+GLuint SpritePickProgram() {
+	if (!spritePickProgram)
+		spritePickProgram = LinkProgramViaCode(&spritePickVert, &spritePickFrag);
+	return spritePickProgram;
+}
+
+} // end namespace
+
+// Framebuffer
+
+bool PickBuffer::Begin(int x, int y) {
+	GLint vp[4];
+	glGetIntegerv(GL_VIEWPORT, vp);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &oldDrawFramebuffer);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &oldReadFramebuffer);
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &oldActiveTexture);
+	for (int i = 0; i < 2; i++) {
+		// units Draw(Sprite) binds
+		glActiveTexture(GL_TEXTURE0+i);
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &oldTextures[i]);
+	}
+	glActiveTexture(oldActiveTexture);
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &oldTextures[2]);	// unit Begin binds when resizing
+	glGetIntegerv(GL_CURRENT_PROGRAM, &oldProgram);
+	glGetIntegerv(GL_SCISSOR_BOX, oldScissor);
+	oldScissorTest = glIsEnabled(GL_SCISSOR_TEST);
+	oldDepthTest = glIsEnabled(GL_DEPTH_TEST);
+	// framebuffer covers viewport, so pixels are addressed as in the window
+	int fw = vp[0]+vp[2], fh = vp[1]+vp[3];
+	if (fw <= 0 || fh <= 0)
+		return false;
+	if (!framebuffer)
+		glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	if (fw != width || fh != height) {
+		width = fw;
+		height = fh;
+		if (!idTexture)
+			glGenTextures(1, &idTexture);
+		glBindTexture(GL_TEXTURE_2D, idTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32UI, width, height, 0, GL_RGBA_INTEGER, GL_UNSIGNED_INT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, idTexture, 0);
+		if (!depthBuffer)
+			glGenRenderbuffers(1, &depthBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+		GLenum drawBuffer = GL_COLOR_ATTACHMENT0;
+		glDrawBuffers(1, &drawBuffer);
+	}
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		RestoreBindings();
+		return false;
+	}
+	// only the pixels to be read are cleared and drawn
+	xmouse = x;
+	ymouse = y;
+	x0 = x-radius < 0? 0 : x-radius;
+	y0 = y-radius < 0? 0 : y-radius;
+	w = (x+radius+1 > width? width : x+radius+1)-x0;
+	h = (y+radius+1 > height? height : y+radius+1)-y0;
+	w = w < 0? 0 : w;
+	h = h < 0? 0 : h;
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(x0, y0, w, h);
+	GLuint zero[] = {0, 0, 0, 0};
+	glClearBufferuiv(GL_COLOR, 0, zero);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_DEPTH_TEST);
+	return true;
+}
+
+void PickBuffer::Draw(Mesh &m, int object, Camera &camera) {
+	int nTris = (int) m.triangles.size(), nQuads = (int) m.quads.size();
+	GLuint program = MeshPickProgram();
+	glUseProgram(program);
+	SetUniform(program, "view", camera.fullview*m.toWorld*m.dequantize);
+	SetUniform(program, "object", (GLuint) object);
+	SetUniform(program, "firstTriangle", 0);
+	glBindVertexArray(m.vao);
+	// full resolution triangles lead the element buffer, drawn in one call so gl_PrimitiveID is the triangle index
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.eBufferId);
+	if (nTris)
+		glDrawElements(GL_TRIANGLES, 3*nTris, m.indexType, 0);
+#ifdef GL_QUADS
+	if (nQuads) {
+		SetUniform(program, "firstTriangle", nTris);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		glDrawElements(GL_QUADS, 4*nQuads, GL_UNSIGNED_INT, m.quads.data());
+	}
+#endif
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+void PickBuffer::Draw(Sprite &s, int object, mat4 *view) {
+	GLuint program = SpritePickProgram();
+	glUseProgram(program);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, s.nFrames? s.textureNames[s.frame] : s.textureName);
+	SetUniform(program, "textureImage", 0);
+	SetUniform(program, "useMat", s.matName > 0);
+	SetUniform(program, "nTexChannels", s.nTexChannels);
+	SetUniform(program, "z", s.z);
+	if (s.matName > 0) {
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, s.matName);
+		SetUniform(program, "textureMat", 1);
+	}
+	SetUniform(program, "view", view? *view*s.ptTransform : s.ptTransform);
+	SetUniform(program, "uvTransform", s.uvTransform);
+	SetUniform(program, "object", (GLuint) object);
+#ifdef GL_QUADS
+	glDrawArrays(GL_QUADS, 0, 4);
+#else
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+#endif
+}
+
+void PickBuffer::End() {
+	// read into pixel buffer; glReadPixels returns at once, the copy completes asynchronously
+	if (!pixelBuffer)
+		glGenBuffers(1, &pixelBuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffer);
+	glBufferData(GL_PIXEL_PACK_BUFFER, 4*sizeof(GLuint)*(w > 0 && h > 0? w*h : 1), NULL, GL_STREAM_READ);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	if (w > 0 && h > 0)
+		glReadPixels(x0, y0, w, h, GL_RGBA_INTEGER, GL_UNSIGNED_INT, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (fence)
+		glDeleteSync(fence);
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();		// so the fence is signaled without a later wait
+	// restore state
+	RestoreBindings();
+	glScissor(oldScissor[0], oldScissor[1], oldScissor[2], oldScissor[3]);
+	if (!oldScissorTest)
+		glDisable(GL_SCISSOR_TEST);
+	if (!oldDepthTest)
+		glDisable(GL_DEPTH_TEST);
+	glUseProgram(oldProgram);
+}
+
+void PickBuffer::RestoreBindings() {
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, oldDrawFramebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, oldReadFramebuffer);
+	for (int i = 0; i < 2; i++) {
+		glActiveTexture(GL_TEXTURE0+i);
+		glBindTexture(GL_TEXTURE_2D, oldTextures[i]);
+	}
+	glActiveTexture(oldActiveTexture);
+	glBindTexture(GL_TEXTURE_2D, oldTextures[2]);
+}
+
+bool PickBuffer::Ready() {
+	if (!fence)
+		return false;
+	GLint status = GL_UNSIGNALED;
+	glGetSynciv(fence, GL_SYNC_STATUS, 1, NULL, &status);
+	return status == GL_SIGNALED;
+}
+
+bool PickBuffer::Result(PickResult &r, bool wait) {
+	if (!fence)
+		return false;
+	if (wait)
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+	else if (!Ready())
+		return false;
+	glDeleteSync(fence);
+	fence = NULL;
+	r = PickResult();
+	if (w <= 0 || h <= 0)
+		return true;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffer);
+	const GLuint *p = (const GLuint *) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, 4*sizeof(GLuint)*w*h, GL_MAP_READ_BIT);
+	if (p) {
+		// nearest drawn pixel to the cursor, nearer depth if equidistant
+		int bestDSq = INT_MAX;
+		for (int j = 0; j < h; j++)
+			for (int i = 0; i < w; i++, p += 4) {
+				if (!p[0])
+					continue;
+				int dx = x0+i-xmouse, dy = y0+j-ymouse, dsq = dx*dx+dy*dy;
+				float depth;
+				memcpy(&depth, p+2, sizeof(float));
+				if (dsq < bestDSq || (dsq == bestDSq && depth < r.depth)) {
+					bestDSq = dsq;
+					r.object = (int) p[0]-1;
+					r.triangle = (int) p[1]-1;
+					r.depth = depth;
+					r.x = x0+i;
+					r.y = y0+j;
+				}
+			}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	return true;
+}
+
+void PickBuffer::Release() {
+	if (!framebuffer)
+		return;
+	if (fence)
+		glDeleteSync(fence);
+	fence = NULL;
+	glDeleteBuffers(1, &pixelBuffer);
+	glDeleteRenderbuffers(1, &depthBuffer);
+	glDeleteTextures(1, &idTexture);
+	glDeleteFramebuffers(1, &framebuffer);
+	pixelBuffer = depthBuffer = idTexture = framebuffer = 0;
+	width = height = 0;
+}
@@ -15,6 +15,11 @@ int		shadowTextureUnit = 1, meshTextureUnit = 5;
 
 const	int SHADOW_RES = 16384, SHADOW_WIDTH = SHADOW_RES, SHADOW_HEIGHT = SHADOW_RES; //  2**14 (2**28 pixels)
 int		shadowEdgeSamples = 16;
+int		shadowLodBias = 1;
+
+// set per mesh by MeshDraw (for the shadow or main program): skip uploads of unchanged values
+Uniform<mat4> drawModelview("modelview"), drawPersp("persp"), drawModeltransform("modeltransform");
+Uniform<bool> drawOctNormals("octNormals");
 
 // shadow vertex shader
 const char *shadowVert = R"(
@@ -43,14 +48,21 @@ const char *mainVert = R"(
 	out vec3 vNormal;
 	out vec2 vUv;
 	out vec4 shadowCoord;
-	uniform mat4 modelview;			// camera.modelview*mesh.toWorld
+	uniform mat4 modelview;			// camera.modelview*mesh.toWorld*mesh.dequantize
 	uniform mat4 persp;				// camera.persp
-	uniform mat4 modeltransform;	// mesh.toWorld
+	uniform mat4 modeltransform;	// mesh.toWorld*mesh.dequantize
 	uniform mat4 depth_vp;			// shadow transform
+	uniform bool octNormals = false;	// normal.xy octahedral-encoded (mesh.compact)
+	vec3 OctDecode(vec2 e) {
+		vec3 n = vec3(e, 1-abs(e.x)-abs(e.y));
+		if (n.z < 0)
+			n.xy = (1-abs(n.yx))*vec2(n.x >= 0? 1 : -1, n.y >= 0? 1 : -1);
+		return normalize(n);
+	}
 	void main() {
 		shadowCoord = depth_vp*modeltransform*vec4(point, 1);
 		vPoint = (modelview*vec4(point, 1)).xyz;
-		vNormal = (modelview*vec4(normal, 0)).xyz;
+		vNormal = (modelview*vec4(octNormals? OctDecode(normal.xy) : normal, 0)).xyz;
 		gl_Position = persp*vec4(vPoint, 1);
 		vUv = uv;
 	}
@@ -139,8 +151,12 @@ const char *mainFrag = R"(
 
 // Display
 
-void MeshDraw(Camera camera, vec3 light, Mesh *m) {
+void MeshDraw(Camera camera, vec3 light, Mesh *m, int lod, bool cull) {
+	// if cull (main pass only: shadow casters may be out of view), draw only meshlets visible to camera
 	int nTris = m->triangles.size(), nQuads = m->quads.size();
+	vector<char> visible;
+	if (cull && !lod && m->meshlets.size())
+		m->CullMeshlets(camera, visible);
 	int program;
 	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
 	glBindVertexArray(m->vao);
@@ -153,11 +169,13 @@ void MeshDraw(Camera camera, vec3 light, Mesh *m) {
 		SetUniform(program, "textureImage", meshTextureUnit);
 	}
 	// set matrices
-	SetUniform(program, "modelview", camera.modelview*m->toWorld);
-	SetUniform(program, "persp", camera.persp);
-	SetUniform(program, "modeltransform", m->toWorld);
+	mat4 modeltransform = m->toWorld*m->dequantize;
+	drawModelview.Set(program, camera.modelview*modeltransform);
+	drawPersp.Set(program, camera.persp);
+	drawModeltransform.Set(program, modeltransform);
+	drawOctNormals.Set(program, m->octNormals);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->eBufferId);
-	glDrawElements(GL_TRIANGLES, 3*nTris, GL_UNSIGNED_INT, 0);
+	m->DrawTriangles(lod, 0, nTris, visible.size()? &visible : NULL);
 #ifdef GL_QUADS
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 		glDrawElements(GL_QUADS, 4*nQuads, GL_UNSIGNED_INT, m->quads.data());
@@ -179,7 +197,7 @@ void ShadowDraw(Camera camera, vec3 light, int winWidth, int winHeight, Mesh *me
 	glCullFace(GL_FRONT);
 	SetUniform(shadowProgram, "depth_vp", depthVP);
 	for (int i = 0; i < nMeshes; i++)
-		MeshDraw(camera, light, meshes[i]);
+		MeshDraw(camera, light, meshes[i], meshes[i]->SelectLod(camera, winHeight, shadowLodBias), false);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	// draw scene to visible buffer
 	glViewport(0, 0, winWidth, winHeight);
@@ -194,7 +212,7 @@ void ShadowDraw(Camera camera, vec3 light, int winWidth, int winHeight, Mesh *me
 	SetUniform(mainProgram, "nLights", 1);
 	SetUniform3v(mainProgram, "lights", 1, (float *) &xLight);
 	for (int i = 0; i < nMeshes; i++)
-		MeshDraw(camera, light, meshes[i]);
+		MeshDraw(camera, light, meshes[i], meshes[i]->SelectLod(camera, winHeight), true);
 }
 
 // Initialization
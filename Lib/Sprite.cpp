@@ -14,6 +14,12 @@ GLuint occupyBuffer = 0, collideBuffer = 0;
 // Shaders
 GLuint spriteShader = 0, spriteCollisionShader = 0;
 
+// set per sprite by Display: skip uploads of unchanged values
+Uniform<mat4> spriteView("view"), spriteUvTransform("uvTransform");
+Uniform<int> spriteTextureImage("textureImage"), spriteNTexChannels("nTexChannels");
+Uniform<bool> spriteUseMat("useMat");
+Uniform<float> spriteZ("z");
+
 namespace SpriteSpace {
 
 int BuildSpriteShader(bool collisionTest = false) {
@@ -342,17 +348,17 @@ void Sprite::Display(mat4 *fullview, int textureUnit) {
 		glBindTexture(GL_TEXTURE_2D, textureNames[frame]);
 	}
 	else glBindTexture(GL_TEXTURE_2D, textureName);
-	SetUniform(s, "textureImage", (int) textureUnit);
-	SetUniform(s, "useMat", matName > 0);
-	SetUniform(s, "nTexChannels", nTexChannels);
-	SetUniform(s, "z", z);
+	spriteTextureImage.Set(s, textureUnit);
+	spriteUseMat.Set(s, matName > 0);
+	spriteNTexChannels.Set(s, nTexChannels);
+	spriteZ.Set(s, z);
 	if (matName > 0) {
 		glActiveTexture(GL_TEXTURE0+textureUnit+1);
 		glBindTexture(GL_TEXTURE_2D, matName);
 		SetUniform(s, "textureMat", (int) textureUnit+1);
 	}
-	SetUniform(s, "view", fullview? *fullview*ptTransform : ptTransform);
-	SetUniform(s, "uvTransform", uvTransform);
+	spriteView.Set(s, fullview? *fullview*ptTransform : ptTransform);
+	spriteUvTransform.Set(s, uvTransform);
 #ifdef GL_QUADS
 	glDrawArrays(GL_QUADS, 0, 4);
 #else
@@ -1,8 +1,10 @@
 // Widgets.cpp (c) 2019-2022 Jules Bloomenthal
 
 #include <float.h>
+#include <algorithm>
 #include "Draw.h"
 #include "GLXtras.h"
+#include "Kernels.h"
 #include "Misc.h"
 #include "Text.h"
 #include "Widgets.h"
@@ -20,6 +22,13 @@ vec3 *MouseOver(vector<vec3> &points, int x, int y, mat4 fullview, int proximity
 	return NULL;
 }
 
+vec3 *MouseOver(vector<vec3> &points, PointTree &tree, int x, int y, mat4 fullview, int proximity) {
+	if (tree.Size() != (int) points.size())
+		tree.Build(points);
+	int i = tree.Pick(points, x, y, fullview, proximity);
+	return i < 0? NULL : &points[i];
+}
+
 bool MouseOver(double x, double y, vec2 p, int proximity) {
 	float f = length(vec2((float)(x), (float)(y))-p);
 	return f < proximity;
@@ -30,11 +39,143 @@ bool MouseOver(int x, int y, vec2 p, int proximity) {
 	return length(vec2(xo, yo)-p) < proximity;
 }
 
+// PointTree
+
+namespace {
+
+const int leafSize = 8;
+
+float Eval(const vec4 &plane, const vec3 &p) { return plane.x*p.x+plane.y*p.y+plane.z*p.z+plane.w; }
+
+void Range(const vec4 &plane, const vec3 &min, const vec3 &max, float &lo, float &hi) {
+	// least and greatest of plane over box
+	vec3 c = .5f*(min+max), e = .5f*(max-min);
+	float mid = Eval(plane, c), r = fabsf(plane.x)*e.x+fabsf(plane.y)*e.y+fabsf(plane.z)*e.z;
+	lo = mid-r;
+	hi = mid+r;
+}
+
+} // end namespace
+
+void PointTree::Clear() {
+	nodes.resize(0);
+	order.resize(0);
+	leafOf.resize(0);
+}
+
+void PointTree::Refit(const vector<vec3> &points, int n) {
+	Node &node = nodes[n];
+	node.min = vec3(FLT_MAX);
+	node.max = vec3(-FLT_MAX);
+	if (node.left < 0)
+		for (int i = node.start; i < node.end; i++) {
+			const vec3 &p = points[order[i]];
+			for (int k = 0; k < 3; k++) {
+				node.min[k] = std::min(node.min[k], p[k]);
+				node.max[k] = std::max(node.max[k], p[k]);
+			}
+		}
+	else
+		for (int c = node.left; c <= node.left+1; c++)
+			for (int k = 0; k < 3; k++) {
+				node.min[k] = std::min(node.min[k], nodes[c].min[k]);
+				node.max[k] = std::max(node.max[k], nodes[c].max[k]);
+			}
+}
+
+void PointTree::Build(const vector<vec3> &points) {
+	// split at the median of the widest axis of each node's points; children follow parents
+	Clear();
+	int n = (int) points.size();
+	leafOf.resize(n);
+	if (!n)
+		return;
+	order.resize(n);
+	for (int i = 0; i < n; i++)
+		order[i] = i;
+	nodes.resize(1);
+	nodes[0].end = n;
+	for (int k = 0; k < (int) nodes.size(); k++) {
+		if (nodes[k].end-nodes[k].start <= leafSize) {
+			for (int i = nodes[k].start; i < nodes[k].end; i++)
+				leafOf[order[i]] = k;
+			continue;
+		}
+		Refit(points, k);
+		vec3 d = nodes[k].max-nodes[k].min;
+		int axis = d.x > d.y? (d.x > d.z? 0 : 2) : (d.y > d.z? 1 : 2);
+		int start = nodes[k].start, mid = (start+nodes[k].end)/2, end = nodes[k].end;
+		std::nth_element(order.begin()+start, order.begin()+mid, order.begin()+end,
+			[&](int a, int b) { return points[a][axis] < points[b][axis]; });
+		nodes[k].left = (int) nodes.size();
+		Node left, right;
+		left.start = start;
+		left.end = right.start = mid;
+		right.end = end;
+		left.parent = right.parent = k;
+		nodes.push_back(left);
+		nodes.push_back(right);
+	}
+	for (int k = (int) nodes.size()-1; k >= 0; k--)
+		Refit(points, k);
+}
+
+void PointTree::Update(const vector<vec3> &points, int i) {
+	if (Size() != (int) points.size()) {
+		Build(points);
+		return;
+	}
+	if (i < 0 || i >= Size())
+		return;
+	for (int n = leafOf[i]; n >= 0; n = nodes[n].parent)
+		Refit(points, n);
+}
+
+int PointTree::Pick(const vector<vec3> &points, int x, int y, mat4 fullview, int proximity) const {
+	// a point projects within r pixels of (x, y) only if, in clip space (c = fullview*p), its x, y lie within
+	// [a*c.w, b*c.w] for the screen interval's a, b; these are linear in p (planes), reversed if c.w < 0
+	int picked = -1, vp[4];
+	if (nodes.empty())
+		return -1;
+	glGetIntegerv(GL_VIEWPORT, vp);
+	if (vp[2] <= 0 || vp[3] <= 0)
+		return -1;
+	float r = (float) proximity+2;		// margin for roundoff
+	float ax = 2*(x-r-vp[0])/vp[2]-1, bx = 2*(x+r-vp[0])/vp[2]-1;
+	float ay = 2*(y-r-vp[1])/vp[3]-1, by = 2*(y+r-vp[1])/vp[3]-1;
+	vec4 planes[5] = {fullview[0]-ax*fullview[3], bx*fullview[3]-fullview[0],
+					  fullview[1]-ay*fullview[3], by*fullview[3]-fullview[1], fullview[3]};
+	vector<int> stack(1, 0);
+	while (!stack.empty()) {
+		const Node &node = nodes[stack.back()];
+		stack.pop_back();
+		bool front = true, back = true;		// may contain a point with c.w > 0, c.w < 0
+		for (int k = 0; k < 5 && (front || back); k++) {
+			float lo, hi;
+			Range(planes[k], node.min, node.max, lo, hi);
+			front = front && hi >= 0;
+			back = back && lo <= 0;
+		}
+		if (!front && !back)
+			continue;
+		if (node.left >= 0) {
+			stack.push_back(node.left+1);
+			stack.push_back(node.left);
+			continue;
+		}
+		for (int i = node.start; i < node.end; i++) {
+			int id = order[i];
+			if ((picked < 0 || id < picked) && ::MouseOver(x, y, points[id], fullview, proximity))
+				picked = id;
+		}
+	}
+	return picked;
+}
+
 // Matrix Support
 
 int TransformArray(vec3 *in, vec3 *out, int n, mat4 m) {
-	for (int i = 0; i < n; i++)
-		out[i] = Vec3(m*vec4(in[i]));
+	TransformPoints(in, out, n, m);
 	return n;
 }
 